@@ -0,0 +1,459 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "handler.h"
+#include "lib/input.h"
+#include "lib/input_buffer.h"
+#include "lib/mutator.h"
+#include "lib/pci_device.h"
+#include "lib/pci_device_mock.h"
+#include "lib/pci_fuzzer.h"
+#include "lib/prng.h"
+#include "lib/profile.h"
+#include "lib/recorder.h"
+#include "lib/scheduler.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <unistd.h>
+
+#define NUM_ITERATIONS 1000000
+
+#define usage() \
+    fprintf(stderr, \
+            "Usage: %s-bench [OPTION]... [BENCHMARK]...\n" \
+            "Runs the benchmarks (or only the given benchmarks) and writes one result line\n" \
+            "per benchmark.\n" \
+            "Options:\n" \
+            "  -h, --help            Display help information and exit.\n" \
+            "  -l, --list            List the benchmarks and exit.\n" \
+            "  -n, --iterations=NUM  Specify the number of iterations of each benchmark.\n" \
+            "                        (The default is 1000000.)\n" \
+            "      --version         Display version information and exit.\n", \
+            PACKAGE_NAME)
+
+#define version() fprintf(stderr, "%s\n", PACKAGE_STRING)
+
+typedef size_t benchmark_t(size_t num_iterations);
+
+static pci_device_t *pci_device = NULL;
+static pci_fuzzer_t *pci_fuzzer = NULL;
+static FILE *null_stream = NULL;
+static recorder_t *recorder = NULL;
+static char recorder_path[] = "/tmp/pcifuzzer-bench.XXXXXX";
+static uint8_t inputs[256][PCI_FUZZER_MAX_PROGRAM];
+static volatile uint64_t sink;
+
+static void
+bench_log(FILE *restrict stream, const char *restrict format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    default_log_handler(stream, format, ap);
+    va_end(ap);
+}
+
+static size_t
+bench_input_derive_range(size_t num_iterations)
+{
+    /* Decoding an iteration from a stream, including the stream setup and
+       teardown */
+    for (size_t i = 0; i < num_iterations; ++i) {
+        FILE *stream = fmemopen(inputs[i % 256], PCI_FUZZER_MAX_INPUT, "r");
+        sink += input_derive_range(stream, 0, 5);
+        sink += input_derive_range(stream, 0, 4095);
+        sink += input_derive_range(stream, 0, 5);
+        sink += input_read32(stream);
+        fclose(stream);
+    }
+
+    return num_iterations;
+}
+
+static size_t
+bench_input_buffer_derive_range(size_t num_iterations)
+{
+    /* Decoding an iteration from a buffer */
+    for (size_t i = 0; i < num_iterations; ++i) {
+        input_buffer_t buffer;
+        input_buffer_init(&buffer, inputs[i % 256], PCI_FUZZER_MAX_INPUT);
+        sink += input_buffer_derive_range(&buffer, 0, 5);
+        sink += input_buffer_derive_range(&buffer, 0, 4095);
+        sink += input_buffer_derive_range(&buffer, 0, 5);
+        sink += input_buffer_read32(&buffer);
+    }
+
+    return num_iterations;
+}
+
+static size_t
+bench_input_buffer_derive_packed_range(size_t num_iterations)
+{
+    /* Decoding an iteration from a buffer in the v2 format */
+    for (size_t i = 0; i < num_iterations; ++i) {
+        input_buffer_t buffer;
+        input_buffer_init(&buffer, inputs[i % 256], PCI_FUZZER_MAX_INPUT);
+        uint64_t offset = 0;
+        sink += input_buffer_derive_packed_range(&buffer, 0, 5);
+        sink += input_buffer_derive_packed_range(&buffer, 0, 19);
+        sink += input_buffer_read_varint(&buffer, &offset) ? (offset % 4096) : 0;
+        sink += input_buffer_read_bits(&buffer, 32);
+    }
+
+    return num_iterations;
+}
+
+#define _bench_prng_define(name, type) \
+    static size_t bench_prng_fill_##name(size_t num_iterations) \
+    { \
+        prng_t *prng = prng_create(type, 1); \
+        uint8_t buf[PCI_FUZZER_MAX_INPUT]; \
+        for (size_t i = 0; i < num_iterations; ++i) { \
+            prng_fill(prng, buf, sizeof(buf)); \
+            sink += buf[0]; \
+        } \
+\
+        prng_destroy(prng); \
+        return num_iterations; \
+    }
+
+_bench_prng_define(random, PRNG_RANDOM)
+_bench_prng_define(splitmix64, PRNG_SPLITMIX64)
+_bench_prng_define(xoshiro256, PRNG_XOSHIRO256)
+#undef _bench_prng_define
+
+static size_t
+bench_mutator_mutate(size_t num_iterations)
+{
+    /* Mutating a program in place (spliced with another program) */
+    prng_t *prng = prng_create(PRNG_XOSHIRO256, 1);
+    uint8_t buf[PCI_FUZZER_MAX_PROGRAM];
+    size_t size = sizeof(buf);
+    memcpy(buf, inputs[0], size);
+    for (size_t i = 0; i < num_iterations; ++i) {
+        size = mutator_mutate(prng, buf, size, sizeof(buf), inputs[i % 256], PCI_FUZZER_MAX_PROGRAM);
+        sink += size;
+    }
+
+    prng_destroy(prng);
+    return num_iterations;
+}
+
+static size_t
+bench_profile_region_sample(size_t num_iterations)
+{
+    /* Sampling an offset of the command block registers of an ATA/IDE
+       controller */
+    profile_t *profile = profile_open("ata");
+    const profile_region_t *region = profile_get_region(profile, 0);
+    for (size_t i = 0; i < num_iterations; ++i) {
+        uint32_t input;
+        memcpy(&input, inputs[i % 256], sizeof(input));
+        sink += profile_region_sample(region, input)->offset;
+    }
+
+    profile_destroy(profile);
+    return num_iterations;
+}
+
+static size_t
+bench_scheduler_select(size_t num_iterations)
+{
+    /* Selecting, pulling, and rewarding an arm of the regions and functions
+       of the mock device */
+    scheduler_t *scheduler = scheduler_create(3 * PCI_FUZZER_NUM_FUNCTIONS);
+    for (size_t i = 0; i < num_iterations; ++i) {
+        size_t arm = scheduler_select(scheduler);
+        scheduler_pull(scheduler, arm);
+        scheduler_reward(scheduler, arm, inputs[i % 256][0] & SCHEDULER_NOVEL);
+        sink += arm;
+    }
+
+    scheduler_destroy(scheduler);
+    return num_iterations;
+}
+
+static size_t
+bench_pci_device_region_read32(size_t num_iterations)
+{
+    /* Reading a memory region of the mock device through the checked
+       function */
+    for (size_t i = 0; i < num_iterations; ++i) {
+        sink += pci_device_region_read32(pci_device, 1, (i * 4) % 4096);
+    }
+
+    return num_iterations;
+}
+
+static size_t
+bench_pci_device_region_ops_read32(size_t num_iterations)
+{
+    /* Reading a memory region of the mock device through its (unchecked)
+       accessors */
+    const pci_device_region_ops_t *ops = pci_device_region_get_ops(pci_device, 1);
+    for (size_t i = 0; i < num_iterations; ++i) {
+        sink += ops->read32(pci_device, 1, (i * 4) % 4096);
+    }
+
+    return num_iterations;
+}
+
+static size_t
+bench_pci_fuzzer_execute(size_t num_iterations)
+{
+    /* Dispatching an (already decoded) operation to the mock device */
+    pci_fuzzer_op_t ops[PCI_FUZZER_NUM_FUNCTIONS];
+    for (size_t i = 0; i < PCI_FUZZER_NUM_FUNCTIONS; ++i) {
+        ops[i].function = i;
+        ops[i].region = 1;
+        ops[i].offset = (i * 64) % 4096;
+        ops[i].value = i;
+    }
+
+    for (size_t i = 0; i < num_iterations; ++i) {
+        pci_fuzzer_execute(pci_fuzzer, &ops[i % PCI_FUZZER_NUM_FUNCTIONS]);
+    }
+
+    return num_iterations;
+}
+
+static size_t
+bench_default_log_handler(size_t num_iterations)
+{
+    /* Logging an operation (to /dev/null, so this is a lower bound) */
+    for (size_t i = 0; i < num_iterations; ++i) {
+        bench_log(null_stream, "suuu", "function", "pci_device_region_write32", "region", 1, "offset", i % 4096,
+                "value", i);
+    }
+
+    return num_iterations;
+}
+
+static size_t
+bench_recorder_append(size_t num_iterations)
+{
+    /* Recording an operation */
+    for (size_t i = 0; i < num_iterations; ++i) {
+        recorder_append(recorder, i, 1, PCI_FUZZER_WRITE32, i % 4096, i);
+    }
+
+    return num_iterations;
+}
+
+static size_t
+bench_pci_fuzzer_iterate(size_t num_iterations)
+{
+    /* End-to-end iterations from a stream, as in generate mode before the
+       input buffer */
+    prng_t *prng = prng_create(PRNG_RANDOM, 1);
+    for (size_t i = 0; i < num_iterations; ++i) {
+        uint8_t buf[PCI_FUZZER_MAX_INPUT];
+        prng_fill(prng, buf, sizeof(buf));
+        FILE *stream = fmemopen(buf, sizeof(buf), "r");
+        pci_fuzzer_iterate(pci_fuzzer, stream);
+        fclose(stream);
+    }
+
+    prng_destroy(prng);
+    return num_iterations;
+}
+
+static size_t
+bench_pci_fuzzer_iterate_buf(size_t num_iterations)
+{
+    /* End-to-end iterations from a buffer, as in generate mode */
+    prng_t *prng = prng_create(PRNG_XOSHIRO256, 1);
+    for (size_t i = 0; i < num_iterations; ++i) {
+        uint8_t buf[PCI_FUZZER_MAX_INPUT];
+        prng_fill(prng, buf, sizeof(buf));
+        pci_fuzzer_iterate_buf(pci_fuzzer, buf, sizeof(buf));
+    }
+
+    prng_destroy(prng);
+    return num_iterations;
+}
+
+static size_t
+bench_pci_fuzzer_iterate_program(size_t num_iterations)
+{
+    /* End-to-end programs, as in generate mode with programs (the result is
+       per operation) */
+    size_t num_ops = 0;
+    for (size_t i = 0; i < (num_iterations / 32) + 1; ++i) {
+        num_ops += pci_fuzzer_iterate_program(pci_fuzzer, inputs[i % 256], PCI_FUZZER_MAX_PROGRAM);
+    }
+
+    return num_ops;
+}
+
+static size_t
+bench_pci_fuzzer_iterate_program_v2(size_t num_iterations)
+{
+    /* End-to-end programs in the v2 format (the result is per operation) */
+    size_t num_ops = 0;
+    pci_fuzzer_set_format(pci_fuzzer, PCI_FUZZER_FORMAT_V2);
+    while (num_ops < num_iterations) {
+        num_ops += pci_fuzzer_iterate_program(pci_fuzzer, inputs[num_ops % 256], PCI_FUZZER_MAX_PROGRAM);
+    }
+
+    pci_fuzzer_set_format(pci_fuzzer, PCI_FUZZER_FORMAT_V1);
+    return num_ops;
+}
+
+static const struct benchmark {
+    const char *name;
+    benchmark_t *function;
+} benchmarks[] = {
+        {"input_derive_range",               bench_input_derive_range               },
+        {"input_buffer_derive_range",        bench_input_buffer_derive_range        },
+        {"input_buffer_derive_packed_range", bench_input_buffer_derive_packed_range },
+        {"prng_fill_random",                 bench_prng_fill_random                 },
+        {"prng_fill_splitmix64",             bench_prng_fill_splitmix64             },
+        {"prng_fill_xoshiro256",             bench_prng_fill_xoshiro256             },
+        {"mutator_mutate",                   bench_mutator_mutate                   },
+        {"profile_region_sample",            bench_profile_region_sample            },
+        {"scheduler_select",                 bench_scheduler_select                 },
+        {"pci_device_region_read32",         bench_pci_device_region_read32         },
+        {"pci_device_region_ops_read32",     bench_pci_device_region_ops_read32     },
+        {"pci_fuzzer_execute",               bench_pci_fuzzer_execute               },
+        {"default_log_handler",              bench_default_log_handler              },
+        {"recorder_append",                  bench_recorder_append                  },
+        {"pci_fuzzer_iterate",               bench_pci_fuzzer_iterate               },
+        {"pci_fuzzer_iterate_buf",           bench_pci_fuzzer_iterate_buf           },
+        {"pci_fuzzer_iterate_program",       bench_pci_fuzzer_iterate_program       },
+        {"pci_fuzzer_iterate_program_v2",    bench_pci_fuzzer_iterate_program_v2    },
+};
+
+static int
+is_selected(const char *restrict name, int argc, char *argv[])
+{
+    if (optind >= argc) {
+        return 1;
+    }
+
+    for (int i = optind; i < argc; ++i) {
+        if (strcmp(name, argv[i]) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int c = 0;
+    enum
+    {
+        OPT_VERSION = CHAR_MAX + 1,
+    };
+    /* clang-format off */
+    static struct option longopts[] = {
+        {"help",        no_argument,       NULL, 'h'             },
+        {"iterations",  required_argument, NULL, 'n'             },
+        {"list",        no_argument,       NULL, 'l'             },
+        {"version",     no_argument,       NULL, OPT_VERSION     },
+        {NULL,          0,                 NULL, 0               }
+    };
+    /* clang-format on */
+    static int longindex = 0;
+    size_t num_iterations = NUM_ITERATIONS;
+    while ((c = getopt_long(argc, argv, "hln:", longopts, &longindex)) != -1) {
+        switch (c) {
+        case 'h':
+            usage();
+            exit(EXIT_FAILURE);
+
+        case 'l':
+            for (size_t i = 0; i < (sizeof(benchmarks) / sizeof(*benchmarks)); ++i) {
+                printf("%s\n", benchmarks[i].name);
+            }
+
+            exit(EXIT_SUCCESS);
+
+        case 'n':
+            errno = 0;
+            num_iterations = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            if (num_iterations == 0) {
+                fprintf(stderr, "%s: Invalid number of iterations.\n", __func__);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_VERSION:
+            version();
+            exit(EXIT_FAILURE);
+
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* The same inputs are used by every run */
+    prng_set_error_handler(default_error_handler);
+    prng_t *prng = prng_create(PRNG_XOSHIRO256, 1);
+    prng_fill(prng, inputs, sizeof(inputs));
+    prng_destroy(prng);
+    pci_device_set_error_handler(default_error_handler);
+    pci_device = pci_device_mock_create(NULL);
+    pci_fuzzer_set_error_handler(default_error_handler);
+    pci_fuzzer = pci_fuzzer_create(pci_device, NULL, 0);
+    profile_set_error_handler(default_error_handler);
+    scheduler_set_error_handler(default_error_handler);
+    null_stream = fopen("/dev/null", "w");
+    if (null_stream == NULL) {
+        perror("fopen");
+        exit(EXIT_FAILURE);
+    }
+
+    int fd = mkstemp(recorder_path);
+    if (fd == -1) {
+        perror("mkstemp");
+        exit(EXIT_FAILURE);
+    }
+
+    close(fd);
+    recorder_set_error_handler(default_error_handler);
+    recorder = recorder_create(recorder_path, RECORDER_NUM_RECORDS);
+    for (size_t i = 0; i < (sizeof(benchmarks) / sizeof(*benchmarks)); ++i) {
+        if (!is_selected(benchmarks[i].name, argc, argv)) {
+            continue;
+        }
+
+        struct timespec begin;
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        size_t num_ops = benchmarks[i].function(num_iterations);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double ns = ((end.tv_sec - begin.tv_sec) * 1e9) + (end.tv_nsec - begin.tv_nsec);
+        printf("{ \"benchmark\": \"%s\", \"ops\": %zu, \"ns\": %.0f, \"ns_per_op\": %.2f, \"ops_per_sec\": %.0f }\n",
+                benchmarks[i].name, num_ops, ns, ns / num_ops, num_ops / (ns / 1e9));
+        fflush(stdout);
+    }
+
+    recorder_destroy(recorder);
+    unlink(recorder_path);
+    fclose(null_stream);
+    pci_fuzzer_destroy(pci_fuzzer);
+    pci_device_destroy(pci_device);
+    exit(EXIT_SUCCESS);
+}
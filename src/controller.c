@@ -0,0 +1,283 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "handler.h"
+#include "lib/channel.h"
+#include "lib/prng.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NUM_TEST_CASES 1000
+#define TIMEOUT 60
+
+#define usage() \
+    fprintf(stderr, \
+            "Usage: %s-controller [OPTION]... FILE [INPUT]...\n" \
+            "Creates the test case channel file, sends the inputs (or pseudorandom test\n" \
+            "cases) through it, and writes one status line per test case.\n" \
+            "Options:\n" \
+            "      --generator=NAME  Specify the pseudorandom number generator (i.e.,\n" \
+            "                        random, splitmix64, or xoshiro256). (The default is\n" \
+            "                        random.)\n" \
+            "  -h, --help            Display help information and exit.\n" \
+            "  -n, --test-cases=NUM  Specify the number of pseudorandom test cases. (The\n" \
+            "                        default is 1000.)\n" \
+            "  -s, --seed=NUM        Specify the seed for the pseudorandom number generator.\n" \
+            "                        (The default is 1.)\n" \
+            "  -t, --timeout=NUM     Specify the timeout, in seconds, to wait for the fuzzer\n" \
+            "                        to perform a test case, or 0 to wait forever. (The\n" \
+            "                        default is 60.)\n" \
+            "      --slot-size=NUM   Specify the maximum size, in bytes, of each test case.\n" \
+            "                        (The default is 4096.)\n" \
+            "      --slots=NUM       Specify the number of slots in the channel. (The default\n" \
+            "                        is 256.)\n" \
+            "      --version         Display version information and exit.\n", \
+            PACKAGE_NAME)
+
+#define version() fprintf(stderr, "%s\n", PACKAGE_STRING)
+
+static const char *status_names[CHANNEL_NUM_STATUSES] = {
+    [CHANNEL_PENDING] = "pending",
+    [CHANNEL_DONE] = "done",
+    [CHANNEL_REJECTED] = "rejected",
+};
+
+static uint64_t
+print_statuses(channel_t *restrict channel, uint64_t sequence)
+{
+    /* Writes the status of each test case performed since the given one, and
+       returns the next test case not performed yet. */
+    uint64_t tail = channel_get_tail(channel);
+    for (; sequence < tail; ++sequence) {
+        const channel_slot_t *slot = channel_get_slot(channel, sequence);
+        const char *status = (slot->status < CHANNEL_NUM_STATUSES) ? status_names[slot->status] : "invalid";
+        printf("{ \"sequence\": %" PRIu64 ", \"status\": \"%s\", \"num_ops\": %" PRIu64 ", \"response\": %" PRIu64
+               " }\n",
+                sequence, status, slot->num_ops, slot->response);
+    }
+
+    return sequence;
+}
+
+static uint64_t
+wait_statuses(channel_t *restrict channel, uint64_t sequence, uint64_t end, unsigned long timeout)
+{
+    /* Writes the status of each test case performed until the given one is
+       reached, and returns the next test case not performed yet. Exits if no
+       test case is performed within the timeout (e.g., if the fuzzer died). */
+    unsigned int num_polls = 0;
+    time_t deadline = time(NULL) + timeout;
+    while (sequence < end) {
+        uint64_t next = print_statuses(channel, sequence);
+        if (next != sequence) {
+            sequence = next;
+            num_polls = 0;
+            deadline = time(NULL) + timeout;
+            continue;
+        }
+
+        /* Poll without system calls for a while, and then back off */
+        if (++num_polls < 4096) {
+            __builtin_ia32_pause();
+        } else {
+            if (timeout != 0 && time(NULL) >= deadline) {
+                fprintf(stderr, "%s: Timed out waiting for the fuzzer.\n", __func__);
+                exit(EXIT_FAILURE);
+            }
+
+            struct timespec ts = {.tv_sec = 0, .tv_nsec = 100000};
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    return sequence;
+}
+
+static uint64_t
+send_test_case(channel_t *restrict channel, const void *buf, size_t size, uint64_t sequence, uint64_t num_sent,
+        size_t num_slots, unsigned long timeout)
+{
+    /* Waits until the status of the test case in the slot to be reused is
+       written, and returns the next test case not performed yet. */
+    if ((num_sent - sequence) >= num_slots) {
+        sequence = wait_statuses(channel, sequence, num_sent - num_slots + 1, timeout);
+    }
+
+    if (channel_send(channel, buf, size, NULL) == -1) {
+        perror("channel_send");
+        exit(EXIT_FAILURE);
+    }
+
+    return sequence;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int c = 0;
+    enum
+    {
+        OPT_GENERATOR = CHAR_MAX + 1,
+        OPT_SLOT_SIZE,
+        OPT_SLOTS,
+        OPT_VERSION,
+    };
+    /* clang-format off */
+    static struct option longopts[] = {
+        {"generator",   required_argument, NULL, OPT_GENERATOR   },
+        {"help",        no_argument,       NULL, 'h'             },
+        {"test-cases",  required_argument, NULL, 'n'             },
+        {"seed",        required_argument, NULL, 's'             },
+        {"slot-size",   required_argument, NULL, OPT_SLOT_SIZE   },
+        {"slots",       required_argument, NULL, OPT_SLOTS       },
+        {"timeout",     required_argument, NULL, 't'             },
+        {"version",     no_argument,       NULL, OPT_VERSION     },
+        {NULL,          0,                 NULL, 0               }
+    };
+    /* clang-format on */
+    static int longindex = 0;
+    int generator = PRNG_RANDOM;
+    size_t num_test_cases = NUM_TEST_CASES;
+    unsigned long seed = 1;
+    size_t slot_size = CHANNEL_SLOT_SIZE;
+    size_t num_slots = CHANNEL_NUM_SLOTS;
+    unsigned long timeout = TIMEOUT;
+    while ((c = getopt_long(argc, argv, "hn:s:t:", longopts, &longindex)) != -1) {
+        switch (c) {
+        case 'h':
+            usage();
+            exit(EXIT_FAILURE);
+
+        case 'n':
+            errno = 0;
+            num_test_cases = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case 's':
+            errno = 0;
+            seed = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case 't':
+            errno = 0;
+            timeout = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_GENERATOR:
+            generator = prng_get_type(optarg);
+            if (generator == -1) {
+                fprintf(stderr, "%s: Invalid pseudorandom number generator.\n", __func__);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_SLOT_SIZE:
+            errno = 0;
+            slot_size = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_SLOTS:
+            errno = 0;
+            num_slots = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_VERSION:
+            version();
+            exit(EXIT_FAILURE);
+
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (argv[optind] == NULL) {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    channel_set_error_handler(exit_error_handler);
+    prng_set_error_handler(exit_error_handler);
+    channel_t *channel = channel_create(argv[optind], slot_size, num_slots);
+    uint8_t *buf = (uint8_t *)malloc(slot_size);
+    if (buf == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t sequence = 0;
+    uint64_t num_sent = 0;
+    if (argv[optind + 1] != NULL) {
+        for (int i = optind + 1; i < argc; ++i) {
+            FILE *stream = fopen(argv[i], "r");
+            if (stream == NULL) {
+                perror("fopen");
+                exit(EXIT_FAILURE);
+            }
+
+            /* Test cases larger than a slot are truncated */
+            size_t size = fread(buf, 1, slot_size, stream);
+            if (ferror(stream)) {
+                perror("fread");
+                exit(EXIT_FAILURE);
+            }
+
+            fclose(stream);
+            sequence = send_test_case(channel, buf, size, sequence, num_sent, num_slots, timeout);
+            ++num_sent;
+        }
+    } else {
+        prng_t *prng = prng_create(generator, seed);
+        for (size_t i = 0; i < num_test_cases; ++i) {
+            prng_fill(prng, buf, slot_size);
+            sequence = send_test_case(channel, buf, slot_size, sequence, num_sent, num_slots, timeout);
+            ++num_sent;
+        }
+
+        prng_destroy(prng);
+    }
+
+    /* Wait for the remaining test cases to be performed */
+    channel_close(channel);
+    wait_statuses(channel, sequence, num_sent, timeout);
+
+    free(buf);
+    channel_destroy(channel);
+    exit(EXIT_SUCCESS);
+}
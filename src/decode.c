@@ -0,0 +1,139 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "handler.h"
+#include "lib/pci_fuzzer.h"
+#include "lib/recorder.h"
+#include "lib/replay.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define usage() \
+    fprintf(stderr, \
+            "Usage: %s-decode [OPTION]... FILE\n" \
+            "Decodes a flight recorder file into log lines, from the oldest to the newest\n" \
+            "record.\n" \
+            "Options:\n" \
+            "  -c, --compile=FILE    Compile the log or flight recorder file into the replay\n" \
+            "                        file (see the --replay option of %s) instead.\n" \
+            "  -h, --help            Display help information and exit.\n" \
+            "  -l, --last=NUM        Decode only the last NUM records.\n" \
+            "      --version         Display version information and exit.\n", \
+            PACKAGE_NAME, PACKAGE_NAME)
+
+#define version() fprintf(stderr, "%s\n", PACKAGE_STRING)
+
+int
+main(int argc, char *argv[])
+{
+    int c = 0;
+    enum
+    {
+        OPT_VERSION = CHAR_MAX + 1,
+    };
+    /* clang-format off */
+    static struct option longopts[] = {
+        {"compile",     required_argument, NULL, 'c'             },
+        {"help",        no_argument,       NULL, 'h'             },
+        {"last",        required_argument, NULL, 'l'             },
+        {"version",     no_argument,       NULL, OPT_VERSION     },
+        {NULL,          0,                 NULL, 0               }
+    };
+    /* clang-format on */
+    static int longindex = 0;
+    char *compile = NULL;
+    size_t last = SIZE_MAX;
+    while ((c = getopt_long(argc, argv, "c:hl:", longopts, &longindex)) != -1) {
+        switch (c) {
+        case 'c':
+            compile = optarg;
+            break;
+
+        case 'h':
+            usage();
+            exit(EXIT_FAILURE);
+
+        case 'l':
+            errno = 0;
+            last = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_VERSION:
+            version();
+            exit(EXIT_FAILURE);
+
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (argv[optind] == NULL) {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    recorder_set_error_handler(exit_error_handler);
+    replay_set_error_handler(exit_error_handler);
+    if (compile != NULL) {
+        replay_t *replay = replay_open(argv[optind]);
+        if (replay == NULL) {
+            perror("replay_open");
+            exit(EXIT_FAILURE);
+        }
+
+        if (replay_save(replay, compile) == -1) {
+            perror("replay_save");
+            exit(EXIT_FAILURE);
+        }
+
+        replay_destroy(replay);
+        exit(EXIT_SUCCESS);
+    }
+
+    recorder_t *recorder = recorder_open(argv[optind]);
+    if (recorder == NULL) {
+        perror("recorder_open");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t num_records = recorder_get_num_records(recorder);
+    size_t first = (last < num_records) ? (num_records - last) : 0;
+    for (size_t i = first; i < num_records; ++i) {
+        const recorder_record_t *record = recorder_get_record(recorder, i);
+        if (record == NULL) {
+            continue;
+        }
+
+        const char *function = pci_fuzzer_get_function_name(record->function);
+        if (function == NULL) {
+            continue;
+        }
+
+        printf("{ \"iteration\": %" PRIu64 ", \"function\": \"%s\", \"region\": %u, \"offset\": %" PRIu64,
+                record->iteration, function, record->region, record->offset);
+        if (pci_fuzzer_function_has_value(record->function)) {
+            printf(", \"value\": %" PRIu64, record->value);
+        }
+
+        printf(" }\n");
+    }
+
+    recorder_destroy(recorder);
+    exit(EXIT_SUCCESS);
+}
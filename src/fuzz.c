@@ -0,0 +1,139 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fuzz.h"
+
+#include "handler.h"
+#include "lib/pci_device.h"
+#include "lib/pci_device_mock.h"
+#include "lib/pci_fuzzer.h"
+#include "lib/profile.h"
+#include "lib/scheduler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sys/io.h>
+
+static pci_device_t *pci_device = NULL;
+static pci_fuzzer_t *pci_fuzzer = NULL;
+static profile_t *profile = NULL;
+
+#ifdef PCIFUZZER_LIBFUZZER
+/* libFuzzer treats the counters in this section as additional coverage, so the
+   response fingerprints guide it when the device model cannot be
+   instrumented. */
+__attribute__((__section__("__libfuzzer_extra_counters"), __used__)) static uint8_t extra_counters[65536];
+#endif
+
+static void
+fuzz_exit(void)
+{
+    pci_fuzzer_destroy(pci_fuzzer);
+    profile_destroy(profile);
+    pci_device_destroy(pci_device);
+}
+
+static void
+fuzz_init(void)
+{
+    pci_device_set_error_handler(default_error_handler);
+    pci_fuzzer_set_error_handler(default_error_handler);
+    profile_set_error_handler(default_error_handler);
+    scheduler_set_error_handler(default_error_handler);
+    const char *target = getenv("PCIFUZZER_TARGET");
+    if (target == NULL) {
+        pci_device = pci_device_mock_create(NULL);
+    } else {
+        unsigned int bus, device, function;
+        int length = 0;
+        if (sscanf(target, "%x:%x.%x%n", &bus, &device, &function, &length) != 3 || target[length] != '\0'
+                || bus > 255 || device > 31 || function > 7) {
+            fprintf(stderr, "%s: Invalid PCI device: %s\n", __func__, target);
+            exit(EXIT_FAILURE);
+        }
+
+        const char *name = getenv("PCIFUZZER_CONFIG");
+        int config_access = (name != NULL) ? pci_device_get_config_access(name) : PCI_DEVICE_CONFIG_IO;
+        name = getenv("PCIFUZZER_MAP");
+        int region_access = (name != NULL) ? pci_device_get_region_access(name) : PCI_DEVICE_REGION_DEVMEM;
+        if (config_access == -1 || region_access == -1) {
+            fprintf(stderr, "%s: Invalid PCI device access mechanism.\n", __func__);
+            exit(EXIT_FAILURE);
+        }
+
+        if (iopl(3) == -1) {
+            perror("iopl");
+            exit(EXIT_FAILURE);
+        }
+
+        pci_device_set_config_access(config_access);
+        pci_device_set_region_access(region_access);
+        pci_device = pci_device_create(bus, device, function);
+    }
+
+    if (pci_device == NULL) {
+        perror("pci_device_create");
+        exit(EXIT_FAILURE);
+    }
+
+    pci_fuzzer = pci_fuzzer_create(pci_device, NULL, 0);
+    if (pci_fuzzer == NULL) {
+        perror("pci_fuzzer_create");
+        pci_device_destroy(pci_device);
+        exit(EXIT_FAILURE);
+    }
+
+    const char *name = getenv("PCIFUZZER_FORMAT");
+    int format = (name != NULL) ? pci_fuzzer_get_format(name) : PCI_FUZZER_FORMAT_V1;
+    if (format == -1) {
+        fprintf(stderr, "%s: Invalid input format.\n", __func__);
+        exit(EXIT_FAILURE);
+    }
+
+    pci_fuzzer_set_format(pci_fuzzer, format);
+    name = getenv("PCIFUZZER_SCHEDULE");
+    int schedule = (name != NULL) ? pci_fuzzer_get_schedule(name) : PCI_FUZZER_SCHEDULE_INPUT;
+    if (schedule == -1) {
+        fprintf(stderr, "%s: Invalid schedule.\n", __func__);
+        exit(EXIT_FAILURE);
+    }
+
+    pci_fuzzer_set_schedule(pci_fuzzer, schedule);
+    name = getenv("PCIFUZZER_PROFILE");
+    if (name != NULL) {
+        profile = profile_open(name);
+        pci_fuzzer_set_profile(pci_fuzzer, profile);
+    }
+
+    atexit(fuzz_exit);
+}
+
+int
+LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    (void)argc;
+    (void)argv;
+    fuzz_init();
+    return 0;
+}
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    /* Drivers are not required to call LLVMFuzzerInitialize() */
+    if (pci_fuzzer == NULL) {
+        fuzz_init();
+    }
+
+    pci_fuzzer_iterate_program(pci_fuzzer, data, size);
+#ifdef PCIFUZZER_LIBFUZZER
+    extra_counters[(pci_fuzzer_get_fingerprint(pci_fuzzer) >> 48) % sizeof(extra_counters)] = 1;
+#endif
+    return 0;
+}
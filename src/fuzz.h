@@ -0,0 +1,48 @@
+/** @file */
+
+#ifndef FUZZ_H
+#define FUZZ_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Initializes the fuzz target (i.e., creates the PCI device and the PCI
+ * fuzzer once per process).
+ *
+ * The PCI device is the mock PCI device, unless the PCIFUZZER_TARGET
+ * environment variable specifies a PCI device (i.e., BUS:DEVICE.FUNCTION in
+ * hexadecimal, as printed by lspci). The PCIFUZZER_CONFIG and PCIFUZZER_MAP
+ * environment variables specify its configuration space access and memory
+ * region mapping mechanisms (see pci_device_get_config_access() and
+ * pci_device_get_region_access()).
+ *
+ * @param [in] argc Number of arguments (unused).
+ * @param [in] argv Arguments (unused).
+ * @return 0.
+ */
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+
+/**
+ * Runs an input through the PCI fuzzer as a program (see
+ * pci_fuzzer_iterate_program()).
+ *
+ * No memory is allocated and no stdio is used, so inputs can be run back to
+ * back in a single process (e.g., by libFuzzer, or any engine that drives
+ * libFuzzer-style fuzz targets).
+ *
+ * @param [in] data Input buffer.
+ * @param [in] size Input buffer size.
+ * @return 0.
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FUZZ_H */
@@ -0,0 +1,48 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fuzz.h"
+#include "stream.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Standalone driver for the fuzz target (i.e., when it is not linked with
+ * libFuzzer), which runs each input file (or the standard input) through the
+ * fuzz target, in a single process, to reproduce or regress inputs.
+ */
+
+int
+main(int argc, char *argv[])
+{
+    LLVMFuzzerInitialize(&argc, &argv);
+    for (int i = (argc > 1) ? 1 : 0; i < argc; ++i) {
+        FILE *stream = (argc > 1) ? fopen(argv[i], "r") : stdin;
+        if (stream == NULL) {
+            perror("fopen");
+            exit(EXIT_FAILURE);
+        }
+
+        size_t size = 0;
+        uint8_t *buf = read_stream(stream, &size);
+        if (stream != stdin) {
+            fclose(stream);
+        }
+
+        if (buf == NULL) {
+            perror("read_stream");
+            exit(EXIT_FAILURE);
+        }
+
+        LLVMFuzzerTestOneInput(buf, size);
+        free(buf);
+    }
+
+    exit(EXIT_SUCCESS);
+}
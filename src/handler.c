@@ -0,0 +1,101 @@
+/** @file */
+
+#include "handler.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <unistd.h>
+
+void
+default_error_handler(int status, int error, const char *restrict format, va_list ap)
+{
+    fflush(stdout);
+    vfprintf(stderr, format, ap);
+    if (error != 0) {
+        fprintf(stderr, ": %s\n", strerror(error));
+    }
+
+    fflush(stderr);
+    abort();
+}
+
+void
+default_log_handler(FILE *restrict stream, const char *restrict format, va_list ap)
+{
+    flockfile(stream);
+    fprintf(stream, "{ ");
+    fprintf(stream, "\"time\": %d,", (unsigned int)time(NULL));
+    for (size_t i = 0; format[i] != '\0'; ++i) {
+        if (i > 0) {
+            fprintf(stream, ", ");
+        }
+
+        fprintf(stream, "\"%s\": ", va_arg(ap, char *));
+        switch (format[i]) {
+        case 'c':
+            fprintf(stream, "\"%c\"", va_arg(ap, int));
+            break;
+
+        case 'd':
+            fprintf(stream, "%d", va_arg(ap, int));
+            break;
+
+        case 'f':
+            fprintf(stream, "%f", va_arg(ap, double));
+            break;
+
+        case 'o':
+            fprintf(stream, "%o", va_arg(ap, unsigned int));
+            break;
+
+        case 'p':
+            fprintf(stream, "%p", va_arg(ap, void *));
+            break;
+
+        case 'q':
+            fprintf(stream, "%llu", va_arg(ap, unsigned long long int));
+            break;
+
+        case 's':
+            fprintf(stream, "\"%s\"", va_arg(ap, char *));
+            break;
+
+        case 'u':
+            fprintf(stream, "%u", va_arg(ap, unsigned int));
+            break;
+
+        case 'x':
+            fprintf(stream, "%x", va_arg(ap, unsigned int));
+            break;
+
+        case 'z':
+            fprintf(stream, "%zu", va_arg(ap, size_t));
+            break;
+
+        default:
+            abort();
+        }
+    }
+
+    fprintf(stream, " }\n");
+    fflush(stream);
+    fsync(fileno(stream));
+    funlockfile(stream);
+}
+
+void
+exit_error_handler(int status, int error, const char *restrict format, va_list ap)
+{
+    fflush(stdout);
+    vfprintf(stderr, format, ap);
+    if (error != 0) {
+        fprintf(stderr, ": %s\n", strerror(error));
+    }
+
+    fflush(stderr);
+    exit(EXIT_FAILURE);
+}
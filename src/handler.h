@@ -0,0 +1,48 @@
+/** @file */
+
+#ifndef HANDLER_H
+#define HANDLER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+
+/**
+ * Default error handler. Prints the error message and aborts.
+ *
+ * @param [in] status Status.
+ * @param [in] error Error number.
+ * @param [in] format Format string.
+ * @param [in] ap Arguments.
+ */
+void default_error_handler(int status, int error, const char *restrict format, va_list ap);
+
+/**
+ * Default log handler. Writes a log line (i.e., a JSON object) and
+ * synchronizes the log stream.
+ *
+ * @param [in] stream Log stream.
+ * @param [in] format Format string.
+ * @param [in] ap Arguments.
+ */
+void default_log_handler(FILE *restrict stream, const char *restrict format, va_list ap);
+
+/**
+ * Exiting error handler. Prints the error message and exits (i.e., for tools
+ * whose errors are caused by their arguments or files, not by bugs).
+ *
+ * @param [in] status Status.
+ * @param [in] error Error number.
+ * @param [in] format Format string.
+ * @param [in] ap Arguments.
+ */
+void exit_error_handler(int status, int error, const char *restrict format, va_list ap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HANDLER_H */
@@ -0,0 +1,297 @@
+/** @file */
+
+#include "channel.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct _channel {
+    channel_header_t *header;
+    uint8_t *slots;
+    size_t slot_size;
+    size_t slot_stride;
+    size_t num_slots;
+    size_t size;
+};
+
+static channel_error_handler_t *error_handler = NULL;
+
+void channel_error(channel_t *restrict channel, int status, int error, const char *restrict format, ...);
+int channel_geometry(channel_t *restrict channel, size_t slot_size, size_t num_slots, size_t max_size);
+
+static inline channel_slot_t *
+channel_slot(channel_t *restrict channel, uint64_t sequence)
+{
+    return (channel_slot_t *)&channel->slots[(sequence % channel->num_slots) * channel->slot_stride];
+}
+
+void
+channel_close(channel_t *restrict channel)
+{
+    __atomic_store_n(&channel->header->closed, 1, __ATOMIC_RELEASE);
+}
+
+void
+channel_complete(channel_t *restrict channel, int status, uint64_t num_ops, uint64_t response)
+{
+    uint64_t tail = channel->header->tail;
+    channel_slot_t *slot = channel_slot(channel, tail);
+    slot->status = status;
+    slot->num_ops = num_ops;
+    slot->response = response;
+    /* Publish the status and release the slot */
+    __atomic_store_n(&channel->header->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+channel_t *
+channel_create(const char *restrict path, size_t slot_size, size_t num_slots)
+{
+    channel_t *channel = (channel_t *)calloc(1, sizeof(*channel));
+    if (channel == NULL) {
+        channel_error(channel, 0, errno, __func__);
+        return NULL;
+    }
+
+    if (channel_geometry(channel, slot_size, num_slots, SIZE_MAX) == -1) {
+        errno = EINVAL;
+        channel_error(channel, 0, errno, __func__);
+        goto err;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        channel_error(channel, 0, errno, __func__);
+        goto err;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        channel_error(channel, 0, errno, __func__);
+        goto err;
+    }
+
+    /* Preallocate regular files (zeroed). Other files (e.g., the resource file
+       of a shared memory BAR) are mapped as they are, and cleared. */
+    if (S_ISREG(st.st_mode)) {
+        if (ftruncate(fd, 0) == -1 || ftruncate(fd, channel->size) == -1) {
+            close(fd);
+            channel_error(channel, 0, errno, __func__);
+            goto err;
+        }
+    }
+
+    void *map = mmap(NULL, channel->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        channel_error(channel, 0, errno, __func__);
+        goto err;
+    }
+
+    channel->header = (channel_header_t *)map;
+    channel->slots = (uint8_t *)(channel->header + 1);
+    if (!S_ISREG(st.st_mode)) {
+        memset(channel->header, 0, channel->size);
+    }
+
+    channel->header->version = CHANNEL_VERSION;
+    channel->header->slot_size = slot_size;
+    channel->header->num_slots = num_slots;
+    /* Publish the header last, so the fuzzer never opens a channel that is not
+       completely initialized. */
+    __atomic_store_n(&channel->header->magic, CHANNEL_MAGIC, __ATOMIC_RELEASE);
+    return channel;
+
+err:
+    channel_destroy(channel);
+    return NULL;
+}
+
+void
+channel_destroy(channel_t *restrict channel)
+{
+    if (channel == NULL) {
+        return;
+    }
+
+    if (channel->header != NULL) {
+        munmap(channel->header, channel->size);
+    }
+
+    free(channel);
+}
+
+void
+channel_error(channel_t *restrict channel, int status, int error, const char *restrict format, ...)
+{
+    if (error_handler == NULL) {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, format);
+    (*error_handler)(status, error, format, ap);
+    va_end(ap);
+}
+
+int
+channel_geometry(channel_t *restrict channel, size_t slot_size, size_t num_slots, size_t max_size)
+{
+    /* Sets the geometry of the ring buffer, or returns -1 if it is invalid or
+       does not fit in max_size bytes. The number of slots is checked by
+       division, as it may be read from a file that the other end controls,
+       and would wrap the size of the ring buffer. */
+    if (slot_size == 0 || slot_size > UINT32_MAX || num_slots == 0) {
+        return -1;
+    }
+
+    size_t slot_stride = (sizeof(channel_slot_t) + slot_size + 63) & ~(size_t)63;
+    if (max_size < sizeof(*channel->header) || num_slots > ((max_size - sizeof(*channel->header)) / slot_stride)) {
+        return -1;
+    }
+
+    channel->slot_size = slot_size;
+    channel->slot_stride = slot_stride;
+    channel->num_slots = num_slots;
+    channel->size = sizeof(*channel->header) + (num_slots * slot_stride);
+    return 0;
+}
+
+const channel_slot_t *
+channel_get_slot(channel_t *restrict channel, uint64_t sequence)
+{
+    return channel_slot(channel, sequence);
+}
+
+uint64_t
+channel_get_tail(channel_t *restrict channel)
+{
+    return __atomic_load_n(&channel->header->tail, __ATOMIC_ACQUIRE);
+}
+
+int
+channel_is_closed(channel_t *restrict channel)
+{
+    return __atomic_load_n(&channel->header->closed, __ATOMIC_ACQUIRE) != 0;
+}
+
+channel_t *
+channel_open(const char *restrict path)
+{
+    channel_t *channel = (channel_t *)calloc(1, sizeof(*channel));
+    if (channel == NULL) {
+        channel_error(channel, 0, errno, __func__);
+        return NULL;
+    }
+
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd == -1) {
+        channel_error(channel, 0, errno, __func__);
+        goto err;
+    }
+
+    /* Read the header first to find the size of the ring buffer */
+    channel_header_t header;
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+        close(fd);
+        channel_error(channel, 0, 0, "%s: Truncated file.\n", __func__);
+        goto err;
+    }
+
+    if (header.magic != CHANNEL_MAGIC || header.version != CHANNEL_VERSION || header.slot_size == 0
+            || header.num_slots == 0) {
+        close(fd);
+        channel_error(channel, 0, 0, "%s: Invalid file.\n", __func__);
+        goto err;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        channel_error(channel, 0, errno, __func__);
+        goto err;
+    }
+
+    /* The geometry of the ring buffer is read once, so the other end cannot
+       change it afterwards. */
+    size_t max_size = S_ISREG(st.st_mode) ? (size_t)st.st_size : SIZE_MAX;
+    if (channel_geometry(channel, header.slot_size, header.num_slots, max_size) == -1) {
+        close(fd);
+        channel_error(channel, 0, 0, "%s: Truncated file.\n", __func__);
+        goto err;
+    }
+
+    void *map = mmap(NULL, channel->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        channel_error(channel, 0, errno, __func__);
+        goto err;
+    }
+
+    channel->header = (channel_header_t *)map;
+    channel->slots = (uint8_t *)(channel->header + 1);
+    return channel;
+
+err:
+    channel_destroy(channel);
+    return NULL;
+}
+
+const void *
+channel_receive(channel_t *restrict channel, size_t *size)
+{
+    uint64_t tail = channel->header->tail;
+    if (__atomic_load_n(&channel->header->head, __ATOMIC_ACQUIRE) == tail) {
+        return NULL;
+    }
+
+    channel_slot_t *slot = channel_slot(channel, tail);
+    *size = (slot->size < channel->slot_size) ? slot->size : channel->slot_size;
+    return slot + 1;
+}
+
+int
+channel_send(channel_t *restrict channel, const void *buf, size_t size, uint64_t *sequence)
+{
+    if (size > channel->slot_size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    uint64_t head = channel->header->head;
+    if ((head - __atomic_load_n(&channel->header->tail, __ATOMIC_ACQUIRE)) >= channel->num_slots) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    channel_slot_t *slot = channel_slot(channel, head);
+    slot->sequence = head;
+    slot->size = size;
+    slot->status = CHANNEL_PENDING;
+    slot->num_ops = 0;
+    slot->response = 0;
+    memcpy(slot + 1, buf, size);
+    /* Publish the test case */
+    __atomic_store_n(&channel->header->head, head + 1, __ATOMIC_RELEASE);
+    if (sequence != NULL) {
+        *sequence = head;
+    }
+
+    return 0;
+}
+
+channel_error_handler_t *
+channel_set_error_handler(channel_error_handler_t *handler)
+{
+    channel_error_handler_t *previous_handler = error_handler;
+    error_handler = handler;
+    return previous_handler;
+}
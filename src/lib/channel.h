@@ -0,0 +1,185 @@
+/** @file */
+
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHANNEL_MAGIC UINT64_C(0x4e48435a46494350) /**< "PCIFZCHN" */
+#define CHANNEL_VERSION 1
+#define CHANNEL_NUM_SLOTS 256
+#define CHANNEL_SLOT_SIZE 4096
+
+typedef struct _channel channel_t; /**< Test case channel. */
+
+typedef void channel_error_handler_t(int status, int error, const char *restrict format, va_list ap);
+
+/**
+ * Test case status.
+ */
+enum channel_status {
+    CHANNEL_PENDING,     /**< The test case was sent but not performed yet. */
+    CHANNEL_DONE,        /**< The test case was performed. */
+    CHANNEL_REJECTED,    /**< The test case could not be decoded (e.g., it is empty). */
+    CHANNEL_NUM_STATUSES /**< Number of statuses. */
+};
+
+/**
+ * Test case channel file header.
+ *
+ * The header is followed by num_slots slots laid out as a single-producer,
+ * single-consumer ring buffer. The head (written only by the controller) and
+ * the tail (written only by the fuzzer) are in cache lines of their own. All
+ * fields are in host byte order.
+ */
+typedef struct channel_header {
+    uint64_t magic;     /**< Magic number (see CHANNEL_MAGIC). */
+    uint32_t version;   /**< Version (see CHANNEL_VERSION). */
+    uint32_t slot_size; /**< Size of the test case data of each slot. */
+    uint64_t num_slots; /**< Number of slots in the ring buffer. */
+    uint64_t closed;    /**< Whether the controller will send no more test cases. */
+    uint64_t reserved[4];
+    uint64_t head; /**< Number of test cases ever sent. */
+    uint64_t reserved_head[7];
+    uint64_t tail; /**< Number of test cases ever performed. */
+    uint64_t reserved_tail[7];
+} channel_header_t;
+
+/**
+ * Test case channel slot.
+ *
+ * The test case data follows the slot, and the slots are padded to a multiple
+ * of 64 bytes.
+ */
+typedef struct channel_slot {
+    uint64_t sequence; /**< Sequence number (i.e., index since creation). */
+    uint64_t size;     /**< Test case size. */
+    uint64_t status;   /**< Status (see channel_status). */
+    uint64_t num_ops;  /**< Number of operations performed. */
+    uint64_t response; /**< Response fingerprint (see pci_fuzzer_get_fingerprint()). */
+    uint64_t reserved[3];
+} channel_slot_t;
+
+/**
+ * Closes the channel (i.e., tells the fuzzer that no more test cases will be
+ * sent, so it stops once it has performed the test cases already sent).
+ *
+ * @param [in] channel Test case channel.
+ */
+void channel_close(channel_t *restrict channel);
+
+/**
+ * Completes the oldest test case received (see channel_receive()), and posts
+ * its status back to the controller.
+ *
+ * @param [in] channel Test case channel.
+ * @param [in] status Status (see channel_status).
+ * @param [in] num_ops Number of operations performed.
+ * @param [in] response Response fingerprint.
+ */
+void channel_complete(channel_t *restrict channel, int status, uint64_t num_ops, uint64_t response);
+
+/**
+ * Creates a test case channel (i.e., the controller end of it).
+ *
+ * The file is created (or truncated) and mapped shared, as the flight recorder
+ * file is (see recorder_create()), so it can be a file in a shared memory file
+ * system (e.g., /dev/shm) or the resource file of a shared memory BAR (e.g.,
+ * of an ivshmem device).
+ *
+ * @param [in] path File name.
+ * @param [in] slot_size Maximum size of each test case.
+ * @param [in] num_slots Number of slots in the ring buffer.
+ * @return A test case channel.
+ */
+channel_t *channel_create(const char *restrict path, size_t slot_size, size_t num_slots);
+
+/**
+ * Destroys the test case channel.
+ *
+ * @param [in] channel Test case channel.
+ */
+void channel_destroy(channel_t *restrict channel);
+
+/**
+ * Returns a slot of the test case channel.
+ *
+ * The status fields of the slot are valid once the test case is performed
+ * (i.e., once channel_get_tail() is greater than its sequence number), and
+ * until the controller sends another test case in the same slot.
+ *
+ * @param [in] channel Test case channel.
+ * @param [in] sequence Sequence number.
+ * @return Slot.
+ */
+const channel_slot_t *channel_get_slot(channel_t *restrict channel, uint64_t sequence);
+
+/**
+ * Returns the number of test cases ever performed.
+ *
+ * @param [in] channel Test case channel.
+ * @return Number of test cases performed.
+ */
+uint64_t channel_get_tail(channel_t *restrict channel);
+
+/**
+ * Returns whether the controller closed the channel (see channel_close()).
+ *
+ * @param [in] channel Test case channel.
+ * @return Whether the channel is closed.
+ */
+int channel_is_closed(channel_t *restrict channel);
+
+/**
+ * Opens an existing test case channel (i.e., the fuzzer end of it).
+ *
+ * The fuzzer resumes from the oldest test case not performed yet.
+ *
+ * @param [in] path File name.
+ * @return A test case channel.
+ */
+channel_t *channel_open(const char *restrict path);
+
+/**
+ * Receives the oldest test case not performed yet, without waiting.
+ *
+ * No system calls are made, so the fuzzer can poll the channel.
+ *
+ * @param [in] channel Test case channel.
+ * @param [out] size Test case size.
+ * @return Test case data (valid until channel_complete() is called), or NULL
+ *   if there is no test case.
+ */
+const void *channel_receive(channel_t *restrict channel, size_t *size);
+
+/**
+ * Sends a test case, without waiting.
+ *
+ * @param [in] channel Test case channel.
+ * @param [in] buf Test case data.
+ * @param [in] size Test case size.
+ * @param [out] sequence Sequence number of the test case (or NULL).
+ * @return 0 on success, or -1 (and errno is set to EAGAIN) if the ring buffer
+ *   is full, or (to EINVAL) if the test case is too large.
+ */
+int channel_send(channel_t *restrict channel, const void *buf, size_t size, uint64_t *sequence);
+
+/**
+ * Sets the error handler for the test case channel.
+ *
+ * @param [in] handler Error handler.
+ * @return Previous error handler.
+ */
+channel_error_handler_t *channel_set_error_handler(channel_error_handler_t *handler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHANNEL_H */
@@ -0,0 +1,204 @@
+/** @file */
+
+#include "corpus.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct _corpus {
+    uint8_t *inputs;
+    size_t *sizes;
+    size_t input_size;
+    size_t num_inputs;
+    size_t max_inputs;
+    uint64_t num_added;
+    uint64_t *fingerprints;
+    size_t num_fingerprints;
+    size_t capacity;
+};
+
+static corpus_error_handler_t *error_handler = NULL;
+
+void corpus_error(corpus_t *restrict corpus, int status, int error, const char *restrict format, ...);
+
+static int
+corpus_insert(corpus_t *restrict corpus, uint64_t fingerprint)
+{
+    /* Open addressing with linear probing, where 0 marks an empty slot (so
+       fingerprint 0 is stored as 1). */
+    if (fingerprint == 0) {
+        fingerprint = 1;
+    }
+
+    size_t mask = corpus->capacity - 1;
+    for (size_t i = (fingerprint * UINT64_C(0x9e3779b97f4a7c15)) >> 32;; ++i) {
+        uint64_t *slot = &corpus->fingerprints[i & mask];
+        if (*slot == fingerprint) {
+            return 0;
+        }
+
+        if (*slot == 0) {
+            *slot = fingerprint;
+            ++corpus->num_fingerprints;
+            return 1;
+        }
+    }
+}
+
+static int
+corpus_resize(corpus_t *restrict corpus)
+{
+    size_t capacity = corpus->capacity * 2;
+    if (capacity > CORPUS_MAX_FINGERPRINTS) {
+        /* Forget the fingerprints instead of growing any further */
+        memset(corpus->fingerprints, 0, corpus->capacity * sizeof(*corpus->fingerprints));
+        corpus->num_fingerprints = 0;
+        return 0;
+    }
+
+    uint64_t *fingerprints = (uint64_t *)calloc(capacity, sizeof(*fingerprints));
+    if (fingerprints == NULL) {
+        return -1;
+    }
+
+    uint64_t *old_fingerprints = corpus->fingerprints;
+    size_t old_capacity = corpus->capacity;
+    corpus->fingerprints = fingerprints;
+    corpus->capacity = capacity;
+    corpus->num_fingerprints = 0;
+    for (size_t i = 0; i < old_capacity; ++i) {
+        if (old_fingerprints[i] != 0) {
+            corpus_insert(corpus, old_fingerprints[i]);
+        }
+    }
+
+    free(old_fingerprints);
+    return 0;
+}
+
+int
+corpus_add(corpus_t *restrict corpus, uint64_t fingerprint, const void *buf, size_t size)
+{
+    /* Keep the load factor at most 1/2 */
+    if ((corpus->num_fingerprints * 2) >= corpus->capacity && corpus_resize(corpus) == -1) {
+        corpus_error(corpus, 0, errno, __func__);
+        return -1;
+    }
+
+    if (corpus_insert(corpus, fingerprint) == 0) {
+        return 0;
+    }
+
+    corpus_append(corpus, buf, size);
+    return 1;
+}
+
+void
+corpus_append(corpus_t *restrict corpus, const void *buf, size_t size)
+{
+    size_t index = corpus->num_added % corpus->max_inputs;
+    if (size > corpus->input_size) {
+        size = corpus->input_size;
+    }
+
+    memcpy(&corpus->inputs[index * corpus->input_size], buf, size);
+    corpus->sizes[index] = size;
+    ++corpus->num_added;
+    if (corpus->num_inputs < corpus->max_inputs) {
+        ++corpus->num_inputs;
+    }
+}
+
+corpus_t *
+corpus_create(size_t input_size, size_t num_inputs)
+{
+    corpus_t *corpus = (corpus_t *)calloc(1, sizeof(*corpus));
+    if (corpus == NULL) {
+        corpus_error(corpus, 0, errno, __func__);
+        return NULL;
+    }
+
+    if (input_size == 0 || num_inputs == 0) {
+        errno = EINVAL;
+        corpus_error(corpus, 0, errno, __func__);
+        goto err;
+    }
+
+    corpus->input_size = input_size;
+    corpus->max_inputs = num_inputs;
+    corpus->inputs = (uint8_t *)calloc(num_inputs, input_size);
+    corpus->sizes = (size_t *)calloc(num_inputs, sizeof(*corpus->sizes));
+    if (corpus->inputs == NULL || corpus->sizes == NULL) {
+        corpus_error(corpus, 0, errno, __func__);
+        goto err;
+    }
+
+    corpus->capacity = 1024;
+    corpus->fingerprints = (uint64_t *)calloc(corpus->capacity, sizeof(*corpus->fingerprints));
+    if (corpus->fingerprints == NULL) {
+        corpus_error(corpus, 0, errno, __func__);
+        goto err;
+    }
+
+    return corpus;
+
+err:
+    corpus_destroy(corpus);
+    return NULL;
+}
+
+void
+corpus_destroy(corpus_t *restrict corpus)
+{
+    if (corpus == NULL) {
+        return;
+    }
+
+    free(corpus->fingerprints);
+    free(corpus->sizes);
+    free(corpus->inputs);
+    free(corpus);
+}
+
+void
+corpus_error(corpus_t *restrict corpus, int status, int error, const char *restrict format, ...)
+{
+    if (error_handler == NULL) {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, format);
+    (*error_handler)(status, error, format, ap);
+    va_end(ap);
+}
+
+const void *
+corpus_get_input(corpus_t *restrict corpus, size_t index, size_t *size)
+{
+    *size = corpus->sizes[index];
+    return &corpus->inputs[index * corpus->input_size];
+}
+
+uint64_t
+corpus_get_num_added(corpus_t *restrict corpus)
+{
+    return corpus->num_added;
+}
+
+size_t
+corpus_get_num_inputs(corpus_t *restrict corpus)
+{
+    return corpus->num_inputs;
+}
+
+corpus_error_handler_t *
+corpus_set_error_handler(corpus_error_handler_t *handler)
+{
+    corpus_error_handler_t *previous_handler = error_handler;
+    error_handler = handler;
+    return previous_handler;
+}
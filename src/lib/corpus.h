@@ -0,0 +1,108 @@
+/** @file */
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CORPUS_NUM_INPUTS 4096
+#define CORPUS_MAX_FINGERPRINTS (1 << 22)
+
+typedef struct _corpus corpus_t; /**< Corpus. */
+
+typedef void corpus_error_handler_t(int status, int error, const char *restrict format, va_list ap);
+
+/**
+ * Adds an input to the corpus if its response fingerprint was never seen.
+ *
+ * The input is copied into the corpus (see corpus_append()). Once
+ * CORPUS_MAX_FINGERPRINTS fingerprints were seen, the fingerprints are
+ * forgotten, so the memory used by the corpus is bounded no matter how many
+ * distinct responses the device produces.
+ *
+ * @param [in] corpus Corpus.
+ * @param [in] fingerprint Response fingerprint (e.g., see
+ *   pci_fuzzer_get_response()).
+ * @param [in] buf Input buffer.
+ * @param [in] size Input size.
+ * @return 1 if the input was added, 0 if the fingerprint was already seen, or
+ *   -1 if an error occurs.
+ */
+int corpus_add(corpus_t *restrict corpus, uint64_t fingerprint, const void *buf, size_t size);
+
+/**
+ * Adds an input to the corpus unconditionally (e.g., a seed input).
+ *
+ * The input is copied into the corpus, truncated to the maximum input size.
+ * Once the corpus is full, each new input replaces the oldest one.
+ *
+ * @param [in] corpus Corpus.
+ * @param [in] buf Input buffer.
+ * @param [in] size Input size.
+ */
+void corpus_append(corpus_t *restrict corpus, const void *buf, size_t size);
+
+/**
+ * Creates a corpus (i.e., an in-memory set of inputs with distinct response
+ * fingerprints).
+ *
+ * @param [in] input_size Maximum size of each input.
+ * @param [in] num_inputs Maximum number of inputs.
+ * @return A corpus.
+ */
+corpus_t *corpus_create(size_t input_size, size_t num_inputs);
+
+/**
+ * Destroys the corpus.
+ *
+ * @param [in] corpus Corpus.
+ */
+void corpus_destroy(corpus_t *restrict corpus);
+
+/**
+ * Returns an input of the corpus.
+ *
+ * @param [in] corpus Corpus.
+ * @param [in] index Input index (in the range given by the interval
+ *   [0,corpus_get_num_inputs())).
+ * @param [out] size Input size.
+ * @return Input buffer.
+ */
+const void *corpus_get_input(corpus_t *restrict corpus, size_t index, size_t *size);
+
+/**
+ * Returns the number of inputs in the corpus.
+ *
+ * @param [in] corpus Corpus.
+ * @return Number of inputs.
+ */
+size_t corpus_get_num_inputs(corpus_t *restrict corpus);
+
+/**
+ * Returns the number of inputs ever added to the corpus (i.e., the number of
+ * seed inputs and distinct response fingerprints seen).
+ *
+ * @param [in] corpus Corpus.
+ * @return Number of inputs added.
+ */
+uint64_t corpus_get_num_added(corpus_t *restrict corpus);
+
+/**
+ * Sets the error handler for the corpus.
+ *
+ * @param [in] handler Error handler.
+ * @return Previous error handler.
+ */
+corpus_error_handler_t *corpus_set_error_handler(corpus_error_handler_t *handler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORPUS_H */
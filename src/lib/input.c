@@ -2,8 +2,9 @@
 
 #include "input.h"
 
+#include "input_buffer.h"
+
 #include <errno.h>
-#include <math.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -23,28 +24,32 @@ double
 input_derive_double(FILE *restrict stream)
 {
     uint64_t input = input_read64(stream);
-    return input / (double)UINT64_MAX;
+    double result = input / (double)UINT64_MAX;
+    /* Inputs close to UINT64_MAX round to 1 */
+    return (result < 1) ? result : 0x1.fffffffffffffp-1;
 }
 
 unsigned long
 input_derive_fermat_number(FILE *restrict stream)
 {
     unsigned long result = input_derive_range(stream, 1, 31);
-    return pow(2, result) + 1;
+    return (1UL << result) + 1;
 }
 
 float
 input_derive_float(FILE *restrict stream)
 {
     uint32_t input = input_read32(stream);
-    return input / (float)UINT32_MAX;
+    float result = input / (float)UINT32_MAX;
+    /* Inputs close to UINT32_MAX round to 1 */
+    return (result < 1) ? result : 0x1.fffffep-1f;
 }
 
 unsigned long
 input_derive_mersenne_number(FILE *restrict stream)
 {
     unsigned long result = input_derive_range(stream, 1, 32);
-    return pow(2, result) - 1;
+    return (1UL << result) - 1;
 }
 
 void
@@ -60,6 +65,13 @@ input_error(FILE *restrict stream, int status, int error, const char *restrict f
     va_end(ap);
 }
 
+void
+input_buffer_underflow(input_buffer_t *restrict buffer, const char *restrict function)
+{
+    input_error(NULL, 0, 0, "%s: Unexpected end of input.\n", function);
+    abort();
+}
+
 unsigned long
 input_derive_range(FILE *restrict stream, unsigned long begin, unsigned long end)
 {
@@ -0,0 +1,312 @@
+/** @file */
+
+#ifndef INPUT_BUFFER_H
+#define INPUT_BUFFER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Input buffer.
+ *
+ * A cursor over a caller-owned byte buffer that mirrors the input stream
+ * interface (see input.h) without any stream setup, teardown, or locking. The
+ * buffer is not copied and must outlive the cursor.
+ *
+ * Bit-packed fields (see input_buffer_read_bits()) are read through a small
+ * reservoir of the bits loaded from the buffer but not read yet, so consecutive
+ * fields share bytes. Byte-aligned reads ignore the reservoir.
+ */
+typedef struct input_buffer {
+    const uint8_t *data;   /**< Buffer data. */
+    size_t size;           /**< Buffer size. */
+    size_t position;       /**< Cursor position. */
+    uint64_t bits;         /**< Bits loaded from the buffer but not read yet. */
+    unsigned int num_bits; /**< Number of bits loaded from the buffer but not read yet. */
+} input_buffer_t;
+
+/**
+ * Reports an input buffer underflow and aborts.
+ *
+ * @param [in] buffer Input buffer.
+ * @param [in] function Name of the function that underflowed.
+ */
+void input_buffer_underflow(input_buffer_t *restrict buffer, const char *restrict function)
+        __attribute__((__noreturn__));
+
+/**
+ * Initializes the input buffer.
+ *
+ * @param [out] buffer Input buffer.
+ * @param [in] data Buffer data.
+ * @param [in] size Buffer size.
+ */
+static inline void
+input_buffer_init(input_buffer_t *restrict buffer, const void *data, size_t size)
+{
+    buffer->data = (const uint8_t *)data;
+    buffer->size = size;
+    buffer->position = 0;
+    buffer->bits = 0;
+    buffer->num_bits = 0;
+}
+
+/**
+ * Returns the number of bytes remaining in the input buffer.
+ *
+ * @param [in] buffer Input buffer.
+ * @return Number of bytes remaining.
+ */
+static inline size_t
+input_buffer_get_remaining(const input_buffer_t *restrict buffer)
+{
+    return buffer->size - buffer->position;
+}
+
+/**
+ * Returns the number of bits remaining in the input buffer (i.e., including the
+ * bits loaded but not read yet).
+ *
+ * @param [in] buffer Input buffer.
+ * @return Number of bits remaining.
+ */
+static inline size_t
+input_buffer_get_remaining_bits(const input_buffer_t *restrict buffer)
+{
+    return ((buffer->size - buffer->position) * 8) + buffer->num_bits;
+}
+
+/**
+ * Reads a bit-packed unsigned integer value from the input buffer.
+ *
+ * The bits are read from the least significant bit of each byte up, so a
+ * field of n bits takes n bits of input (e.g., two 4-bit fields share a
+ * byte).
+ *
+ * @param [in] buffer Input buffer.
+ * @param [in] num_bits Number of bits (i.e., 0 to 32).
+ * @return Unsigned integer value.
+ */
+static inline uint32_t
+input_buffer_read_bits(input_buffer_t *restrict buffer, unsigned int num_bits)
+{
+    if (buffer->num_bits < num_bits && input_buffer_get_remaining(buffer) >= sizeof(uint64_t)) {
+        /* Load as many whole bytes as fit at once. The bits of the next byte
+           that fit too are loaded again (i.e., ORed with themselves) by the
+           next load. */
+        uint64_t input;
+        memcpy(&input, buffer->data + buffer->position, sizeof(input));
+        buffer->bits |= input << buffer->num_bits;
+        buffer->position += (63 - buffer->num_bits) >> 3;
+        buffer->num_bits |= 56;
+    }
+
+    while (buffer->num_bits < num_bits) {
+        if (buffer->position >= buffer->size) {
+            input_buffer_underflow(buffer, __func__);
+        }
+
+        buffer->bits |= (uint64_t)buffer->data[buffer->position++] << buffer->num_bits;
+        buffer->num_bits += 8;
+    }
+
+    uint32_t value = buffer->bits & ((UINT64_C(1) << num_bits) - 1);
+    buffer->bits >>= num_bits;
+    buffer->num_bits -= num_bits;
+    return value;
+}
+
+/**
+ * Reads a variable-length unsigned integer value (i.e., an unsigned LEB128
+ * value) from the input buffer.
+ *
+ * Each group of 8 bits (see input_buffer_read_bits()) holds 7 bits of the
+ * value, from the least significant up, and whether another group follows
+ * (i.e., its most significant bit), so values below 128 take a single group.
+ *
+ * @param [in] buffer Input buffer.
+ * @param [out] value Unsigned integer value.
+ * @return Returns true if the value was read; otherwise, returns false if the
+ *   input buffer ended before the value did.
+ */
+static inline bool
+input_buffer_read_varint(input_buffer_t *restrict buffer, uint64_t *value)
+{
+    uint64_t result = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        if (input_buffer_get_remaining_bits(buffer) < 8) {
+            return false;
+        }
+
+        uint32_t group = input_buffer_read_bits(buffer, 8);
+        result |= (uint64_t)(group & 0x7f) << shift;
+        if ((group & 0x80) == 0) {
+            break;
+        }
+    }
+
+    *value = result;
+    return true;
+}
+
+#define _input_buffer_define(size, type) \
+    static inline type input_buffer_read##size(input_buffer_t *restrict buffer) \
+    { \
+        type value; \
+        if (input_buffer_get_remaining(buffer) < sizeof(type)) { \
+            input_buffer_underflow(buffer, __func__); \
+        } \
+\
+        memcpy(&value, buffer->data + buffer->position, sizeof(type)); \
+        buffer->position += sizeof(type); \
+        return value; \
+    } \
+\
+    static inline void input_buffer_read_string##size(input_buffer_t *restrict buffer, type *string, size_t count) \
+    { \
+        if ((input_buffer_get_remaining(buffer) / sizeof(type)) < count) { \
+            input_buffer_underflow(buffer, __func__); \
+        } \
+\
+        memcpy(string, buffer->data + buffer->position, count * sizeof(type)); \
+        buffer->position += count * sizeof(type); \
+    }
+
+_input_buffer_define(16, uint16_t)
+_input_buffer_define(32, uint32_t)
+_input_buffer_define(64, uint64_t)
+_input_buffer_define(8, uint8_t)
+#undef _input_buffer_define
+
+/**
+ * Derives a Boolean value from the input buffer.
+ *
+ * @param [in] buffer Input buffer.
+ * @return Boolean value.
+ */
+static inline bool
+input_buffer_derive_bool(input_buffer_t *restrict buffer)
+{
+    uint8_t input = input_buffer_read8(buffer);
+    return input & 1;
+}
+
+/**
+ * Derives a double precision floating point value in the range given by the
+ * interval [0,1) from the input buffer.
+ *
+ * @param [in] buffer Input buffer.
+ * @return Double precision floating point value in the range given by the
+ *   interval [0,1).
+ */
+static inline double
+input_buffer_derive_double(input_buffer_t *restrict buffer)
+{
+    uint64_t input = input_buffer_read64(buffer);
+    double result = input / (double)UINT64_MAX;
+    /* Inputs close to UINT64_MAX round to 1 */
+    return (result < 1) ? result : 0x1.fffffffffffffp-1;
+}
+
+/**
+ * Derives a single precision floating point value in the range given by the
+ * interval [0,1) from the input buffer.
+ *
+ * @param [in] buffer Input buffer.
+ * @return Single precision floating point value in the range given by the
+ *   interval [0,1).
+ */
+static inline float
+input_buffer_derive_float(input_buffer_t *restrict buffer)
+{
+    uint32_t input = input_buffer_read32(buffer);
+    float result = input / (float)UINT32_MAX;
+    /* Inputs close to UINT32_MAX round to 1 */
+    return (result < 1) ? result : 0x1.fffffep-1f;
+}
+
+/**
+ * Derives an unsigned long integer value in the range given by the interval
+ * [begin,end] from the input buffer.
+ *
+ * This derives the same value as input_derive_range() would from a stream
+ * with the same contents.
+ *
+ * @param [in] buffer Input buffer.
+ * @param [in] begin Beginning of the range.
+ * @param [in] end End of the range.
+ * @return Unsigned long integer value in the range given by the interval
+ *   [begin,end].
+ */
+static inline unsigned long
+input_buffer_derive_range(input_buffer_t *restrict buffer, unsigned long begin, unsigned long end)
+{
+    double result = input_buffer_derive_double(buffer);
+    return result * (end + 1) + begin;
+}
+
+/**
+ * Derives an unsigned long integer value in the range given by the interval
+ * [begin,end] from as few bits of the input buffer as the range needs (see
+ * input_buffer_read_bits()).
+ *
+ * The bits are reduced to the range with a multiplication and a shift (i.e.,
+ * with no division or floating point arithmetic), so each value of the range
+ * is derived from one or two bit patterns.
+ *
+ * @param [in] buffer Input buffer.
+ * @param [in] begin Beginning of the range.
+ * @param [in] end End of the range (at most begin+(2^32)-1).
+ * @return Unsigned long integer value in the range given by the interval
+ *   [begin,end].
+ */
+static inline unsigned long
+input_buffer_derive_packed_range(input_buffer_t *restrict buffer, unsigned long begin, unsigned long end)
+{
+    uint64_t num_values = (uint64_t)(end - begin) + 1;
+    unsigned int num_bits = (num_values > 1) ? (64 - __builtin_clzll(num_values - 1)) : 0;
+    uint64_t input = input_buffer_read_bits(buffer, num_bits);
+    return begin + ((input * num_values) >> num_bits);
+}
+
+/**
+ * Derives a Fermat number given by the binomial number of the form (2^n)+1 in
+ * the range given by the interval [3,(2^31)+1] from the input buffer.
+ *
+ * @param [in] buffer Input buffer.
+ * @return Fermat number given by the binomial number of the form (2^n)+1 in the
+ *   range given by the interval [3,(2^31)+1].
+ */
+static inline unsigned long
+input_buffer_derive_fermat_number(input_buffer_t *restrict buffer)
+{
+    unsigned long result = input_buffer_derive_range(buffer, 1, 31);
+    return (1UL << result) + 1;
+}
+
+/**
+ * Derives a Mersenne number given by the binomial number of the form (2^n)-1 in
+ * the range given by the interval [1,2^32) from the input buffer.
+ *
+ * @param [in] buffer Input buffer.
+ * @return Mersenne number given by the binomial number of the form (2^n)-1 in
+ *   the range given by the interval [1,2^32).
+ */
+static inline unsigned long
+input_buffer_derive_mersenne_number(input_buffer_t *restrict buffer)
+{
+    unsigned long result = input_buffer_derive_range(buffer, 1, 32);
+    return (1UL << result) - 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INPUT_BUFFER_H */
@@ -0,0 +1,218 @@
+/** @file */
+
+#include "latency.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Histograms are only written by the thread that records the latencies, so
+   they are updated without atomic read-modify-write instructions. */
+#define latency_add(counter, addend) __atomic_store_n(&(counter), (counter) + (addend), __ATOMIC_RELAXED)
+#define latency_load(counter) __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+
+struct histogram {
+    uint64_t sum;
+    uint64_t buckets[LATENCY_NUM_BUCKETS];
+};
+
+struct _latency {
+    struct latency_region {
+        size_t size;
+        unsigned int shift;
+        size_t num_ranges;
+        struct histogram *histograms;
+    } *regions;
+    size_t num_regions;
+};
+
+static latency_error_handler_t *error_handler = NULL;
+
+static const char *direction_names[LATENCY_NUM_DIRECTIONS] = {
+    [LATENCY_READ] = "read",
+    [LATENCY_WRITE] = "write",
+    [LATENCY_READ_STRING] = "read_string",
+    [LATENCY_WRITE_STRING] = "write_string",
+    [LATENCY_READ_BURST] = "read_burst",
+    [LATENCY_WRITE_BURST] = "write_burst",
+};
+
+void latency_error(latency_t *restrict latency, int status, int error, const char *restrict format, ...);
+uint64_t latency_percentile(const uint64_t *buckets, uint64_t count, unsigned int percentile);
+
+latency_t *
+latency_create(pci_device_t *restrict pci_device)
+{
+    latency_t *latency = (latency_t *)calloc(1, sizeof(*latency));
+    if (latency == NULL) {
+        latency_error(latency, 0, errno, __func__);
+        return NULL;
+    }
+
+    latency->num_regions = pci_device_get_num_regions(pci_device);
+    latency->regions = (struct latency_region *)calloc(latency->num_regions, sizeof(*latency->regions));
+    if (latency->regions == NULL) {
+        latency_error(latency, 0, errno, __func__);
+        goto err;
+    }
+
+    for (size_t i = 0; i < latency->num_regions; ++i) {
+        struct latency_region *region = &latency->regions[i];
+        region->size = pci_device_region_get_size(pci_device, i);
+        if (region->size == 0) {
+            continue;
+        }
+
+        /* Split the region into offset ranges of a power of two size (e.g.,
+           4 bytes for a 256-byte I/O region), so each histogram covers a few
+           registers at most. */
+        while (((region->size - 1) >> region->shift) >= LATENCY_NUM_RANGES) {
+            ++region->shift;
+        }
+
+        region->num_ranges = ((region->size - 1) >> region->shift) + 1;
+        region->histograms = (struct histogram *)calloc(
+                region->num_ranges * LATENCY_NUM_WIDTHS * LATENCY_NUM_DIRECTIONS, sizeof(*region->histograms));
+        if (region->histograms == NULL) {
+            latency_error(latency, 0, errno, __func__);
+            goto err;
+        }
+    }
+
+    return latency;
+
+err:
+    latency_destroy(latency);
+    return NULL;
+}
+
+void
+latency_destroy(latency_t *restrict latency)
+{
+    if (latency == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; latency->regions != NULL && i < latency->num_regions; ++i) {
+        free(latency->regions[i].histograms);
+    }
+
+    free(latency->regions);
+    free(latency);
+}
+
+void
+latency_error(latency_t *restrict latency, int status, int error, const char *restrict format, ...)
+{
+    if (error_handler == NULL) {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, format);
+    (*error_handler)(status, error, format, ap);
+    va_end(ap);
+}
+
+uint64_t
+latency_percentile(const uint64_t *buckets, uint64_t count, unsigned int percentile)
+{
+    /* Returns the upper bound of the bucket of the percentile */
+    uint64_t total = 0;
+    for (size_t i = 0; i < LATENCY_NUM_BUCKETS; ++i) {
+        total += buckets[i];
+        if ((total * 100) >= (count * percentile)) {
+            return UINT64_C(1) << i;
+        }
+    }
+
+    return UINT64_C(1) << (LATENCY_NUM_BUCKETS - 1);
+}
+
+void
+latency_record(
+        latency_t *restrict latency, size_t region, size_t offset, size_t width, int direction, uint64_t cycles)
+{
+    if (region >= latency->num_regions || latency->regions[region].histograms == NULL) {
+        return;
+    }
+
+    struct latency_region *latency_region = &latency->regions[region];
+    size_t range = offset >> latency_region->shift;
+    if (range >= latency_region->num_ranges) {
+        range = latency_region->num_ranges - 1;
+    }
+
+    size_t index = (((range * LATENCY_NUM_WIDTHS) + __builtin_ctzl(width)) * LATENCY_NUM_DIRECTIONS) + direction;
+    struct histogram *histogram = &latency_region->histograms[index];
+    size_t bucket = (cycles != 0) ? (64 - __builtin_clzll(cycles)) : 0;
+    if (bucket >= LATENCY_NUM_BUCKETS) {
+        bucket = LATENCY_NUM_BUCKETS - 1;
+    }
+
+    latency_add(histogram->sum, cycles);
+    latency_add(histogram->buckets[bucket], 1);
+}
+
+latency_error_handler_t *
+latency_set_error_handler(latency_error_handler_t *handler)
+{
+    latency_error_handler_t *previous_handler = error_handler;
+    error_handler = handler;
+    return previous_handler;
+}
+
+int
+latency_write(latency_t *restrict latency, FILE *restrict stream)
+{
+    for (size_t i = 0; i < latency->num_regions; ++i) {
+        const struct latency_region *region = &latency->regions[i];
+        for (size_t j = 0; j < (region->num_ranges * LATENCY_NUM_WIDTHS * LATENCY_NUM_DIRECTIONS); ++j) {
+            struct histogram *histogram = &region->histograms[j];
+            uint64_t buckets[LATENCY_NUM_BUCKETS];
+            uint64_t count = 0;
+            size_t last = 0;
+            for (size_t k = 0; k < LATENCY_NUM_BUCKETS; ++k) {
+                buckets[k] = latency_load(histogram->buckets[k]);
+                count += buckets[k];
+                if (buckets[k] != 0) {
+                    last = k;
+                }
+            }
+
+            if (count == 0) {
+                continue;
+            }
+
+            size_t range = j / (LATENCY_NUM_WIDTHS * LATENCY_NUM_DIRECTIONS);
+            size_t width = (size_t)1 << ((j / LATENCY_NUM_DIRECTIONS) % LATENCY_NUM_WIDTHS);
+            fprintf(stream,
+                    "{ \"region\": %zu, \"offset\": %zu, \"size\": %zu, \"width\": %zu, \"direction\": \"%s\", "
+                    "\"count\": %" PRIu64 ", \"mean\": %.1f, \"p50\": %" PRIu64 ", \"p90\": %" PRIu64
+                    ", \"p99\": %" PRIu64 ", \"max\": %" PRIu64 ", \"buckets\": {",
+                    i, range << region->shift, (size_t)1 << region->shift, width * 8,
+                    direction_names[j % LATENCY_NUM_DIRECTIONS], count, (double)latency_load(histogram->sum) / count,
+                    latency_percentile(buckets, count, 50), latency_percentile(buckets, count, 90),
+                    latency_percentile(buckets, count, 99), UINT64_C(1) << last);
+            const char *separator = " ";
+            for (size_t k = 0; k <= last; ++k) {
+                if (buckets[k] != 0) {
+                    fprintf(stream, "%s\"%" PRIu64 "\": %" PRIu64, separator, UINT64_C(1) << k, buckets[k]);
+                    separator = ", ";
+                }
+            }
+
+            fprintf(stream, " } }\n");
+        }
+    }
+
+    if (fflush(stream) == EOF || ferror(stream)) {
+        latency_error(latency, 0, errno, __func__);
+        return -1;
+    }
+
+    return 0;
+}
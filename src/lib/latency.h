@@ -0,0 +1,138 @@
+/** @file */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "pci_device.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define LATENCY_NUM_BUCKETS 48 /**< Number of buckets of each histogram. */
+#define LATENCY_NUM_RANGES 64  /**< Maximum number of offset ranges of each region. */
+#define LATENCY_NUM_WIDTHS 6   /**< Number of access widths (i.e., 1 to 32 bytes). */
+
+typedef struct _latency latency_t; /**< Latency histograms. */
+
+/**
+ * Access directions.
+ */
+enum latency_direction {
+    LATENCY_READ,          /**< Read. */
+    LATENCY_WRITE,         /**< Write. */
+    LATENCY_READ_STRING,   /**< String read (i.e., rep ins). */
+    LATENCY_WRITE_STRING,  /**< String write (i.e., rep outs). */
+    LATENCY_READ_BURST,    /**< Burst read (i.e., consecutive 64-bit reads). */
+    LATENCY_WRITE_BURST,   /**< Burst write (i.e., consecutive 64-bit writes). */
+    LATENCY_NUM_DIRECTIONS /**< Number of directions. */
+};
+
+typedef void latency_error_handler_t(int status, int error, const char *restrict format, va_list ap);
+
+/**
+ * Creates latency histograms for the regions of a PCI device.
+ *
+ * Each region is split into (at most LATENCY_NUM_RANGES) offset ranges of a
+ * power of two size, and there is a histogram for each offset range, access
+ * width, and direction (see latency_direction). The histograms are log-bucketed (i.e., bucket i counts
+ * the latencies in the range given by the interval [2^(i-1),2^i) cycles).
+ *
+ * @param [in] pci_device PCI device.
+ * @return Latency histograms.
+ */
+latency_t *latency_create(pci_device_t *restrict pci_device);
+
+/**
+ * Destroys the latency histograms.
+ *
+ * @param [in] latency Latency histograms.
+ */
+void latency_destroy(latency_t *restrict latency);
+
+/**
+ * Records the latency of an access.
+ *
+ * Accesses to regions the PCI device did not have when the histograms were
+ * created are ignored.
+ *
+ * @param [in] latency Latency histograms.
+ * @param [in] region Region number.
+ * @param [in] offset Region offset.
+ * @param [in] width Access width, in bytes (i.e., a power of two up to 32).
+ * @param [in] direction Direction (see latency_direction).
+ * @param [in] cycles Latency, in time stamp counter cycles (per value, for
+ *   string and burst accesses).
+ */
+void latency_record(
+        latency_t *restrict latency, size_t region, size_t offset, size_t width, int direction, uint64_t cycles);
+
+/**
+ * Sets the error handler for the latency histograms.
+ *
+ * @param [in] handler Error handler.
+ * @return Previous error handler.
+ */
+latency_error_handler_t *latency_set_error_handler(latency_error_handler_t *handler);
+
+/**
+ * Returns the time stamp counter at the start of an access.
+ *
+ * The preceding instructions complete before the time stamp counter is read.
+ *
+ * @return Time stamp counter.
+ */
+static inline uint64_t
+latency_start(void)
+{
+    uint32_t low;
+    uint32_t high;
+    asm volatile("lfence; rdtsc" : "=a"(low), "=d"(high) : : "memory");
+    return ((uint64_t)high << 32) | low;
+}
+
+/**
+ * Returns the time stamp counter at the end of an access.
+ *
+ * The access completes before the time stamp counter is read, and the
+ * following instructions start after it is read.
+ *
+ * @return Time stamp counter.
+ */
+static inline uint64_t
+latency_stop(void)
+{
+    uint32_t low;
+    uint32_t high;
+    asm volatile("rdtscp; lfence" : "=a"(low), "=d"(high) : : "ecx", "memory");
+    return ((uint64_t)high << 32) | low;
+}
+
+/**
+ * Writes the latency histograms to a stream.
+ *
+ * Each histogram with any latencies is written as a JSON line with its key
+ * (i.e., the region, offset range, access width, and direction), the number of
+ * accesses, their mean latency, the upper bounds of the buckets of the 50th,
+ * 90th, and 99th percentiles and of the last bucket, and the nonempty buckets
+ * (by their upper bounds). All latencies are in time stamp counter cycles.
+ *
+ * This can be called while latencies are being recorded (e.g., by another
+ * thread), and the counters can then be slightly inconsistent with each other.
+ *
+ * @param [in] latency Latency histograms.
+ * @param [in] stream Stream.
+ * @return 0 on success, or -1 if an error occurs.
+ */
+int latency_write(latency_t *restrict latency, FILE *restrict stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LATENCY_H */
@@ -0,0 +1,109 @@
+/** @file */
+
+#ifndef MMIO_H
+#define MMIO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Each access is a single instruction of the given width (i.e., the compiler
+   can neither split, merge, nor elide it), and is ordered with respect to the
+   other accesses and memory operations of the thread. */
+
+static inline uint64_t
+mmio_read64(const volatile void *address)
+{
+    uint64_t value;
+    asm volatile("movq %1, %0" : "=r"(value) : "m"(*(const volatile uint64_t *)address) : "memory");
+    return value;
+}
+
+static inline void
+mmio_read128(const volatile void *address, void *value)
+{
+    asm volatile("movdqu %1, %%xmm0\n\tmovdqu %%xmm0, %0"
+                 : "=m"(*(uint8_t(*)[16])value)
+                 : "m"(*(const volatile uint8_t(*)[16])address)
+                 : "xmm0", "memory");
+}
+
+static inline void
+mmio_read256(const volatile void *address, void *value)
+{
+    /* The upper halves of the vector registers are cleared afterwards, so the
+       SSE instructions that follow incur no transition penalty. */
+    asm volatile("vmovdqu %1, %%ymm0\n\tvmovdqu %%ymm0, %0\n\tvzeroupper"
+                 : "=m"(*(uint8_t(*)[32])value)
+                 : "m"(*(const volatile uint8_t(*)[32])address)
+                 : "xmm0", "memory");
+}
+
+static inline void
+mmio_read_burst(const volatile void *address, void *buf, size_t size)
+{
+    /* Consecutive 64-bit reads (and 8-bit reads of the remainder) in
+       ascending order, as a copy loop would do them */
+    size_t i = 0;
+    for (; (i + sizeof(uint64_t)) <= size; i += sizeof(uint64_t)) {
+        uint64_t value = mmio_read64((const volatile uint8_t *)address + i);
+        __builtin_memcpy((uint8_t *)buf + i, &value, sizeof(value));
+    }
+
+    for (; i < size; ++i) {
+        ((uint8_t *)buf)[i] = ((const volatile uint8_t *)address)[i];
+    }
+}
+
+static inline void
+mmio_write64(volatile void *address, uint64_t value)
+{
+    asm volatile("movq %1, %0" : "=m"(*(volatile uint64_t *)address) : "r"(value) : "memory");
+}
+
+static inline void
+mmio_write128(volatile void *address, const void *value)
+{
+    asm volatile("movdqu %1, %%xmm0\n\tmovdqu %%xmm0, %0"
+                 : "=m"(*(volatile uint8_t(*)[16])address)
+                 : "m"(*(const uint8_t(*)[16])value)
+                 : "xmm0", "memory");
+}
+
+static inline void
+mmio_write256(volatile void *address, const void *value)
+{
+    asm volatile("vmovdqu %1, %%ymm0\n\tvmovdqu %%ymm0, %0\n\tvzeroupper"
+                 : "=m"(*(volatile uint8_t(*)[32])address)
+                 : "m"(*(const uint8_t(*)[32])value)
+                 : "xmm0", "memory");
+}
+
+static inline void
+mmio_write_burst(volatile void *address, const void *buf, size_t size)
+{
+    size_t i = 0;
+    for (; (i + sizeof(uint64_t)) <= size; i += sizeof(uint64_t)) {
+        uint64_t value;
+        __builtin_memcpy(&value, (const uint8_t *)buf + i, sizeof(value));
+        mmio_write64((volatile uint8_t *)address + i, value);
+    }
+
+    for (; i < size; ++i) {
+        ((volatile uint8_t *)address)[i] = ((const uint8_t *)buf)[i];
+    }
+
+    /* Drain the write-combining buffers (e.g., of a region mapped
+       write-combining), so the burst reaches the device before the next
+       access. */
+    asm volatile("sfence" : : : "memory");
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MMIO_H */
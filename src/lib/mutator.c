@@ -0,0 +1,180 @@
+/** @file */
+
+#include "mutator.h"
+
+#include "prng.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+static const char *mutation_names[MUTATOR_NUM_MUTATIONS] = {
+    [MUTATOR_BITFLIP] = "bitflip",
+    [MUTATOR_ARITH] = "arith",
+    [MUTATOR_INTERESTING] = "interesting",
+    [MUTATOR_INSERT] = "insert",
+    [MUTATOR_DELETE] = "delete",
+    [MUTATOR_SPLICE] = "splice",
+};
+
+/* Boundary values (as in AFL), which are the most likely to hit off-by-one and
+   sign errors in register decoding. */
+static const int32_t interesting_values[] = {
+    -128, -1, 0, 1, 16, 32, 64, 100, 127,                                   /* 8-bit */
+    -32768, -129, 128, 255, 256, 512, 1000, 1024, 4096, 32767, 65535,       /* 16-bit */
+    INT32_MIN, -100663046, -32769, 32768, 65536, 100663045, INT32_MAX,      /* 32-bit */
+};
+
+static const size_t num_interesting_values[] = {9, 20, 27}; /* Per width */
+
+static size_t
+mutator_get_width(uint64_t random, size_t size)
+{
+    /* One, two, or four bytes, but no wider than the input */
+    size_t width = (size_t)1 << (random % 3);
+    while (width > size) {
+        width >>= 1;
+    }
+
+    return width;
+}
+
+static size_t
+mutator_arith(uint64_t random, uint8_t *restrict buf, size_t size)
+{
+    size_t width = mutator_get_width(random, size);
+    size_t offset = (random >> 8) % (size - width + 1);
+    uint32_t delta = ((random >> 2) % 35) + 1;
+    uint32_t value = 0;
+    memcpy(&value, &buf[offset], width);
+    value = (random & 0x80) ? (value - delta) : (value + delta);
+    memcpy(&buf[offset], &value, width);
+    return size;
+}
+
+static size_t
+mutator_bitflip(uint64_t random, uint8_t *restrict buf, size_t size)
+{
+    size_t bit = (random >> 8) % (size * 8);
+    size_t num_bits = (size_t)1 << (random % 3);
+    for (size_t i = 0; i < num_bits && (bit + i) < (size * 8); ++i) {
+        buf[(bit + i) / 8] ^= 1 << ((bit + i) % 8);
+    }
+
+    return size;
+}
+
+static size_t
+mutator_delete(uint64_t random, uint8_t *restrict buf, size_t size)
+{
+    /* Never delete the whole input */
+    size_t max_length = (size - 1 < MUTATOR_MAX_BLOCK) ? (size - 1) : MUTATOR_MAX_BLOCK;
+    size_t length = ((random >> 8) % max_length) + 1;
+    size_t offset = (random >> 16) % (size - length + 1);
+    memmove(&buf[offset], &buf[offset + length], size - offset - length);
+    return size - length;
+}
+
+static size_t
+mutator_insert(prng_t *restrict prng, uint64_t random, uint8_t *restrict buf, size_t size, size_t max_size)
+{
+    size_t max_length = (max_size - size < MUTATOR_MAX_BLOCK) ? (max_size - size) : MUTATOR_MAX_BLOCK;
+    size_t length = ((random >> 8) % max_length) + 1;
+    size_t offset = (random >> 16) % (size + 1);
+    memmove(&buf[offset + length], &buf[offset], size - offset);
+    if ((random & 1) && length <= size) {
+        /* Clone a block of the input */
+        size_t source = (random >> 32) % (size - length + 1);
+        memmove(&buf[offset], (source < offset) ? &buf[source] : &buf[source + length], length);
+    } else {
+        prng_fill(prng, &buf[offset], length);
+    }
+
+    return size + length;
+}
+
+static size_t
+mutator_interesting(uint64_t random, uint8_t *restrict buf, size_t size)
+{
+    size_t width = mutator_get_width(random, size);
+    size_t index = (width == 1) ? 0 : ((width == 2) ? 1 : 2);
+    size_t offset = (random >> 8) % (size - width + 1);
+    uint32_t value = (uint32_t)interesting_values[(random >> 32) % num_interesting_values[index]];
+    memcpy(&buf[offset], &value, width);
+    return size;
+}
+
+static size_t
+mutator_splice(uint64_t random, uint8_t *restrict buf, size_t size, size_t max_size, const uint8_t *restrict other,
+        size_t other_size)
+{
+    /* Keep the head of the input and append the tail of the other input from
+       the same offset, so the operations stay aligned to the same
+       boundaries. */
+    size_t offset = (random >> 8) % (((size < other_size) ? size : other_size) + 1);
+    size_t length = other_size - offset;
+    if (length > (max_size - offset)) {
+        length = max_size - offset;
+    }
+
+    memcpy(&buf[offset], &other[offset], length);
+    return offset + length;
+}
+
+size_t
+mutator_apply(prng_t *restrict prng, int mutation, uint8_t *restrict buf, size_t size, size_t max_size,
+        const uint8_t *restrict other, size_t other_size)
+{
+    uint64_t random = prng_next(prng);
+    switch (mutation) {
+    case MUTATOR_BITFLIP:
+        return (size > 0) ? mutator_bitflip(random, buf, size) : size;
+
+    case MUTATOR_ARITH:
+        return (size > 0) ? mutator_arith(random, buf, size) : size;
+
+    case MUTATOR_INTERESTING:
+        return (size > 0) ? mutator_interesting(random, buf, size) : size;
+
+    case MUTATOR_INSERT:
+        return (size < max_size) ? mutator_insert(prng, random, buf, size, max_size) : size;
+
+    case MUTATOR_DELETE:
+        return (size > 1) ? mutator_delete(random, buf, size) : size;
+
+    case MUTATOR_SPLICE:
+        return (other != NULL && other_size > 0) ? mutator_splice(random, buf, size, max_size, other, other_size)
+                                                 : size;
+
+    default:
+        return size;
+    }
+}
+
+const char *
+mutator_get_name(int mutation)
+{
+    if (mutation < 0 || mutation >= MUTATOR_NUM_MUTATIONS) {
+        return NULL;
+    }
+
+    return mutation_names[mutation];
+}
+
+size_t
+mutator_mutate(prng_t *restrict prng, uint8_t *restrict buf, size_t size, size_t max_size,
+        const uint8_t *restrict other, size_t other_size)
+{
+    /* Splices are the last mutation, so they are not chosen without another
+       input. A single random number chooses the whole stack (i.e., 3 bits
+       for its height and 7 bits for each mutation). */
+    uint64_t random = prng_next(prng);
+    size_t num_mutations = (other != NULL) ? MUTATOR_NUM_MUTATIONS : MUTATOR_SPLICE;
+    size_t num_stacked = (random % MUTATOR_MAX_STACK) + 1;
+    for (size_t i = 0; i < num_stacked; ++i) {
+        int mutation = ((random >> (3 + (7 * i))) & 0x7f) % num_mutations;
+        size = mutator_apply(prng, mutation, buf, size, max_size, other, other_size);
+    }
+
+    return size;
+}
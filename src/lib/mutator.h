@@ -0,0 +1,77 @@
+/** @file */
+
+#ifndef MUTATOR_H
+#define MUTATOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "prng.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MUTATOR_MAX_BLOCK 32 /**< Maximum size of an inserted or deleted block. */
+#define MUTATOR_MAX_STACK 8  /**< Maximum number of mutations stacked by mutator_mutate(). */
+
+/**
+ * Mutations.
+ */
+enum mutator_mutation {
+    MUTATOR_BITFLIP,       /**< Flips one, two, or four consecutive bits. */
+    MUTATOR_ARITH,         /**< Adds or subtracts a small value to or from a byte, word, or dword. */
+    MUTATOR_INTERESTING,   /**< Replaces a byte, word, or dword with an interesting value. */
+    MUTATOR_INSERT,        /**< Inserts a block of random or cloned bytes. */
+    MUTATOR_DELETE,        /**< Deletes a block of bytes. */
+    MUTATOR_SPLICE,        /**< Replaces the tail of the input with the tail of another input. */
+    MUTATOR_NUM_MUTATIONS, /**< Number of mutations. */
+};
+
+/**
+ * Performs a mutation on the input in place.
+ *
+ * No memory is allocated. A mutation that cannot be performed (e.g., an
+ * insertion into an input of the maximum size, or a splice without another
+ * input) leaves the input unchanged.
+ *
+ * @param [in] prng Pseudorandom number generator.
+ * @param [in] mutation Mutation (see mutator_mutation).
+ * @param [in,out] buf Input buffer.
+ * @param [in] size Input size.
+ * @param [in] max_size Input buffer size.
+ * @param [in] other Other input buffer (for splices), or NULL.
+ * @param [in] other_size Other input size.
+ * @return New input size.
+ */
+size_t mutator_apply(prng_t *restrict prng, int mutation, uint8_t *restrict buf, size_t size, size_t max_size,
+        const uint8_t *restrict other, size_t other_size);
+
+/**
+ * Returns the name of the mutation.
+ *
+ * @param [in] mutation Mutation (see mutator_mutation).
+ * @return Name, or NULL if the mutation is invalid.
+ */
+const char *mutator_get_name(int mutation);
+
+/**
+ * Performs a stack of one to MUTATOR_MAX_STACK random mutations on the input in
+ * place (see mutator_apply()).
+ *
+ * @param [in] prng Pseudorandom number generator.
+ * @param [in,out] buf Input buffer.
+ * @param [in] size Input size.
+ * @param [in] max_size Input buffer size.
+ * @param [in] other Other input buffer (for splices), or NULL.
+ * @param [in] other_size Other input size.
+ * @return New input size.
+ */
+size_t mutator_mutate(prng_t *restrict prng, uint8_t *restrict buf, size_t size, size_t max_size,
+        const uint8_t *restrict other, size_t other_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUTATOR_H */
@@ -0,0 +1,266 @@
+/** @file */
+
+#include "pci_bus.h"
+
+#include "pci.h"
+#include "pci_device.h"
+#include "pci_ecam.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define SYSFS_PATH "/sys/bus/pci/devices"
+
+struct _pci_bus {
+    int config_access;
+    pci_bus_device_t *devices;
+    size_t num_devices;
+    size_t capacity;
+    bool visited[256];
+};
+
+void pci_device_error(pci_device_t *restrict pci_device, int status, int error, const char *restrict format, ...);
+
+static int
+pci_bus_device_compare(const void *a, const void *b)
+{
+    const pci_bus_device_t *device_a = (const pci_bus_device_t *)a;
+    const pci_bus_device_t *device_b = (const pci_bus_device_t *)b;
+    int address_a = (device_a->bus << 8) | (device_a->device << 3) | device_a->function;
+    int address_b = (device_b->bus << 8) | (device_b->device << 3) | device_b->function;
+    return (address_a > address_b) - (address_a < address_b);
+}
+
+static pci_bus_device_t *
+pci_bus_add_device(pci_bus_t *restrict pci_bus, int bus, int device, int function)
+{
+    if (pci_bus->num_devices == pci_bus->capacity) {
+        size_t capacity = (pci_bus->capacity > 0) ? (pci_bus->capacity * 2) : 32;
+        pci_bus_device_t *devices = (pci_bus_device_t *)realloc(pci_bus->devices, capacity * sizeof(*devices));
+        if (devices == NULL) {
+            return NULL;
+        }
+
+        pci_bus->devices = devices;
+        pci_bus->capacity = capacity;
+    }
+
+    pci_bus_device_t *bus_device = &pci_bus->devices[pci_bus->num_devices++];
+    memset(bus_device, 0, sizeof(*bus_device));
+    bus_device->bus = bus;
+    bus_device->device = device;
+    bus_device->function = function;
+    return bus_device;
+}
+
+static void
+pci_bus_device_decode(pci_bus_device_t *restrict bus_device)
+{
+    bus_device->vendor_id = bus_device->config[0] | (bus_device->config[1] << 8);
+    bus_device->device_id = bus_device->config[2] | (bus_device->config[3] << 8);
+    bus_device->class_code
+            = (bus_device->config[11] << 16) | (bus_device->config[10] << 8) | bus_device->config[9];
+    bus_device->header_type = bus_device->config[14];
+}
+
+static uint32_t
+pci_bus_config_read32(const void *map, int bus, int device, int function, uint16_t offset)
+{
+    if (map != MAP_FAILED) {
+        return pci_ecam_config_read32(map, pci_ecam_get_offset(device, function) + offset);
+    }
+
+    return pci_config_read32(bus, device, function, offset);
+}
+
+static int
+pci_bus_scan(pci_bus_t *restrict pci_bus, int bus)
+{
+    /* Map the ECAM window of the whole bus, so each configuration space
+       access is a single memory access. */
+    void *map = MAP_FAILED;
+    if (pci_bus->config_access == PCI_DEVICE_CONFIG_ECAM) {
+        map = pci_ecam_map(bus, 0, PCI_ECAM_BUS_SIZE);
+        if (map == MAP_FAILED) {
+            return -1;
+        }
+    }
+
+    pci_bus->visited[bus] = true;
+    for (int device = 0; device < 32; ++device) {
+        for (int function = 0; function < 8; ++function) {
+            /* The vendor ID of a function that is not implemented reads as
+               0xffff. */
+            uint32_t id = pci_bus_config_read32(map, bus, device, function, 0);
+            if ((id & 0xffff) == 0xffff) {
+                if (function == 0) {
+                    break;
+                }
+
+                continue;
+            }
+
+            pci_bus_device_t *bus_device = pci_bus_add_device(pci_bus, bus, device, function);
+            if (bus_device == NULL) {
+                goto err;
+            }
+
+            memcpy(&bus_device->config[0], &id, sizeof(id));
+            for (size_t offset = 4; offset < PCI_BUS_CONFIG_SIZE; offset += 4) {
+                uint32_t value = pci_bus_config_read32(map, bus, device, function, offset);
+                memcpy(&bus_device->config[offset], &value, sizeof(value));
+            }
+
+            pci_bus_device_decode(bus_device);
+            uint8_t header_type = bus_device->header_type;
+            uint8_t secondary_bus = bus_device->config[25];
+            /* PCI-to-PCI bridge? */
+            if ((header_type & 0x7f) == 1 && secondary_bus != 0 && !pci_bus->visited[secondary_bus]) {
+                /* Scan the secondary bus (the devices may be reallocated) */
+                if (pci_bus_scan(pci_bus, secondary_bus) == -1) {
+                    goto err;
+                }
+            }
+
+            /* Bit 7 of the Header Type field identifies a multi-function
+               device. */
+            if (function == 0 && (header_type & 0x80) == 0) {
+                break;
+            }
+        }
+    }
+
+    if (map != MAP_FAILED) {
+        pci_ecam_unmap(map, PCI_ECAM_BUS_SIZE);
+    }
+
+    return 0;
+
+err:
+    if (map != MAP_FAILED) {
+        int error = errno;
+        pci_ecam_unmap(map, PCI_ECAM_BUS_SIZE);
+        errno = error;
+    }
+
+    return -1;
+}
+
+static int
+pci_bus_scan_sysfs(pci_bus_t *restrict pci_bus)
+{
+    /* The kernel has already enumerated the PCI devices, so only the PCI
+       devices that exist are read. */
+    DIR *dir = opendir(SYSFS_PATH);
+    if (dir == NULL) {
+        return -1;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned int domain, bus, device, function;
+        int length = 0;
+        if (sscanf(entry->d_name, "%x:%x:%x.%x%n", &domain, &bus, &device, &function, &length) != 4
+                || entry->d_name[length] != '\0' || domain != 0) {
+            continue;
+        }
+
+        char path[sizeof(SYSFS_PATH) + 256 + sizeof("/config")];
+        snprintf(path, sizeof(path), "%s/%s/config", SYSFS_PATH, entry->d_name);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            continue;
+        }
+
+        pci_bus_device_t *bus_device = pci_bus_add_device(pci_bus, bus, device, function);
+        if (bus_device == NULL) {
+            close(fd);
+            closedir(dir);
+            return -1;
+        }
+
+        /* Only the first 64 bytes are readable without privileges (the rest
+           reads as zeros). */
+        if (pread(fd, bus_device->config, sizeof(bus_device->config), 0) < 64) {
+            --pci_bus->num_devices;
+        } else {
+            pci_bus_device_decode(bus_device);
+        }
+
+        close(fd);
+    }
+
+    closedir(dir);
+    return 0;
+}
+
+pci_bus_t *
+pci_bus_create(int config_access)
+{
+    pci_bus_t *pci_bus = (pci_bus_t *)calloc(1, sizeof(*pci_bus));
+    if (pci_bus == NULL) {
+        pci_device_error(NULL, 0, errno, __func__);
+        return NULL;
+    }
+
+    pci_bus->config_access = config_access;
+    if (((config_access == PCI_DEVICE_CONFIG_SYSFS) ? pci_bus_scan_sysfs(pci_bus) : pci_bus_scan(pci_bus, 0))
+            == -1) {
+        pci_device_error(NULL, 0, errno, __func__);
+        goto err;
+    }
+
+    qsort(pci_bus->devices, pci_bus->num_devices, sizeof(*pci_bus->devices), pci_bus_device_compare);
+    return pci_bus;
+
+err:
+    pci_bus_destroy(pci_bus);
+    return NULL;
+}
+
+void
+pci_bus_destroy(pci_bus_t *restrict pci_bus)
+{
+    if (pci_bus == NULL) {
+        return;
+    }
+
+    free(pci_bus->devices);
+    free(pci_bus);
+}
+
+const pci_bus_device_t *
+pci_bus_find_device(pci_bus_t *restrict pci_bus, int bus, int device, int function)
+{
+    pci_bus_device_t key = {.bus = bus, .device = device, .function = function};
+    return (const pci_bus_device_t *)bsearch(
+            &key, pci_bus->devices, pci_bus->num_devices, sizeof(*pci_bus->devices), pci_bus_device_compare);
+}
+
+const pci_bus_device_t *
+pci_bus_get_device(pci_bus_t *restrict pci_bus, size_t index)
+{
+    if (index >= pci_bus->num_devices) {
+        errno = EINVAL;
+        pci_device_error(NULL, 0, errno, __func__);
+        return NULL;
+    }
+
+    return &pci_bus->devices[index];
+}
+
+size_t
+pci_bus_get_num_devices(pci_bus_t *restrict pci_bus)
+{
+    return pci_bus->num_devices;
+}
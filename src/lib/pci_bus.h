@@ -0,0 +1,90 @@
+/** @file */
+
+#ifndef PCI_BUS_H
+#define PCI_BUS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PCI_BUS_CONFIG_SIZE 256
+
+typedef struct _pci_bus pci_bus_t; /**< PCI bus (i.e., the enumerated PCI devices). */
+
+/**
+ * Enumerated PCI device (i.e., a PCI device address and a snapshot of its
+ * configuration space at enumeration time).
+ */
+typedef struct pci_bus_device {
+    int bus;                              /**< PCI bus number. */
+    int device;                           /**< PCI device number. */
+    int function;                         /**< PCI function number. */
+    uint16_t vendor_id;                   /**< Vendor ID. */
+    uint16_t device_id;                   /**< Device ID. */
+    uint32_t class_code;                  /**< Class code. */
+    uint8_t header_type;                  /**< Header type. */
+    uint8_t config[PCI_BUS_CONFIG_SIZE]; /**< Configuration space snapshot. */
+} pci_bus_device_t;
+
+/**
+ * Enumerates the PCI devices.
+ *
+ * The PCI buses are scanned depth first, from bus 0 through the PCI-to-PCI
+ * bridges, and the configuration space of each PCI device found is read once
+ * into a snapshot, so the PCI devices can be listed, looked up, and created
+ * (see pci_device_create_config()) without reading their configuration space
+ * again. (PCI buses that are not reachable from bus 0 are not scanned.) With
+ * the sysfs mechanism, the PCI devices already enumerated by the kernel are
+ * read instead, and no PCI bus is scanned.
+ *
+ * @param [in] config_access PCI configuration space access mechanism (see
+ *   pci_device_config_access).
+ * @return A PCI bus.
+ */
+pci_bus_t *pci_bus_create(int config_access);
+
+/**
+ * Destroys the PCI bus.
+ *
+ * @param [in] pci_bus PCI bus.
+ */
+void pci_bus_destroy(pci_bus_t *restrict pci_bus);
+
+/**
+ * Returns the enumerated PCI device at the given address.
+ *
+ * @param [in] pci_bus PCI bus.
+ * @param [in] bus PCI bus number.
+ * @param [in] device PCI device number.
+ * @param [in] function PCI function number.
+ * @return Enumerated PCI device, or NULL if there is no PCI device at the given
+ *   address.
+ */
+const pci_bus_device_t *pci_bus_find_device(pci_bus_t *restrict pci_bus, int bus, int device, int function);
+
+/**
+ * Returns an enumerated PCI device, in address order.
+ *
+ * @param [in] pci_bus PCI bus.
+ * @param [in] index PCI device index (in the range given by the interval
+ *   [0,pci_bus_get_num_devices())).
+ * @return Enumerated PCI device.
+ */
+const pci_bus_device_t *pci_bus_get_device(pci_bus_t *restrict pci_bus, size_t index);
+
+/**
+ * Returns the number of enumerated PCI devices.
+ *
+ * @param [in] pci_bus PCI bus.
+ * @return Number of PCI devices.
+ */
+size_t pci_bus_get_num_devices(pci_bus_t *restrict pci_bus);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PCI_BUS_H */
@@ -3,21 +3,29 @@
 #include "pci_device.h"
 
 #include "io.h"
+#include "mmio.h"
 #include "pci.h"
+#include "pci_ecam.h"
 
 #include <errno.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
 #define MAX_REGIONS 6
+#define SYSFS_PATH "/sys/bus/pci/devices/0000:%02x:%02x.%x"
 
 struct _pci_device {
+    const pci_device_backend_t *backend;
+    void *context;
     int bus;
     int device;
     int function;
@@ -30,61 +38,357 @@ struct _pci_device {
         uint64_t base_address;
         uint64_t size;
         void *map;
+        uint64_t window_offset;
+        uint64_t window_size;
         bool is_io;
         bool is_64;
+        pci_device_region_ops_t ops;
     } regions[MAX_REGIONS];
 };
 
+/**
+ * Hardware backend context.
+ */
+struct hardware {
+    int bus;
+    int device;
+    int function;
+    int config_access;
+    void *config_map;
+    int config_fd;
+    int region_access;
+    int region_fds[MAX_REGIONS];
+    int dir_fd;
+    int mem_fd;
+};
+
+static int config_access = PCI_DEVICE_CONFIG_IO;
 static pci_device_error_handler_t *error_handler = NULL;
+static int region_access = PCI_DEVICE_REGION_DEVMEM;
+static uint64_t region_window = 0;
+
+static const char *config_access_names[PCI_DEVICE_NUM_CONFIG_ACCESSES] = {
+    [PCI_DEVICE_CONFIG_IO] = "io",
+    [PCI_DEVICE_CONFIG_ECAM] = "ecam",
+    [PCI_DEVICE_CONFIG_SYSFS] = "sysfs",
+};
+
+static const char *region_access_names[PCI_DEVICE_NUM_REGION_ACCESSES] = {
+    [PCI_DEVICE_REGION_DEVMEM] = "devmem",
+    [PCI_DEVICE_REGION_SYSFS] = "sysfs",
+    [PCI_DEVICE_REGION_SYSFS_WC] = "sysfs-wc",
+};
 
 void pci_device_error(pci_device_t *restrict pci_device, int status, int error, const char *restrict format, ...);
-int pci_device_regions_map(pci_device_t *restrict pci_device);
+static pci_device_t *pci_device_create_snapshot(
+        const pci_device_backend_t *backend, void *context, int bus, int device, int function, const uint8_t *config);
+size_t pci_device_region_get_burst_size(
+        pci_device_t *restrict pci_device, size_t region_num, size_t offset, size_t size);
+volatile void *pci_device_region_get_map(
+        pci_device_t *restrict pci_device, size_t region_num, size_t offset, size_t size);
+int pci_device_region_move_window(pci_device_t *restrict pci_device, size_t region_num, size_t offset);
+void pci_device_region_resolve(pci_device_t *restrict pci_device, size_t region_num);
+int pci_device_regions_map(pci_device_t *restrict pci_device, const uint8_t *config);
 int pci_device_regions_unmap(pci_device_t *restrict pci_device);
 
+#define _pci_device_hardware_config_define(size, type) \
+    static type pci_device_hardware_config_read##size(void *context, uint16_t offset) \
+    { \
+        struct hardware *hardware = (struct hardware *)context; \
+        type value = (type)-1; \
+        switch (hardware->config_access) { \
+        case PCI_DEVICE_CONFIG_ECAM: \
+            if (offset <= (PCI_ECAM_FUNCTION_SIZE - sizeof(type))) { \
+                value = pci_ecam_config_read##size(hardware->config_map, offset); \
+            } \
+\
+            break; \
+\
+        case PCI_DEVICE_CONFIG_SYSFS: \
+            if (pread(hardware->config_fd, &value, sizeof(value), offset) != sizeof(value)) { \
+                value = (type)-1; \
+            } \
+\
+            break; \
+\
+        default: \
+            if (offset <= (256 - sizeof(type))) { \
+                value = pci_config_read##size(hardware->bus, hardware->device, hardware->function, offset); \
+            } \
+\
+            break; \
+        } \
+\
+        return value; \
+    } \
+\
+    static void pci_device_hardware_config_write##size(void *context, uint16_t offset, type value) \
+    { \
+        struct hardware *hardware = (struct hardware *)context; \
+        switch (hardware->config_access) { \
+        case PCI_DEVICE_CONFIG_ECAM: \
+            if (offset <= (PCI_ECAM_FUNCTION_SIZE - sizeof(type))) { \
+                pci_ecam_config_write##size(hardware->config_map, offset, value); \
+            } \
+\
+            break; \
+\
+        case PCI_DEVICE_CONFIG_SYSFS: \
+            if (pwrite(hardware->config_fd, &value, sizeof(value), offset) != sizeof(value)) { \
+                /* Failed writes are ignored, as with the other mechanisms */ \
+            } \
+\
+            break; \
+\
+        default: \
+            if (offset <= (256 - sizeof(type))) { \
+                pci_config_write##size(hardware->bus, hardware->device, hardware->function, offset, value); \
+            } \
+\
+            break; \
+        } \
+    }
+
+_pci_device_hardware_config_define(16, uint16_t)
+_pci_device_hardware_config_define(32, uint32_t)
+_pci_device_hardware_config_define(8, uint8_t)
+#undef _pci_device_hardware_config_define
+
+static uint32_t
+pci_device_config_read_snapshot32(pci_device_t *restrict pci_device, const uint8_t *config, uint16_t offset)
+{
+    if (config == NULL) {
+        return pci_device_config_read32(pci_device, offset);
+    }
+
+    uint32_t value;
+    memcpy(&value, &config[offset], sizeof(value));
+    return value;
+}
+
+static void
+pci_device_hardware_destroy(void *context)
+{
+    struct hardware *hardware = (struct hardware *)context;
+    if (hardware->config_map != MAP_FAILED) {
+        pci_ecam_unmap(hardware->config_map, PCI_ECAM_FUNCTION_SIZE);
+    }
+
+    if (hardware->config_fd != -1) {
+        close(hardware->config_fd);
+    }
+
+    for (size_t i = 0; i < MAX_REGIONS; ++i) {
+        if (hardware->region_fds[i] != -1) {
+            close(hardware->region_fds[i]);
+        }
+    }
+
+    if (hardware->dir_fd != -1) {
+        close(hardware->dir_fd);
+    }
+
+    if (hardware->mem_fd != -1) {
+        close(hardware->mem_fd);
+    }
+
+    free(hardware);
+}
+
+static int
+pci_device_hardware_open(struct hardware *hardware, const char *name, int flags)
+{
+    /* The sysfs directory of the PCI device is opened once, and its files are
+       opened relative to it. */
+    if (hardware->dir_fd == -1) {
+        char path[sizeof(SYSFS_PATH) + 16];
+        snprintf(path, sizeof(path), SYSFS_PATH, hardware->bus, hardware->device, hardware->function);
+        hardware->dir_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (hardware->dir_fd == -1) {
+            return -1;
+        }
+    }
+
+    return openat(hardware->dir_fd, name, flags | O_CLOEXEC);
+}
+
+static void *
+pci_device_hardware_region_map(void *context, size_t region_num, uint64_t base_address, uint64_t offset, uint64_t size)
+{
+    struct hardware *hardware = (struct hardware *)context;
+    if (hardware->region_access == PCI_DEVICE_REGION_DEVMEM) {
+        /* /dev/mem is opened once, and mapped at the physical address */
+        if (hardware->mem_fd == -1) {
+            hardware->mem_fd = open("/dev/mem", O_RDWR | O_CLOEXEC);
+            if (hardware->mem_fd == -1) {
+                return MAP_FAILED;
+            }
+        }
+
+        return mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, hardware->mem_fd, base_address + offset);
+    }
+
+    /* The resource file of each region is opened once (and kept open for
+       moving the window), and mapped at the region offset. */
+    if (hardware->region_fds[region_num] == -1) {
+        char name[32];
+        if (hardware->region_access == PCI_DEVICE_REGION_SYSFS_WC) {
+            /* Only prefetchable regions have a write-combining resource file */
+            snprintf(name, sizeof(name), "resource%zu_wc", region_num);
+            hardware->region_fds[region_num] = pci_device_hardware_open(hardware, name, O_RDWR);
+        }
+
+        if (hardware->region_fds[region_num] == -1) {
+            snprintf(name, sizeof(name), "resource%zu", region_num);
+            hardware->region_fds[region_num] = pci_device_hardware_open(hardware, name, O_RDWR);
+            if (hardware->region_fds[region_num] == -1) {
+                return MAP_FAILED;
+            }
+        }
+    }
+
+    return mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, hardware->region_fds[region_num], offset);
+}
+
+static int
+pci_device_hardware_region_unmap(void *context, size_t region_num, void *map, uint64_t size)
+{
+    return munmap(map, size);
+}
+
+/**
+ * Hardware backend (i.e., configuration mechanism #1, the ECAM window, or the
+ * sysfs config file, port I/O instructions, and /dev/mem or the sysfs resource
+ * files).
+ */
+static const pci_device_backend_t hardware_backend = {
+        .name = "hardware",
+        .destroy = pci_device_hardware_destroy,
+        .config_read16 = pci_device_hardware_config_read16,
+        .config_read32 = pci_device_hardware_config_read32,
+        .config_read8 = pci_device_hardware_config_read8,
+        .config_write16 = pci_device_hardware_config_write16,
+        .config_write32 = pci_device_hardware_config_write32,
+        .config_write8 = pci_device_hardware_config_write8,
+        .region_map = pci_device_hardware_region_map,
+        .region_unmap = pci_device_hardware_region_unmap,
+};
+
 pci_device_t *
 pci_device_create(int bus, int device, int function)
 {
-    pci_device_t *pci_device = (pci_device_t *)calloc(1, sizeof(*pci_device));
-    if (pci_device == NULL) {
-        pci_device_error(pci_device, 0, errno, __func__);
-        return NULL;
-    }
+    return pci_device_create_config(bus, device, function, NULL);
+}
 
+pci_device_t *
+pci_device_create_backend(const pci_device_backend_t *backend, void *context, int bus, int device, int function)
+{
+    return pci_device_create_snapshot(backend, context, bus, device, function, NULL);
+}
+
+pci_device_t *
+pci_device_create_config(int bus, int device, int function, const void *config)
+{
     if (bus < 0 || bus > 255) {
         errno = EINVAL;
-        pci_device_error(pci_device, 0, errno, __func__);
-        goto err;
+        pci_device_error(NULL, 0, errno, __func__);
+        return NULL;
     }
 
     if (device < 0 || device > 31) {
         errno = EINVAL;
-        pci_device_error(pci_device, 0, errno, __func__);
-        goto err;
+        pci_device_error(NULL, 0, errno, __func__);
+        return NULL;
     }
 
     if (function < 0 || function > 7) {
         errno = EINVAL;
+        pci_device_error(NULL, 0, errno, __func__);
+        return NULL;
+    }
+
+    struct hardware *hardware = (struct hardware *)calloc(1, sizeof(*hardware));
+    if (hardware == NULL) {
+        pci_device_error(NULL, 0, errno, __func__);
+        return NULL;
+    }
+
+    hardware->bus = bus;
+    hardware->device = device;
+    hardware->function = function;
+    hardware->config_access = config_access;
+    hardware->config_map = MAP_FAILED;
+    hardware->config_fd = -1;
+    hardware->region_access = region_access;
+    for (size_t i = 0; i < MAX_REGIONS; ++i) {
+        hardware->region_fds[i] = -1;
+    }
+
+    hardware->dir_fd = -1;
+    hardware->mem_fd = -1;
+    switch (hardware->config_access) {
+    case PCI_DEVICE_CONFIG_ECAM:
+        hardware->config_map = pci_ecam_map(bus, pci_ecam_get_offset(device, function), PCI_ECAM_FUNCTION_SIZE);
+        if (hardware->config_map == MAP_FAILED) {
+            pci_device_error(NULL, 0, errno, __func__);
+            pci_device_hardware_destroy(hardware);
+            return NULL;
+        }
+
+        break;
+
+    case PCI_DEVICE_CONFIG_SYSFS:
+        hardware->config_fd = pci_device_hardware_open(hardware, "config", O_RDWR);
+        if (hardware->config_fd == -1) {
+            pci_device_error(NULL, 0, errno, __func__);
+            pci_device_hardware_destroy(hardware);
+            return NULL;
+        }
+
+        break;
+    }
+
+    return pci_device_create_snapshot(&hardware_backend, hardware, bus, device, function, (const uint8_t *)config);
+}
+
+static pci_device_t *
+pci_device_create_snapshot(
+        const pci_device_backend_t *backend, void *context, int bus, int device, int function, const uint8_t *config)
+{
+    pci_device_t *pci_device = (pci_device_t *)calloc(1, sizeof(*pci_device));
+    if (pci_device == NULL) {
         pci_device_error(pci_device, 0, errno, __func__);
-        goto err;
+        backend->destroy(context);
+        return NULL;
     }
 
+    pci_device->backend = backend;
+    pci_device->context = context;
     pci_device->bus = bus;
     pci_device->device = device;
     pci_device->function = function;
-    pci_device->vendor_id = pci_config_read16(pci_device->bus, pci_device->device, pci_device->function, 0);
+    for (size_t i = 0; i < MAX_REGIONS; ++i) {
+        pci_device->regions[i].map = MAP_FAILED;
+        pci_device_region_resolve(pci_device, i);
+    }
+
+    /* The identification fields are read a dword at a time (or taken from the
+       snapshot) to keep the number of configuration space accesses down. */
+    uint32_t id = pci_device_config_read_snapshot32(pci_device, config, 0);
+    pci_device->vendor_id = id & 0xffff;
     if (pci_device->vendor_id == 0xffff) {
         pci_device_error(pci_device, 0, 0, "%s: Invalid device.\n", __func__);
         goto err;
     }
 
-    pci_device->device_id = pci_config_read16(pci_device->bus, pci_device->device, pci_device->function, 2);
-    pci_device->class_code = pci_config_read32(pci_device->bus, pci_device->device, pci_device->function, 8) >> 8;
+    pci_device->device_id = id >> 16;
+    pci_device->class_code = pci_device_config_read_snapshot32(pci_device, config, 8) >> 8;
     /* The first part of the predefined header (i.e., the first 16 bytes) are
        defined the same for all types of devices. The the second part of the
        predefined header may have different layouts depending on the base
        function that the device supports. The Header Type field (at offset 14)
        specifies what layout is provided. */
-    pci_device->header_type = pci_config_read8(pci_device->bus, pci_device->device, pci_device->function, 14);
+    pci_device->header_type = (pci_device_config_read_snapshot32(pci_device, config, 12) >> 16) & 0xff;
     /* Bits 0 to 6 identify the layout of the second part of the predefined
        header. */
     switch (pci_device->header_type & 0x7f) {
@@ -107,7 +411,7 @@ pci_device_create(int bus, int device, int function)
         goto err;
     }
 
-    if (pci_device_regions_map(pci_device) == -1) {
+    if (pci_device_regions_map(pci_device, config) == -1) {
         pci_device_error(pci_device, 0, errno, __func__);
         goto err;
     }
@@ -119,6 +423,22 @@ err:
     return NULL;
 }
 
+#define _pci_device_config_define(size, type) \
+    type pci_device_config_read##size(pci_device_t *restrict pci_device, uint16_t offset) \
+    { \
+        return pci_device->backend->config_read##size(pci_device->context, offset); \
+    } \
+\
+    void pci_device_config_write##size(pci_device_t *restrict pci_device, uint16_t offset, type value) \
+    { \
+        pci_device->backend->config_write##size(pci_device->context, offset, value); \
+    }
+
+_pci_device_config_define(16, uint16_t)
+_pci_device_config_define(32, uint32_t)
+_pci_device_config_define(8, uint8_t)
+#undef _pci_device_config_define
+
 void
 pci_device_destroy(pci_device_t *restrict pci_device)
 {
@@ -127,6 +447,7 @@ pci_device_destroy(pci_device_t *restrict pci_device)
     }
 
     pci_device_regions_unmap(pci_device);
+    pci_device->backend->destroy(pci_device->context);
     free(pci_device);
 }
 
@@ -143,12 +464,36 @@ pci_device_error(pci_device_t *restrict pci_device, int status, int error, const
     va_end(ap);
 }
 
+int
+pci_device_get_config_access(const char *restrict name)
+{
+    for (int i = 0; i < PCI_DEVICE_NUM_CONFIG_ACCESSES; ++i) {
+        if (strcmp(name, config_access_names[i]) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
 size_t
 pci_device_get_num_regions(pci_device_t *restrict pci_device)
 {
     return pci_device->num_regions;
 }
 
+int
+pci_device_get_region_access(const char *restrict name)
+{
+    for (int i = 0; i < PCI_DEVICE_NUM_REGION_ACCESSES; ++i) {
+        if (strcmp(name, region_access_names[i]) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
 bool
 pci_device_is_ata_controller(pci_device_t *restrict pci_device)
 {
@@ -170,6 +515,63 @@ pci_device_region_get_base_address(pci_device_t *restrict pci_device, size_t reg
     return pci_device->regions[region_num].base_address;
 }
 
+size_t
+pci_device_region_get_burst_size(pci_device_t *restrict pci_device, size_t region_num, size_t offset, size_t size)
+{
+    /* A burst is at most PCI_DEVICE_MAX_BURST bytes (so it fits in any window,
+       which is at least two pages), and ends at the end of the region. */
+    if (size > PCI_DEVICE_MAX_BURST) {
+        size = PCI_DEVICE_MAX_BURST;
+    }
+
+    if (region_num < pci_device->num_regions && offset < pci_device->regions[region_num].size
+            && size > (pci_device->regions[region_num].size - offset)) {
+        size = pci_device->regions[region_num].size - offset;
+    }
+
+    return size;
+}
+
+volatile void *
+pci_device_region_get_map(pci_device_t *restrict pci_device, size_t region_num, size_t offset, size_t size)
+{
+    /* Returns the address of a memory region access of the given size (moving
+       the window, if needed), or NULL if the region is not mapped memory or
+       the access does not end within the region. */
+    if (region_num >= pci_device->num_regions || offset >= pci_device->regions[region_num].size
+            || size > (pci_device->regions[region_num].size - offset)) {
+        errno = EINVAL;
+        pci_device_error(pci_device, 0, errno, __func__);
+        return NULL;
+    }
+
+    struct region *region = &pci_device->regions[region_num];
+    if (region->is_io || (region->map == MAP_FAILED)) {
+        errno = EINVAL;
+        pci_device_error(pci_device, 0, errno, __func__);
+        return NULL;
+    }
+
+    if (region->window_size < region->size && (offset - region->window_offset) > (region->window_size - size)
+            && pci_device_region_move_window(pci_device, region_num, offset) == -1) {
+        return NULL;
+    }
+
+    return (volatile uint8_t *)region->map + (offset - region->window_offset);
+}
+
+const pci_device_region_ops_t *
+pci_device_region_get_ops(pci_device_t *restrict pci_device, size_t region_num)
+{
+    if (region_num >= pci_device->num_regions) {
+        errno = EINVAL;
+        pci_device_error(pci_device, 0, errno, __func__);
+        return NULL;
+    }
+
+    return &pci_device->regions[region_num].ops;
+}
+
 size_t
 pci_device_region_get_size(pci_device_t *restrict pci_device, size_t region_num)
 {
@@ -206,35 +608,172 @@ pci_device_region_is_mapped(pci_device_t *restrict pci_device, size_t region_num
     return (!pci_device->regions[region_num].is_io && (pci_device->regions[region_num].map != MAP_FAILED));
 }
 
+/* The accessors of each kind of region (see pci_device_region_resolve()).
+   Each is specialized for its width, and none validates its arguments. */
+#define _pci_device_region_ops_define(_size, type) \
+    static type pci_device_region_backend_read##_size( \
+            pci_device_t *restrict pci_device, size_t region_num, size_t offset) \
+    { \
+        return pci_device->backend->region_read##_size(pci_device->context, region_num, offset); \
+    } \
+\
+    static void pci_device_region_backend_write##_size( \
+            pci_device_t *restrict pci_device, size_t region_num, size_t offset, type value) \
+    { \
+        pci_device->backend->region_write##_size(pci_device->context, region_num, offset, value); \
+    } \
+\
+    static type pci_device_region_disabled_read##_size( \
+            pci_device_t *restrict pci_device, size_t region_num, size_t offset) \
+    { \
+        errno = EINVAL; \
+        pci_device_error(pci_device, 0, errno, "pci_device_region_read" #_size); \
+        return (type)-1; \
+    } \
+\
+    static void pci_device_region_disabled_write##_size( \
+            pci_device_t *restrict pci_device, size_t region_num, size_t offset, type value) \
+    { \
+        errno = EINVAL; \
+        pci_device_error(pci_device, 0, errno, "pci_device_region_write" #_size); \
+    } \
+\
+    static type pci_device_region_io_read##_size( \
+            pci_device_t *restrict pci_device, size_t region_num, size_t offset) \
+    { \
+        return io_read##_size(pci_device->regions[region_num].base_address + offset); \
+    } \
+\
+    static void pci_device_region_io_write##_size( \
+            pci_device_t *restrict pci_device, size_t region_num, size_t offset, type value) \
+    { \
+        io_write##_size(pci_device->regions[region_num].base_address + offset, value); \
+    } \
+\
+    static type pci_device_region_memory_read##_size( \
+            pci_device_t *restrict pci_device, size_t region_num, size_t offset) \
+    { \
+        return *(volatile type *)((uint8_t *)pci_device->regions[region_num].map + offset); \
+    } \
+\
+    static void pci_device_region_memory_write##_size( \
+            pci_device_t *restrict pci_device, size_t region_num, size_t offset, type value) \
+    { \
+        *(volatile type *)((uint8_t *)pci_device->regions[region_num].map + offset) = value; \
+    } \
+\
+    static type pci_device_region_window_read##_size( \
+            pci_device_t *restrict pci_device, size_t region_num, size_t offset) \
+    { \
+        struct region *region = &pci_device->regions[region_num]; \
+        if ((offset - region->window_offset) > (region->window_size - sizeof(type)) \
+                && pci_device_region_move_window(pci_device, region_num, offset) == -1) { \
+            return (type)-1; \
+        } \
+\
+        return *(volatile type *)((uint8_t *)region->map + (offset - region->window_offset)); \
+    } \
+\
+    static void pci_device_region_window_write##_size( \
+            pci_device_t *restrict pci_device, size_t region_num, size_t offset, type value) \
+    { \
+        struct region *region = &pci_device->regions[region_num]; \
+        if ((offset - region->window_offset) > (region->window_size - sizeof(type)) \
+                && pci_device_region_move_window(pci_device, region_num, offset) == -1) { \
+            return; \
+        } \
+\
+        *(volatile type *)((uint8_t *)region->map + (offset - region->window_offset)) = value; \
+    }
+
+_pci_device_region_ops_define(16, uint16_t)
+_pci_device_region_ops_define(32, uint32_t)
+_pci_device_region_ops_define(8, uint8_t)
+#undef _pci_device_region_ops_define
+
+#define _pci_device_region_ops(kind) \
+    ((pci_device_region_ops_t){ \
+            .read16 = pci_device_region_##kind##_read16, \
+            .read32 = pci_device_region_##kind##_read32, \
+            .read8 = pci_device_region_##kind##_read8, \
+            .write16 = pci_device_region_##kind##_write16, \
+            .write32 = pci_device_region_##kind##_write32, \
+            .write8 = pci_device_region_##kind##_write8, \
+    })
+
 #define _pci_device_region_define(_size, type) \
     type pci_device_region_read##_size(pci_device_t *restrict pci_device, size_t region_num, size_t offset) \
     { \
-        if (region_num >= pci_device->num_regions || offset >= pci_device->regions[region_num].size) { \
+        if (region_num >= pci_device->num_regions || offset >= pci_device->regions[region_num].size \
+                || sizeof(type) > (pci_device->regions[region_num].size - offset)) { \
             errno = EINVAL; \
             pci_device_error(pci_device, 0, errno, __func__); \
             return (type)-1; \
         } \
+\
+        return pci_device->regions[region_num].ops.read##_size(pci_device, region_num, offset); \
+    } \
+\
+    void pci_device_region_write##_size( \
+            pci_device_t *restrict pci_device, size_t region_num, size_t offset, type value) \
+    { \
+        if (region_num >= pci_device->num_regions || offset >= pci_device->regions[region_num].size \
+                || sizeof(type) > (pci_device->regions[region_num].size - offset)) { \
+            errno = EINVAL; \
+            pci_device_error(pci_device, 0, errno, __func__); \
+            return; \
+        } \
+\
+        pci_device->regions[region_num].ops.write##_size(pci_device, region_num, offset, value); \
+    } \
+\
+    void pci_device_region_read_string##_size( \
+            pci_device_t *restrict pci_device, size_t region_num, size_t offset, type *string, size_t count) \
+    { \
+        if (region_num >= pci_device->num_regions || offset >= pci_device->regions[region_num].size \
+                || sizeof(type) > (pci_device->regions[region_num].size - offset)) { \
+            errno = EINVAL; \
+            pci_device_error(pci_device, 0, errno, __func__); \
+            return; \
+        } \
 \
         if (!pci_device->regions[region_num].is_io && (pci_device->regions[region_num].map == MAP_FAILED)) { \
             errno = EINVAL; \
             pci_device_error(pci_device, 0, errno, __func__); \
-            return (type)-1; \
+            return; \
         } \
 \
-        type value; \
         if (pci_device->regions[region_num].is_io) { \
-            value = io_read##_size(pci_device->regions[region_num].base_address + offset); \
-            return value; \
+            if (pci_device->backend->region_read##_size != NULL) { \
+                for (size_t i = 0; i < count; ++i) { \
+                    string[i] = pci_device->backend->region_read##_size(pci_device->context, region_num, offset); \
+                } \
+\
+                return; \
+            } \
+\
+            io_read_string##_size(pci_device->regions[region_num].base_address + offset, string, count); \
+            return; \
         } \
 \
-        value = ((type *)pci_device->regions[region_num].map)[offset]; \
-        return value; \
+        struct region *region = &pci_device->regions[region_num]; \
+        if (region->window_size < region->size \
+                && (offset - region->window_offset) > (region->window_size - sizeof(type)) \
+                && pci_device_region_move_window(pci_device, region_num, offset) == -1) { \
+            return; \
+        } \
+\
+        volatile type *address = (volatile type *)((uint8_t *)region->map + (offset - region->window_offset)); \
+        for (size_t i = 0; i < count; ++i) { \
+            string[i] = *address; \
+        } \
     } \
 \
-    void pci_device_region_write##_size( \
-            pci_device_t *restrict pci_device, size_t region_num, size_t offset, type value) \
+    void pci_device_region_write_string##_size( \
+            pci_device_t *restrict pci_device, size_t region_num, size_t offset, const type *string, size_t count) \
     { \
-        if (region_num >= pci_device->num_regions || offset >= pci_device->regions[region_num].size) { \
+        if (region_num >= pci_device->num_regions || offset >= pci_device->regions[region_num].size \
+                || sizeof(type) > (pci_device->regions[region_num].size - offset)) { \
             errno = EINVAL; \
             pci_device_error(pci_device, 0, errno, __func__); \
             return; \
@@ -247,11 +786,29 @@ pci_device_region_is_mapped(pci_device_t *restrict pci_device, size_t region_num
         } \
 \
         if (pci_device->regions[region_num].is_io) { \
-            io_write##_size(pci_device->regions[region_num].base_address + offset, value); \
+            if (pci_device->backend->region_write##_size != NULL) { \
+                for (size_t i = 0; i < count; ++i) { \
+                    pci_device->backend->region_write##_size(pci_device->context, region_num, offset, string[i]); \
+                } \
+\
+                return; \
+            } \
+\
+            io_write_string##_size(pci_device->regions[region_num].base_address + offset, string, count); \
             return; \
         } \
 \
-        ((type *)pci_device->regions[region_num].map)[offset] = value; \
+        struct region *region = &pci_device->regions[region_num]; \
+        if (region->window_size < region->size \
+                && (offset - region->window_offset) > (region->window_size - sizeof(type)) \
+                && pci_device_region_move_window(pci_device, region_num, offset) == -1) { \
+            return; \
+        } \
+\
+        volatile type *address = (volatile type *)((uint8_t *)region->map + (offset - region->window_offset)); \
+        for (size_t i = 0; i < count; ++i) { \
+            *address = string[i]; \
+        } \
     }
 
 _pci_device_region_define(16, uint16_t)
@@ -259,54 +816,238 @@ _pci_device_region_define(32, uint32_t)
 _pci_device_region_define(8, uint8_t)
 #undef _pci_device_region_define
 
+void
+pci_device_region_read128(pci_device_t *restrict pci_device, size_t region_num, size_t offset, void *value)
+{
+    volatile void *address = pci_device_region_get_map(pci_device, region_num, offset, 16);
+    if (address == NULL) {
+        return;
+    }
+
+    mmio_read128(address, value);
+}
+
+void
+pci_device_region_read256(pci_device_t *restrict pci_device, size_t region_num, size_t offset, void *value)
+{
+    volatile void *address = pci_device_region_get_map(pci_device, region_num, offset, 32);
+    if (address == NULL) {
+        return;
+    }
+
+    if (!__builtin_cpu_supports("avx")) {
+        mmio_read128(address, value);
+        mmio_read128((volatile uint8_t *)address + 16, (uint8_t *)value + 16);
+        return;
+    }
+
+    mmio_read256(address, value);
+}
+
+uint64_t
+pci_device_region_read64(pci_device_t *restrict pci_device, size_t region_num, size_t offset)
+{
+    volatile void *address = pci_device_region_get_map(pci_device, region_num, offset, sizeof(uint64_t));
+    if (address == NULL) {
+        return (uint64_t)-1;
+    }
+
+    return mmio_read64(address);
+}
+
+size_t
+pci_device_region_read_burst(
+        pci_device_t *restrict pci_device, size_t region_num, size_t offset, void *buf, size_t size)
+{
+    size = pci_device_region_get_burst_size(pci_device, region_num, offset, size);
+    volatile void *address = pci_device_region_get_map(pci_device, region_num, offset, size);
+    if (address == NULL) {
+        return 0;
+    }
+
+    mmio_read_burst(address, buf, size);
+    return size;
+}
+
+void
+pci_device_region_write128(pci_device_t *restrict pci_device, size_t region_num, size_t offset, const void *value)
+{
+    volatile void *address = pci_device_region_get_map(pci_device, region_num, offset, 16);
+    if (address == NULL) {
+        return;
+    }
+
+    mmio_write128(address, value);
+}
+
+void
+pci_device_region_write256(pci_device_t *restrict pci_device, size_t region_num, size_t offset, const void *value)
+{
+    volatile void *address = pci_device_region_get_map(pci_device, region_num, offset, 32);
+    if (address == NULL) {
+        return;
+    }
+
+    if (!__builtin_cpu_supports("avx")) {
+        mmio_write128(address, value);
+        mmio_write128((volatile uint8_t *)address + 16, (const uint8_t *)value + 16);
+        return;
+    }
+
+    mmio_write256(address, value);
+}
+
+void
+pci_device_region_write64(pci_device_t *restrict pci_device, size_t region_num, size_t offset, uint64_t value)
+{
+    volatile void *address = pci_device_region_get_map(pci_device, region_num, offset, sizeof(uint64_t));
+    if (address == NULL) {
+        return;
+    }
+
+    mmio_write64(address, value);
+}
+
+size_t
+pci_device_region_write_burst(
+        pci_device_t *restrict pci_device, size_t region_num, size_t offset, const void *buf, size_t size)
+{
+    size = pci_device_region_get_burst_size(pci_device, region_num, offset, size);
+    volatile void *address = pci_device_region_get_map(pci_device, region_num, offset, size);
+    if (address == NULL) {
+        return 0;
+    }
+
+    mmio_write_burst(address, buf, size);
+    return size;
+}
+
 int
-pci_device_regions_map(pci_device_t *restrict pci_device)
+pci_device_region_move_window(pci_device_t *restrict pci_device, size_t region_num, size_t offset)
 {
-    for (size_t i = 0, j = 16; i < pci_device->num_regions; ++i, j += 4) {
+    /* Map the window (aligned to the page size, and within the region) that
+       contains the offset, before unmapping the current window. */
+    struct region *region = &pci_device->regions[region_num];
+    uint64_t window_offset = offset & ~((uint64_t)sysconf(_SC_PAGESIZE) - 1);
+    if (window_offset > (region->size - region->window_size)) {
+        window_offset = region->size - region->window_size;
+    }
+
+    void *map = pci_device->backend->region_map(
+            pci_device->context, region_num, region->base_address, window_offset, region->window_size);
+    if (map == MAP_FAILED) {
+        pci_device_error(pci_device, 0, errno, __func__);
+        return -1;
+    }
+
+    pci_device->backend->region_unmap(pci_device->context, region_num, region->map, region->window_size);
+    region->map = map;
+    region->window_offset = window_offset;
+    return 0;
+}
+
+void
+pci_device_region_resolve(pci_device_t *restrict pci_device, size_t region_num)
+{
+    /* Resolves the accessors of the region once, so that no access has to
+       tell I/O from memory regions, or check whether the region is mapped. */
+    struct region *region = &pci_device->regions[region_num];
+    if (region->is_io) {
+        const pci_device_backend_t *backend = pci_device->backend;
+        region->ops = _pci_device_region_ops(io);
+        if (backend->region_read16 != NULL) {
+            region->ops.read16 = pci_device_region_backend_read16;
+        }
+
+        if (backend->region_read32 != NULL) {
+            region->ops.read32 = pci_device_region_backend_read32;
+        }
+
+        if (backend->region_read8 != NULL) {
+            region->ops.read8 = pci_device_region_backend_read8;
+        }
+
+        if (backend->region_write16 != NULL) {
+            region->ops.write16 = pci_device_region_backend_write16;
+        }
+
+        if (backend->region_write32 != NULL) {
+            region->ops.write32 = pci_device_region_backend_write32;
+        }
+
+        if (backend->region_write8 != NULL) {
+            region->ops.write8 = pci_device_region_backend_write8;
+        }
+    } else if (region->map == MAP_FAILED) {
+        region->ops = _pci_device_region_ops(disabled);
+    } else if (region->window_size < region->size) {
+        region->ops = _pci_device_region_ops(window);
+    } else {
+        region->ops = _pci_device_region_ops(memory);
+    }
+}
+
+#undef _pci_device_region_ops
+
+int
+pci_device_regions_map(pci_device_t *restrict pci_device, const uint8_t *config)
+{
+    /* Disable (I/O and memory) decoding in the command register while sizing
+       the base address registers (BARs). */
+    uint16_t command = pci_device_config_read_snapshot32(pci_device, config, 4) & 0xffff;
+    pci_device_config_write16(pci_device, 4, command & ~0x03);
+    for (size_t i = 0; i < pci_device->num_regions; ++i) {
+        uint8_t j = 16 + (i * 4);
         /* Size the 32-bit base address register (BAR) */
-        /* Disable (I/O and memory) decoding in the command register before
-           sizing the BAR. */
-        uint16_t command = pci_config_read16(pci_device->bus, pci_device->device, pci_device->function, 2);
-        pci_config_write16(pci_device->bus, pci_device->device, pci_device->function, 2, command & ~0x03);
         /* Save the original value of the BAR */
-        uint64_t base_address = pci_config_read32(pci_device->bus, pci_device->device, pci_device->function, j);
+        uint64_t base_address = pci_device_config_read_snapshot32(pci_device, config, j);
         /* Write 0xffffffff to the register, then read it back */
-        pci_config_write32(pci_device->bus, pci_device->device, pci_device->function, j, 0xffffffff);
-        uint64_t size = pci_config_read32(pci_device->bus, pci_device->device, pci_device->function, j);
+        pci_device_config_write32(pci_device, j, 0xffffffff);
+        uint64_t size = pci_device_config_read32(pci_device, j);
+        bool is_implemented = (size != 0);
         size |= ((uint64_t)0xffffffff << 32);
-        /* Restore the original value of the BAR before re-enabling decoding in
-           the command register. */
-        pci_config_write32(pci_device->bus, pci_device->device, pci_device->function, j, base_address);
-        /* Re-enable decoding in the command register */
-        pci_config_write16(pci_device->bus, pci_device->device, pci_device->function, 2, command);
+        /* Restore the original value of the BAR */
+        pci_device_config_write32(pci_device, j, base_address);
         /* @todo Investigate why some ATA/IDE controllers in compatibility mode
            don't specify the ATA I/O addresses in BAR0 to BAR3. */
         if (pci_device_is_ata_controller(pci_device)) {
             /* Is in compatibility mode? */
             if ((pci_device->class_code & 0x05) == 0) {
                 if (base_address == 0) {
+                    /* The control blocks start at 0x3f4 and 0x374, so the
+                       Alternate Status/Device Control registers (i.e., 0x3f6
+                       and 0x376) are at offset 2, as in native mode. */
                     switch (j) {
                     case 16:
                         base_address = 0x1f0 | 0x01;
                         size = ~0x07;
+                        is_implemented = true;
                         break;
                     case 20:
-                        base_address = 0x3f0 | 0x01;
+                        base_address = 0x3f4 | 0x01;
                         size = ~0x03;
+                        is_implemented = true;
                         break;
                     case 24:
                         base_address = 0x170 | 0x01;
                         size = ~0x07;
+                        is_implemented = true;
                         break;
                     case 28:
-                        base_address = 0x370 | 0x01;
+                        base_address = 0x374 | 0x01;
                         size = ~0x03;
+                        is_implemented = true;
                         break;
                     }
                 }
             }
         }
 
+        /* Is not implemented (i.e., all bits are hardwired to zero)? */
+        if (!is_implemented) {
+            continue;
+        }
+
         /* Is an I/O address space? */
         if (base_address & 0x01) {
             pci_device->regions[i].is_io = true;
@@ -317,27 +1058,18 @@ pci_device_regions_map(pci_device_t *restrict pci_device)
             size = (~size + 1);
         } else {
             /* Is within a 64-bit address space? */
-            if (base_address & 0x04) {
+            if ((base_address & 0x04) && ((i + 1) < pci_device->num_regions)) {
                 /* Size the 64-bit BAR */
                 pci_device->regions[i].is_64 = true;
-                /* Disable (I/O and memory) decoding in the command register
-                   before sizing the BAR. */
-                pci_config_write16(pci_device->bus, pci_device->device, pci_device->function, 2, command & ~0x03);
                 /* Save the original value of the BAR, and extend the current
                    base address with the value of the next BAR. */
-                base_address |= ((uint64_t)pci_config_read32(
-                                         pci_device->bus, pci_device->device, pci_device->function, j += 4)
-                                 << 32);
+                base_address |= ((uint64_t)pci_device_config_read_snapshot32(pci_device, config, j + 4) << 32);
                 /* Write 0xffffffff to the register, then read it back, and
-                   extend the current size. */
-                pci_config_write32(pci_device->bus, pci_device->device, pci_device->function, j, 0xffffffff);
-                size |= ((uint64_t)pci_config_read32(pci_device->bus, pci_device->device, pci_device->function, j)
-                         << 32);
-                /* Restore the original value of the BAR before re-enabling
-                   decoding in the command register. */
-                pci_config_write32(pci_device->bus, pci_device->device, pci_device->function, j, base_address >> 32);
-                /* Re-enable decoding in the command register */
-                pci_config_write16(pci_device->bus, pci_device->device, pci_device->function, 2, command);
+                   replace the upper half of the current size. */
+                pci_device_config_write32(pci_device, j + 4, 0xffffffff);
+                size = (size & 0xffffffff) | ((uint64_t)pci_device_config_read32(pci_device, j + 4) << 32);
+                /* Restore the original value of the BAR */
+                pci_device_config_write32(pci_device, j + 4, base_address >> 32);
             }
 
             /* Clear encoding information bits (i.e., bits 0 to 3 for memory) */
@@ -350,30 +1082,39 @@ pci_device_regions_map(pci_device_t *restrict pci_device)
         pci_device->regions[i].base_address = base_address;
         pci_device->regions[i].size = size;
         if (pci_device->regions[i].is_io) {
+            pci_device_region_resolve(pci_device, i);
             continue;
         }
 
-        /* Map the (memory) region */
-        int fd = open("/dev/mem", O_RDWR | O_CLOEXEC);
-        if (fd == -1) {
-            pci_device_error(pci_device, 0, errno, __func__);
-            goto err;
+        /* Map the (memory) region, or only its first window if it is larger
+           than the window size. */
+        pci_device->regions[i].window_offset = 0;
+        pci_device->regions[i].window_size = pci_device->regions[i].size;
+        if (region_window != 0 && pci_device->regions[i].size > region_window) {
+            pci_device->regions[i].window_size = region_window;
         }
 
-        pci_device->regions[i].map = mmap(NULL, pci_device->regions[i].size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
-                pci_device->regions[i].base_address);
+        pci_device->regions[i].map = pci_device->backend->region_map(pci_device->context, i,
+                pci_device->regions[i].base_address, 0, pci_device->regions[i].window_size);
         if ((pci_device->regions[i].map == MAP_FAILED) && (errno != EPERM)) {
-            close(fd);
             pci_device_error(pci_device, 0, errno, __func__);
             goto err;
         }
 
-        close(fd);
+        pci_device_region_resolve(pci_device, i);
+
+        /* The upper half of a 64-bit BAR is not a region on its own */
+        if (pci_device->regions[i].is_64) {
+            ++i;
+        }
     }
 
+    /* Re-enable decoding in the command register */
+    pci_device_config_write16(pci_device, 4, command);
     return 0;
 
 err:
+    pci_device_config_write16(pci_device, 4, command);
     return -1;
 }
 
@@ -390,15 +1131,28 @@ pci_device_regions_unmap(pci_device_t *restrict pci_device)
         }
 
         /* Unmap the (memory) region */
-        if (munmap((void *)pci_device->regions[i].base_address, pci_device->regions[i].size) == -1) {
+        if (pci_device->backend->region_unmap(
+                    pci_device->context, i, pci_device->regions[i].map, pci_device->regions[i].window_size)
+                == -1) {
             pci_device_error(pci_device, 0, errno, __func__);
             return -1;
         }
+
+        pci_device->regions[i].map = MAP_FAILED;
+        pci_device_region_resolve(pci_device, i);
     }
 
     return 0;
 }
 
+int
+pci_device_set_config_access(int access)
+{
+    int previous_access = config_access;
+    config_access = access;
+    return previous_access;
+}
+
 pci_device_error_handler_t *
 pci_device_set_error_handler(pci_device_error_handler_t *handler)
 {
@@ -406,3 +1160,29 @@ pci_device_set_error_handler(pci_device_error_handler_t *handler)
     error_handler = handler;
     return previous_handler;
 }
+
+int
+pci_device_set_region_access(int access)
+{
+    int previous_access = region_access;
+    region_access = access;
+    return previous_access;
+}
+
+uint64_t
+pci_device_set_region_window(uint64_t size)
+{
+    /* The window is a multiple of the page size, and at least two pages, so
+       any access fits in a window aligned to the page size. */
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
+    if (size != 0) {
+        size = (size + (page_size - 1)) & ~(page_size - 1);
+        if (size < (2 * page_size)) {
+            size = 2 * page_size;
+        }
+    }
+
+    uint64_t previous_size = region_window;
+    region_window = size;
+    return previous_size;
+}
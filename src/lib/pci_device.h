@@ -12,10 +12,166 @@ extern "C" {
 #include <stddef.h>
 #include <stdint.h>
 
+#define PCI_DEVICE_MAX_BURST 4096 /**< Maximum size, in bytes, of a burst access. */
+
 typedef struct _pci_device pci_device_t; /**< PCI device. */
 
+/**
+ * PCI configuration space access mechanisms (of PCI devices created by
+ * pci_device_create()).
+ */
+enum pci_device_config_access {
+    PCI_DEVICE_CONFIG_IO,          /**< Configuration mechanism #1 (i.e., the 0xcf8 and 0xcfc ports) */
+    PCI_DEVICE_CONFIG_ECAM,        /**< Enhanced configuration access mechanism (ECAM) window */
+    PCI_DEVICE_CONFIG_SYSFS,       /**< sysfs config file */
+    PCI_DEVICE_NUM_CONFIG_ACCESSES /**< Number of mechanisms. */
+};
+
+/**
+ * PCI device memory region mapping mechanisms (of PCI devices created by
+ * pci_device_create()).
+ */
+enum pci_device_region_access {
+    PCI_DEVICE_REGION_DEVMEM,      /**< /dev/mem (at the physical address of the region) */
+    PCI_DEVICE_REGION_SYSFS,       /**< sysfs resource file of the region */
+    PCI_DEVICE_REGION_SYSFS_WC,    /**< sysfs write-combining resource file of the region (if prefetchable) */
+    PCI_DEVICE_NUM_REGION_ACCESSES /**< Number of mechanisms. */
+};
+
 typedef void pci_device_error_handler_t(int status, int error, const char *restrict format, va_list ap);
 
+/**
+ * PCI device backend.
+ *
+ * A backend provides access to the configuration space and regions of a PCI
+ * device. Each operation is called with the context given to
+ * pci_device_create_backend(). Memory regions are accessed directly through
+ * the mapping returned by region_map. String accesses to I/O regions (see
+ * pci_device_region_read_string8()) call the region read and write operations
+ * once per value.
+ */
+typedef struct pci_device_backend {
+    const char *name; /**< Name. */
+
+    /** Destroys the context. */
+    void (*destroy)(void *context);
+
+    /** Reads a 16-bit value from the configuration space. */
+    uint16_t (*config_read16)(void *context, uint16_t offset);
+    /** Reads a 32-bit value from the configuration space. */
+    uint32_t (*config_read32)(void *context, uint16_t offset);
+    /** Reads an 8-bit value from the configuration space. */
+    uint8_t (*config_read8)(void *context, uint16_t offset);
+    /** Writes a 16-bit value to the configuration space. */
+    void (*config_write16)(void *context, uint16_t offset, uint16_t value);
+    /** Writes a 32-bit value to the configuration space. */
+    void (*config_write32)(void *context, uint16_t offset, uint32_t value);
+    /** Writes an 8-bit value to the configuration space. */
+    void (*config_write8)(void *context, uint16_t offset, uint8_t value);
+
+    /** Maps size bytes of a memory region, from the offset (a multiple of the
+        page size). Returns MAP_FAILED and sets errno on failure. */
+    void *(*region_map)(void *context, size_t region_num, uint64_t base_address, uint64_t offset, uint64_t size);
+    /** Unmaps a memory region. Returns -1 and sets errno on failure. */
+    int (*region_unmap)(void *context, size_t region_num, void *map, uint64_t size);
+
+    /** Reads a 16-bit value from an I/O region. If NULL, port I/O instructions
+        are used. */
+    uint16_t (*region_read16)(void *context, size_t region_num, size_t offset);
+    /** Reads a 32-bit value from an I/O region. If NULL, port I/O instructions
+        are used. */
+    uint32_t (*region_read32)(void *context, size_t region_num, size_t offset);
+    /** Reads an 8-bit value from an I/O region. If NULL, port I/O instructions
+        are used. */
+    uint8_t (*region_read8)(void *context, size_t region_num, size_t offset);
+    /** Writes a 16-bit value to an I/O region. If NULL, port I/O instructions
+        are used. */
+    void (*region_write16)(void *context, size_t region_num, size_t offset, uint16_t value);
+    /** Writes a 32-bit value to an I/O region. If NULL, port I/O instructions
+        are used. */
+    void (*region_write32)(void *context, size_t region_num, size_t offset, uint32_t value);
+    /** Writes an 8-bit value to an I/O region. If NULL, port I/O instructions
+        are used. */
+    void (*region_write8)(void *context, size_t region_num, size_t offset, uint8_t value);
+} pci_device_backend_t;
+
+/**
+ * PCI device region accessors (see pci_device_region_get_ops()).
+ *
+ * The accessors do not validate their arguments: the region number must be
+ * that of the region the accessors were returned for, and the access must end
+ * within the region (i.e., the offset must not be greater than the size of the
+ * region minus the access width).
+ */
+typedef struct pci_device_region_ops {
+    /** Reads a 16-bit value from the region. */
+    uint16_t (*read16)(pci_device_t *restrict pci_device, size_t region_num, size_t offset);
+    /** Reads a 32-bit value from the region. */
+    uint32_t (*read32)(pci_device_t *restrict pci_device, size_t region_num, size_t offset);
+    /** Reads an 8-bit value from the region. */
+    uint8_t (*read8)(pci_device_t *restrict pci_device, size_t region_num, size_t offset);
+    /** Writes a 16-bit value to the region. */
+    void (*write16)(pci_device_t *restrict pci_device, size_t region_num, size_t offset, uint16_t value);
+    /** Writes a 32-bit value to the region. */
+    void (*write32)(pci_device_t *restrict pci_device, size_t region_num, size_t offset, uint32_t value);
+    /** Writes an 8-bit value to the region. */
+    void (*write8)(pci_device_t *restrict pci_device, size_t region_num, size_t offset, uint8_t value);
+} pci_device_region_ops_t;
+
+/**
+ * Reads a 16-bit value from the configuration space of the PCI device.
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] offset Configuration space offset.
+ * @return Value.
+ */
+uint16_t pci_device_config_read16(pci_device_t *restrict pci_device, uint16_t offset);
+
+/**
+ * Reads a 32-bit value from the configuration space of the PCI device.
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] offset Configuration space offset.
+ * @return Value.
+ */
+uint32_t pci_device_config_read32(pci_device_t *restrict pci_device, uint16_t offset);
+
+/**
+ * Reads an 8-bit value from the configuration space of the PCI device.
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] offset Configuration space offset.
+ * @return Value.
+ */
+uint8_t pci_device_config_read8(pci_device_t *restrict pci_device, uint16_t offset);
+
+/**
+ * Writes a 16-bit value to the configuration space of the PCI device.
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] offset Configuration space offset.
+ * @param [in] value Value.
+ */
+void pci_device_config_write16(pci_device_t *restrict pci_device, uint16_t offset, uint16_t value);
+
+/**
+ * Writes a 32-bit value to the configuration space of the PCI device.
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] offset Configuration space offset.
+ * @param [in] value Value.
+ */
+void pci_device_config_write32(pci_device_t *restrict pci_device, uint16_t offset, uint32_t value);
+
+/**
+ * Writes an 8-bit value to the configuration space of the PCI device.
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] offset Configuration space offset.
+ * @param [in] value Value.
+ */
+void pci_device_config_write8(pci_device_t *restrict pci_device, uint16_t offset, uint8_t value);
+
 /**
  * Creates a PCI device.
  *
@@ -26,6 +182,39 @@ typedef void pci_device_error_handler_t(int status, int error, const char *restr
  */
 pci_device_t *pci_device_create(int bus, int device, int function);
 
+/**
+ * Creates a PCI device that is accessed through the given backend.
+ *
+ * The PCI device takes ownership of the context, which is destroyed with the
+ * PCI device (or if the PCI device cannot be created).
+ *
+ * @param [in] backend PCI device backend.
+ * @param [in] context PCI device backend context.
+ * @param [in] bus PCI bus number.
+ * @param [in] device PCI device number.
+ * @param [in] function PCI function number.
+ * @return A PCI device.
+ */
+pci_device_t *pci_device_create_backend(
+        const pci_device_backend_t *backend, void *context, int bus, int device, int function);
+
+/**
+ * Creates a PCI device from a snapshot of its configuration space.
+ *
+ * The identification fields and the original values of the command register
+ * and base address registers (BARs) are taken from the snapshot instead of
+ * being read from the configuration space, so the snapshot must be current
+ * (e.g., taken by pci_bus_create()).
+ *
+ * @param [in] bus PCI bus number.
+ * @param [in] device PCI device number.
+ * @param [in] function PCI function number.
+ * @param [in] config Configuration space snapshot (i.e., at least the 64 bytes
+ *   of the predefined header), or NULL to read the configuration space.
+ * @return A PCI device.
+ */
+pci_device_t *pci_device_create_config(int bus, int device, int function, const void *config);
+
 /**
  * Destroys the PCI device.
  *
@@ -33,6 +222,15 @@ pci_device_t *pci_device_create(int bus, int device, int function);
  */
 void pci_device_destroy(pci_device_t *restrict pci_device);
 
+/**
+ * Returns the PCI configuration space access mechanism of the given name.
+ *
+ * @param [in] name Name (i.e., "io", "ecam", or "sysfs").
+ * @return Mechanism (see pci_device_config_access), or -1 if there is no
+ *   mechanism of the given name.
+ */
+int pci_device_get_config_access(const char *restrict name);
+
 /**
  * Returns the number of regions of the PCI device.
  *
@@ -41,6 +239,15 @@ void pci_device_destroy(pci_device_t *restrict pci_device);
  */
 size_t pci_device_get_num_regions(pci_device_t *restrict pci_device);
 
+/**
+ * Returns the PCI device memory region mapping mechanism of the given name.
+ *
+ * @param [in] name Name (i.e., "devmem", "sysfs", or "sysfs-wc").
+ * @return Mechanism (see pci_device_region_access), or -1 if there is no
+ *   mechanism of the given name.
+ */
+int pci_device_get_region_access(const char *restrict name);
+
 /**
  * Returns whether the PCI device is an ATA/IDE controller.
  *
@@ -59,6 +266,24 @@ bool pci_device_is_ata_controller(pci_device_t *restrict pci_device);
  */
 uint64_t pci_device_region_get_base_address(pci_device_t *restrict pci_device, size_t region_num);
 
+/**
+ * Returns the accessors of the PCI device region (i.e., the unchecked
+ * counterparts of pci_device_region_read8() and the like, for callers that
+ * already validated the region number and offset).
+ *
+ * The accessors are resolved once for each region, when the PCI device is
+ * created, to port I/O, backend, memory, or windowed memory accessors of each
+ * width, so an access is a single indirect call with no checks. The accessors
+ * of an unmapped memory region (or of an unimplemented region) report an
+ * EINVAL error as pci_device_region_read8() and the like do. The accessors are
+ * valid until the PCI device is destroyed.
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] region_num Region number.
+ * @return Accessors, or NULL if the region number is invalid.
+ */
+const pci_device_region_ops_t *pci_device_region_get_ops(pci_device_t *restrict pci_device, size_t region_num);
+
 /**
  * Returns the size of the PCI device region.
  *
@@ -108,6 +333,39 @@ uint16_t pci_device_region_read16(pci_device_t *restrict pci_device, size_t regi
  */
 uint32_t pci_device_region_read32(pci_device_t *restrict pci_device, size_t region_num, size_t offset);
 
+/**
+ * Reads a 128-bit value from the PCI device memory region (i.e., a single
+ * 128-bit vector load).
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] region_num Region number.
+ * @param [in] offset Region offset.
+ * @param [out] value Value (i.e., 16 bytes).
+ */
+void pci_device_region_read128(pci_device_t *restrict pci_device, size_t region_num, size_t offset, void *value);
+
+/**
+ * Reads a 256-bit value from the PCI device memory region (i.e., a single
+ * 256-bit vector load, or two 128-bit vector loads if the processor does not
+ * support AVX).
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] region_num Region number.
+ * @param [in] offset Region offset.
+ * @param [out] value Value (i.e., 32 bytes).
+ */
+void pci_device_region_read256(pci_device_t *restrict pci_device, size_t region_num, size_t offset, void *value);
+
+/**
+ * Reads a 64-bit value from the PCI device memory region.
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] region_num Region number.
+ * @param [in] offset Region offset.
+ * @return Value.
+ */
+uint64_t pci_device_region_read64(pci_device_t *restrict pci_device, size_t region_num, size_t offset);
+
 /**
  * Reads an 8-bit value from the PCI device region.
  *
@@ -118,6 +376,65 @@ uint32_t pci_device_region_read32(pci_device_t *restrict pci_device, size_t regi
  */
 uint8_t pci_device_region_read8(pci_device_t *restrict pci_device, size_t region_num, size_t offset);
 
+/**
+ * Reads a burst from the PCI device memory region (i.e., consecutive 64-bit
+ * reads, in ascending order, as a copy loop would do them).
+ *
+ * The burst is at most PCI_DEVICE_MAX_BURST bytes, and ends at the end of the
+ * region.
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] region_num Region number.
+ * @param [in] offset Region offset.
+ * @param [out] buf Buffer.
+ * @param [in] size Size, in bytes.
+ * @return Number of bytes read.
+ */
+size_t pci_device_region_read_burst(
+        pci_device_t *restrict pci_device, size_t region_num, size_t offset, void *buf, size_t size);
+
+/**
+ * Reads a string of 16-bit values from the PCI device region (i.e., count
+ * reads of the same offset, with a single rep insw instruction for I/O
+ * regions).
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] region_num Region number.
+ * @param [in] offset Region offset.
+ * @param [out] string Values.
+ * @param [in] count Number of values.
+ */
+void pci_device_region_read_string16(
+        pci_device_t *restrict pci_device, size_t region_num, size_t offset, uint16_t *string, size_t count);
+
+/**
+ * Reads a string of 32-bit values from the PCI device region (i.e., count
+ * reads of the same offset, with a single rep insl instruction for I/O
+ * regions).
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] region_num Region number.
+ * @param [in] offset Region offset.
+ * @param [out] string Values.
+ * @param [in] count Number of values.
+ */
+void pci_device_region_read_string32(
+        pci_device_t *restrict pci_device, size_t region_num, size_t offset, uint32_t *string, size_t count);
+
+/**
+ * Reads a string of 8-bit values from the PCI device region (i.e., count
+ * reads of the same offset, with a single rep insb instruction for I/O
+ * regions).
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] region_num Region number.
+ * @param [in] offset Region offset.
+ * @param [out] string Values.
+ * @param [in] count Number of values.
+ */
+void pci_device_region_read_string8(
+        pci_device_t *restrict pci_device, size_t region_num, size_t offset, uint8_t *string, size_t count);
+
 /**
  * Writes a 16-bit value to the PCI device region.
  *
@@ -138,6 +455,39 @@ void pci_device_region_write16(pci_device_t *restrict pci_device, size_t region_
  */
 void pci_device_region_write32(pci_device_t *restrict pci_device, size_t region_num, size_t offset, uint32_t value);
 
+/**
+ * Writes a 128-bit value to the PCI device memory region (i.e., a single
+ * 128-bit vector store).
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] region_num Region number.
+ * @param [in] offset Region offset.
+ * @param [in] value Value (i.e., 16 bytes).
+ */
+void pci_device_region_write128(pci_device_t *restrict pci_device, size_t region_num, size_t offset, const void *value);
+
+/**
+ * Writes a 256-bit value to the PCI device memory region (i.e., a single
+ * 256-bit vector store, or two 128-bit vector stores if the processor does
+ * not support AVX).
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] region_num Region number.
+ * @param [in] offset Region offset.
+ * @param [in] value Value (i.e., 32 bytes).
+ */
+void pci_device_region_write256(pci_device_t *restrict pci_device, size_t region_num, size_t offset, const void *value);
+
+/**
+ * Writes a 64-bit value to the PCI device memory region.
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] region_num Region number.
+ * @param [in] offset Region offset.
+ * @param [in] value Value.
+ */
+void pci_device_region_write64(pci_device_t *restrict pci_device, size_t region_num, size_t offset, uint64_t value);
+
 /**
  * Writes an 8-bit value to the PCI device region.
  *
@@ -148,6 +498,81 @@ void pci_device_region_write32(pci_device_t *restrict pci_device, size_t region_
  */
 void pci_device_region_write8(pci_device_t *restrict pci_device, size_t region_num, size_t offset, uint8_t value);
 
+/**
+ * Writes a burst to the PCI device memory region (i.e., consecutive 64-bit
+ * writes, in ascending order, as a copy loop would do them, followed by a
+ * store fence).
+ *
+ * The burst is at most PCI_DEVICE_MAX_BURST bytes, and ends at the end of the
+ * region.
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] region_num Region number.
+ * @param [in] offset Region offset.
+ * @param [in] buf Buffer.
+ * @param [in] size Size, in bytes.
+ * @return Number of bytes written.
+ */
+size_t pci_device_region_write_burst(
+        pci_device_t *restrict pci_device, size_t region_num, size_t offset, const void *buf, size_t size);
+
+/**
+ * Writes a string of 16-bit values to the PCI device region (i.e., count
+ * writes to the same offset, with a single rep outsw instruction for I/O
+ * regions).
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] region_num Region number.
+ * @param [in] offset Region offset.
+ * @param [in] string Values.
+ * @param [in] count Number of values.
+ */
+void pci_device_region_write_string16(
+        pci_device_t *restrict pci_device, size_t region_num, size_t offset, const uint16_t *string, size_t count);
+
+/**
+ * Writes a string of 32-bit values to the PCI device region (i.e., count
+ * writes to the same offset, with a single rep outsl instruction for I/O
+ * regions).
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] region_num Region number.
+ * @param [in] offset Region offset.
+ * @param [in] string Values.
+ * @param [in] count Number of values.
+ */
+void pci_device_region_write_string32(
+        pci_device_t *restrict pci_device, size_t region_num, size_t offset, const uint32_t *string, size_t count);
+
+/**
+ * Writes a string of 8-bit values to the PCI device region (i.e., count
+ * writes to the same offset, with a single rep outsb instruction for I/O
+ * regions).
+ *
+ * @param [in] pci_device PCI device.
+ * @param [in] region_num Region number.
+ * @param [in] offset Region offset.
+ * @param [in] string Values.
+ * @param [in] count Number of values.
+ */
+void pci_device_region_write_string8(
+        pci_device_t *restrict pci_device, size_t region_num, size_t offset, const uint8_t *string, size_t count);
+
+/**
+ * Sets the PCI configuration space access mechanism of the PCI devices created
+ * afterwards. (The default is PCI_DEVICE_CONFIG_IO.)
+ *
+ * The ECAM window of each PCI device is mapped from the base address given by
+ * the ACPI MCFG table, and each access is a single memory access. The sysfs
+ * config file of each PCI device is accessed by the kernel (which uses the ECAM
+ * window if available). Both reach the PCI Express extended configuration space
+ * (i.e., offsets 256 to 4095).
+ *
+ * @param [in] access Mechanism (see pci_device_config_access).
+ * @return Previous mechanism.
+ */
+int pci_device_set_config_access(int access);
+
 /**
  * Sets the error handler for the PCI device.
  *
@@ -156,6 +581,35 @@ void pci_device_region_write8(pci_device_t *restrict pci_device, size_t region_n
  */
 pci_device_error_handler_t *pci_device_set_error_handler(pci_device_error_handler_t *handler);
 
+/**
+ * Sets the PCI device memory region mapping mechanism of the PCI devices
+ * created afterwards. (The default is PCI_DEVICE_REGION_DEVMEM.)
+ *
+ * The sysfs resource files do not depend on /dev/mem (which is restricted on
+ * kernels with STRICT_DEVMEM), and the write-combining resource files map
+ * prefetchable regions as write-combining (other regions are mapped through
+ * their resource files). Either way, each file is opened once per PCI device.
+ *
+ * @param [in] access Mechanism (see pci_device_region_access).
+ * @return Previous mechanism.
+ */
+int pci_device_set_region_access(int access);
+
+/**
+ * Sets the window size of the memory regions of the PCI devices created
+ * afterwards.
+ *
+ * A memory region larger than the window size is not mapped whole. Instead, a
+ * window of the region is mapped, and moved (i.e., remapped) when the region is
+ * accessed outside of it, so large regions do not slow down the creation of the
+ * PCI device or use page tables for the whole region.
+ *
+ * @param [in] size Window size (rounded up to a multiple of the page size, and
+ *   at least two pages), or 0 to map the memory regions whole (the default).
+ * @return Previous window size.
+ */
+uint64_t pci_device_set_region_window(uint64_t size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,260 @@
+/** @file */
+
+#include "pci_device_mock.h"
+
+#include "pci_device.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/mman.h>
+
+#define CONFIG_SIZE 256
+
+/**
+ * Mock backend context.
+ */
+struct mock {
+    pci_device_mock_config_t config;
+    uint8_t config_space[CONFIG_SIZE];
+    uint8_t *regions[PCI_DEVICE_MOCK_MAX_REGIONS];
+};
+
+void pci_device_error(pci_device_t *restrict pci_device, int status, int error, const char *restrict format, ...);
+
+static const pci_device_mock_config_t default_config = {
+        .vendor_id = 0x1b36,
+        .device_id = 0x0005,
+        .class_code = 0xff0000,
+        .regions = {
+                {.size = 256, .is_io = true},
+                {.size = 4096},
+                {.size = 1024 * 1024, .is_64 = true},
+        },
+};
+
+static void
+pci_device_mock_config_write(struct mock *mock, uint16_t offset, uint32_t value)
+{
+    /* Emulates the writable fields of the predefined header. All other fields
+       are read-only. */
+    offset &= ~0x03;
+    uint32_t previous_value;
+    memcpy(&previous_value, &mock->config_space[offset], sizeof(previous_value));
+    if (offset == 4) {
+        /* Command register (the status register is not emulated) */
+        value = (value & 0xffff) | (previous_value & 0xffff0000);
+    } else if (offset >= 16 && offset < 40) {
+        size_t i = (offset - 16) / 4;
+        const pci_device_mock_region_t *region = &mock->config.regions[i];
+        if (i > 0 && mock->config.regions[i - 1].is_64 && !mock->config.regions[i - 1].is_io) {
+            /* Upper half of a 64-bit BAR */
+            value &= ~((mock->config.regions[i - 1].size - 1) >> 32);
+        } else if (region->size == 0) {
+            value = 0;
+        } else if (region->is_io) {
+            value = (value & ~(uint32_t)(region->size - 1)) | 0x01;
+        } else {
+            value = (value & ~(uint32_t)(region->size - 1) & ~0x0f) | (region->is_64 ? 0x04 : 0x00);
+        }
+    } else if (offset == 60) {
+        /* Interrupt Line register */
+        value = (value & 0xff) | (previous_value & 0xffffff00);
+    } else {
+        return;
+    }
+
+    memcpy(&mock->config_space[offset], &value, sizeof(value));
+}
+
+#define _pci_device_mock_config_define(size, type) \
+    static type pci_device_mock_config_read##size(void *context, uint16_t offset) \
+    { \
+        struct mock *mock = (struct mock *)context; \
+        type value = (type)-1; \
+        if (offset <= (CONFIG_SIZE - sizeof(type))) { \
+            memcpy(&value, &mock->config_space[offset], sizeof(type)); \
+        } \
+\
+        return value; \
+    } \
+\
+    static void pci_device_mock_config_write##size(void *context, uint16_t offset, type value) \
+    { \
+        struct mock *mock = (struct mock *)context; \
+        if (offset > (CONFIG_SIZE - sizeof(type)) || (offset & ~0x03) != ((offset + sizeof(type) - 1) & ~0x03)) { \
+            return; \
+        } \
+\
+        uint32_t dword; \
+        memcpy(&dword, &mock->config_space[offset & ~0x03], sizeof(dword)); \
+        memcpy((uint8_t *)&dword + (offset & 0x03), &value, sizeof(type)); \
+        pci_device_mock_config_write(mock, offset, dword); \
+    }
+
+_pci_device_mock_config_define(16, uint16_t)
+_pci_device_mock_config_define(32, uint32_t)
+_pci_device_mock_config_define(8, uint8_t)
+#undef _pci_device_mock_config_define
+
+static void
+pci_device_mock_destroy(void *context)
+{
+    struct mock *mock = (struct mock *)context;
+    if (mock == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < PCI_DEVICE_MOCK_MAX_REGIONS; ++i) {
+        free(mock->regions[i]);
+    }
+
+    free(mock);
+}
+
+static void *
+pci_device_mock_region_map(void *context, size_t region_num, uint64_t base_address, uint64_t offset, uint64_t size)
+{
+    struct mock *mock = (struct mock *)context;
+    if (region_num >= PCI_DEVICE_MOCK_MAX_REGIONS || mock->regions[region_num] == NULL
+            || offset > mock->config.regions[region_num].size
+            || size > (mock->config.regions[region_num].size - offset)) {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+
+    return mock->regions[region_num] + offset;
+}
+
+static int
+pci_device_mock_region_unmap(void *context, size_t region_num, void *map, uint64_t size)
+{
+    return 0;
+}
+
+#define _pci_device_mock_region_define(_size, type) \
+    static type pci_device_mock_region_read##_size(void *context, size_t region_num, size_t offset) \
+    { \
+        struct mock *mock = (struct mock *)context; \
+        if (mock->config.read != NULL) { \
+            return mock->config.read(mock->config.opaque, region_num, offset, sizeof(type)); \
+        } \
+\
+        type value; \
+        memcpy(&value, mock->regions[region_num] + offset, sizeof(type)); \
+        return value; \
+    } \
+\
+    static void pci_device_mock_region_write##_size(void *context, size_t region_num, size_t offset, type value) \
+    { \
+        struct mock *mock = (struct mock *)context; \
+        if (mock->config.write != NULL) { \
+            mock->config.write(mock->config.opaque, region_num, offset, sizeof(type), value); \
+            return; \
+        } \
+\
+        memcpy(mock->regions[region_num] + offset, &value, sizeof(type)); \
+    }
+
+_pci_device_mock_region_define(16, uint16_t)
+_pci_device_mock_region_define(32, uint32_t)
+_pci_device_mock_region_define(8, uint8_t)
+#undef _pci_device_mock_region_define
+
+/**
+ * Mock backend.
+ */
+static const pci_device_backend_t mock_backend = {
+        .name = "mock",
+        .destroy = pci_device_mock_destroy,
+        .config_read16 = pci_device_mock_config_read16,
+        .config_read32 = pci_device_mock_config_read32,
+        .config_read8 = pci_device_mock_config_read8,
+        .config_write16 = pci_device_mock_config_write16,
+        .config_write32 = pci_device_mock_config_write32,
+        .config_write8 = pci_device_mock_config_write8,
+        .region_map = pci_device_mock_region_map,
+        .region_unmap = pci_device_mock_region_unmap,
+        .region_read16 = pci_device_mock_region_read16,
+        .region_read32 = pci_device_mock_region_read32,
+        .region_read8 = pci_device_mock_region_read8,
+        .region_write16 = pci_device_mock_region_write16,
+        .region_write32 = pci_device_mock_region_write32,
+        .region_write8 = pci_device_mock_region_write8,
+};
+
+pci_device_t *
+pci_device_mock_create(const pci_device_mock_config_t *config)
+{
+    struct mock *mock = (struct mock *)calloc(1, sizeof(*mock));
+    if (mock == NULL) {
+        pci_device_error(NULL, 0, errno, __func__);
+        return NULL;
+    }
+
+    mock->config = (config != NULL) ? *config : default_config;
+    uint16_t vendor_id = mock->config.vendor_id;
+    uint16_t device_id = mock->config.device_id;
+    uint32_t class_code = mock->config.class_code << 8;
+    memcpy(&mock->config_space[0], &vendor_id, sizeof(vendor_id));
+    memcpy(&mock->config_space[2], &device_id, sizeof(device_id));
+    memcpy(&mock->config_space[8], &class_code, sizeof(class_code));
+    /* Assign (fictitious) base addresses, naturally aligned, and allocate the
+       memory backing each region. */
+    uint32_t io_address = 0x1000;
+    uint64_t memory_address = 0xc0000000;
+    for (size_t i = 0; i < PCI_DEVICE_MOCK_MAX_REGIONS; ++i) {
+        pci_device_mock_region_t *region = &mock->config.regions[i];
+        if (region->size == 0) {
+            continue;
+        }
+
+        if ((region->size & (region->size - 1)) != 0 || (region->is_io && region->size > 256)
+                || (!region->is_io && region->size < 16)) {
+            errno = EINVAL;
+            pci_device_error(NULL, 0, errno, __func__);
+            goto err;
+        }
+
+        mock->regions[i] = (uint8_t *)calloc(1, region->size);
+        if (mock->regions[i] == NULL) {
+            pci_device_error(NULL, 0, errno, __func__);
+            goto err;
+        }
+
+        uint64_t base_address;
+        if (region->is_io) {
+            base_address = io_address | 0x01;
+            io_address += 0x100;
+        } else {
+            memory_address = (memory_address + (region->size - 1)) & ~(region->size - 1);
+            base_address = memory_address | (region->is_64 ? 0x04 : 0x00);
+            memory_address += region->size;
+        }
+
+        uint32_t lower_base_address = base_address;
+        memcpy(&mock->config_space[16 + (i * 4)], &lower_base_address, sizeof(lower_base_address));
+        if (!region->is_io && region->is_64) {
+            /* The next region is the upper half of this one */
+            if ((i + 1) >= PCI_DEVICE_MOCK_MAX_REGIONS || mock->config.regions[i + 1].size != 0) {
+                errno = EINVAL;
+                pci_device_error(NULL, 0, errno, __func__);
+                goto err;
+            }
+
+            uint32_t upper_base_address = base_address >> 32;
+            memcpy(&mock->config_space[16 + ((i + 1) * 4)], &upper_base_address, sizeof(upper_base_address));
+            ++i;
+        }
+    }
+
+    return pci_device_create_backend(&mock_backend, mock, 0, 0, 0);
+
+err:
+    pci_device_mock_destroy(mock);
+    return NULL;
+}
@@ -0,0 +1,67 @@
+/** @file */
+
+#ifndef PCI_DEVICE_MOCK_H
+#define PCI_DEVICE_MOCK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "pci_device.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PCI_DEVICE_MOCK_MAX_REGIONS 6
+
+typedef uint32_t pci_device_mock_read_handler_t(void *opaque, size_t region_num, size_t offset, size_t size);
+typedef void pci_device_mock_write_handler_t(
+        void *opaque, size_t region_num, size_t offset, size_t size, uint32_t value);
+
+/**
+ * Mock PCI device region (i.e., base address register (BAR)).
+ */
+typedef struct pci_device_mock_region {
+    uint64_t size; /**< Size (a power of two), or 0 if not implemented. */
+    bool is_io;    /**< Whether the region is I/O. */
+    bool is_64;    /**< Whether the region is within a 64-bit address space
+                        (the next region must not be implemented). */
+} pci_device_mock_region_t;
+
+/**
+ * Mock PCI device configuration.
+ *
+ * Memory regions are backed by (zero-initialized) memory and behave as RAM. I/O
+ * regions behave as RAM unless register handlers are given, in which case
+ * every I/O region access calls them instead.
+ */
+typedef struct pci_device_mock_config {
+    uint16_t vendor_id;                                           /**< Vendor ID. */
+    uint16_t device_id;                                           /**< Device ID. */
+    uint32_t class_code;                                          /**< Class code. */
+    pci_device_mock_region_t regions[PCI_DEVICE_MOCK_MAX_REGIONS]; /**< Regions. */
+    pci_device_mock_read_handler_t *read;                         /**< I/O register read handler. */
+    pci_device_mock_write_handler_t *write;                       /**< I/O register write handler. */
+    void *opaque;                                                 /**< Register handler argument. */
+} pci_device_mock_config_t;
+
+/**
+ * Creates a mock PCI device.
+ *
+ * A mock PCI device is a purely in-memory PCI device with an emulated
+ * configuration space (including BAR sizing), so it can be created and fuzzed
+ * without privileges or a PCI bus.
+ *
+ * @param [in] config Mock PCI device configuration, or NULL for the default
+ *   configuration (an I/O region of 256 bytes, a memory region of 4 KiB, and
+ *   a 64-bit memory region of 1 MiB).
+ * @return A PCI device.
+ */
+pci_device_t *pci_device_mock_create(const pci_device_mock_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PCI_DEVICE_MOCK_H */
@@ -0,0 +1,91 @@
+/** @file */
+
+#include "pci_ecam.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define MCFG_PATH "/sys/firmware/acpi/tables/MCFG"
+#define MCFG_HEADER_SIZE 44 /**< Size of the ACPI table header and the reserved field. */
+
+/**
+ * MCFG table configuration space base address allocation structure.
+ */
+struct mcfg_allocation {
+    uint64_t base_address;
+    uint16_t segment;
+    uint8_t start_bus;
+    uint8_t end_bus;
+    uint32_t reserved;
+} __attribute__((__packed__));
+
+static int
+pci_ecam_get_base_address(int bus, uint64_t *base_address, size_t *size)
+{
+    FILE *stream = fopen(MCFG_PATH, "r");
+    if (stream == NULL) {
+        return -1;
+    }
+
+    uint8_t header[MCFG_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), stream) != sizeof(header)) {
+        fclose(stream);
+        errno = ENOENT;
+        return -1;
+    }
+
+    struct mcfg_allocation allocation;
+    while (fread(&allocation, 1, sizeof(allocation), stream) == sizeof(allocation)) {
+        if (allocation.segment == 0 && bus >= allocation.start_bus && bus <= allocation.end_bus) {
+            /* The base address is that of bus 0, even if the start bus is
+               not. */
+            *base_address = allocation.base_address + ((uint64_t)bus * PCI_ECAM_BUS_SIZE);
+            *size = (size_t)(allocation.end_bus - bus + 1) * PCI_ECAM_BUS_SIZE;
+            fclose(stream);
+            return 0;
+        }
+    }
+
+    fclose(stream);
+    errno = ENOENT;
+    return -1;
+}
+
+void *
+pci_ecam_map(int bus, size_t offset, size_t size)
+{
+    uint64_t base_address;
+    size_t window_size;
+    if (pci_ecam_get_base_address(bus, &base_address, &window_size) == -1) {
+        return MAP_FAILED;
+    }
+
+    if (offset > window_size || size > (window_size - offset)) {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+
+    int fd = open("/dev/mem", O_RDWR | O_CLOEXEC);
+    if (fd == -1) {
+        return MAP_FAILED;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, base_address + offset);
+    int error = errno;
+    close(fd);
+    errno = error;
+    return map;
+}
+
+int
+pci_ecam_unmap(void *map, size_t size)
+{
+    return munmap(map, size);
+}
@@ -0,0 +1,78 @@
+/** @file */
+
+#ifndef PCI_ECAM_H
+#define PCI_ECAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PCI_ECAM_BUS_SIZE (1 << 20)      /**< Size of the configuration spaces of a PCI bus. */
+#define PCI_ECAM_FUNCTION_SIZE (1 << 12) /**< Size of the configuration space of a PCI function. */
+
+#define _pci_ecam_config_define(size, type) \
+    static inline type pci_ecam_config_read##size(const void *map, size_t offset) \
+    { \
+        return *(const volatile type *)((const uint8_t *)map + offset); \
+    } \
+\
+    static inline void pci_ecam_config_write##size(void *map, size_t offset, type value) \
+    { \
+        *(volatile type *)((uint8_t *)map + offset) = value; \
+    }
+
+_pci_ecam_config_define(16, uint16_t)
+_pci_ecam_config_define(32, uint32_t)
+_pci_ecam_config_define(8, uint8_t)
+#undef _pci_ecam_config_define
+
+/**
+ * Returns the offset of the configuration space of the PCI function within
+ * the configuration spaces of its PCI bus.
+ *
+ * @param [in] device PCI device number.
+ * @param [in] function PCI function number.
+ * @return Offset.
+ */
+static inline size_t
+pci_ecam_get_offset(int device, int function)
+{
+    return ((size_t)device << 15) | ((size_t)function << 12);
+}
+
+/**
+ * Maps the enhanced configuration access mechanism (ECAM) window (i.e., the
+ * memory-mapped configuration spaces) of a PCI bus, from the base address given
+ * by the ACPI MCFG table.
+ *
+ * A configuration space access through the ECAM window is a single memory
+ * access, instead of the two port I/O accesses of configuration mechanism #1,
+ * and reaches the PCI Express extended configuration space (i.e., offsets 256
+ * to 4095).
+ *
+ * @param [in] bus PCI bus number (of PCI segment group 0).
+ * @param [in] offset Offset in the ECAM window of the PCI bus (e.g., see
+ *   pci_ecam_get_offset()).
+ * @param [in] size Size.
+ * @return The mapping, or MAP_FAILED (and errno is set) if the PCI bus is not
+ *   in the MCFG table or cannot be mapped.
+ */
+void *pci_ecam_map(int bus, size_t offset, size_t size);
+
+/**
+ * Unmaps an ECAM window.
+ *
+ * @param [in] map Mapping.
+ * @param [in] size Size.
+ * @return 0 on success, or -1 (and errno is set) if an error occurs.
+ */
+int pci_ecam_unmap(void *map, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PCI_ECAM_H */
@@ -3,40 +3,514 @@
 #include "pci_fuzzer.h"
 
 #include "input.h"
+#include "input_buffer.h"
+#include "latency.h"
 #include "pci_device.h"
+#include "profile.h"
+#include "recorder.h"
+#include "scheduler.h"
 
 #include <errno.h>
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#define FNV_OFFSET_BASIS UINT64_C(0xcbf29ce484222325)
+#define FNV_PRIME UINT64_C(0x100000001b3)
+#define PCI_STATUS 0x06
+/* Status register error bits (i.e., Detected Parity Error, Signaled System
+   Error, Received Master Abort, Received Target Abort, Signaled Target Abort,
+   and Master Data Parity Error) */
+#define PCI_STATUS_ERRORS 0xf900
+/* Flag of the pulls whose latency was an outlier */
+#define PULL_OUTLIER (UINT32_C(1) << 31)
+
+/* Counters are only written by the thread that owns the PCI fuzzer, so they
+   are incremented without atomic read-modify-write instructions. */
+#define pci_fuzzer_count(counter) __atomic_store_n(&(counter), (counter) + 1, __ATOMIC_RELAXED)
 
 struct _pci_fuzzer {
     pci_device_t *pci_device;
     const int *regions;
     size_t num_regions;
+    struct target {
+        size_t region;
+        size_t size;
+        bool is_io;
+        bool is_live;
+        const profile_region_t *profile;
+    } *targets;
+    size_t num_targets;
+    /* Arms of the scheduler (i.e., each function of each target) */
+    struct arm {
+        size_t target;
+        int function;
+    } *arms;
+    size_t num_arms;
+    scheduler_t *scheduler;
+    int schedule;
+    size_t arm;
+    uint32_t *pulls;
+    size_t num_pulls;
+    uint16_t status;
+    uint64_t fingerprint;
+    uint64_t fingerprint_iteration;
+    const pci_device_region_ops_t *region_ops[PCI_FUZZER_MAX_REGIONS];
+    size_t region_sizes[PCI_FUZZER_MAX_REGIONS];
+    int format;
+    uint64_t iteration;
+    uint64_t response;
+    uint64_t heartbeat;
+    const pci_fuzzer_op_t *op;
     pci_fuzzer_log_handler_t *log_handler;
     FILE *log_stream;
+    recorder_t *recorder;
+    latency_t *latency;
+    profile_t *profile;
+    uint64_t *string;
+    pci_fuzzer_stats_t stats __attribute__((__aligned__(64)));
 };
 
 static pci_fuzzer_error_handler_t *error_handler = NULL;
 
+static const char *format_names[PCI_FUZZER_NUM_FORMATS] = {
+    [PCI_FUZZER_FORMAT_V1] = "v1",
+    [PCI_FUZZER_FORMAT_V2] = "v2",
+};
+
+static const char *schedule_names[PCI_FUZZER_NUM_SCHEDULES] = {
+    [PCI_FUZZER_SCHEDULE_INPUT] = "input",
+    [PCI_FUZZER_SCHEDULE_UCB] = "ucb",
+};
+
+static const char *function_names[PCI_FUZZER_NUM_FUNCTIONS] = {
+    [PCI_FUZZER_READ16] = "pci_device_region_read16",
+    [PCI_FUZZER_READ32] = "pci_device_region_read32",
+    [PCI_FUZZER_READ8] = "pci_device_region_read8",
+    [PCI_FUZZER_WRITE16] = "pci_device_region_write16",
+    [PCI_FUZZER_WRITE32] = "pci_device_region_write32",
+    [PCI_FUZZER_WRITE8] = "pci_device_region_write8",
+    [PCI_FUZZER_READ_STRING16] = "pci_device_region_read_string16",
+    [PCI_FUZZER_READ_STRING32] = "pci_device_region_read_string32",
+    [PCI_FUZZER_READ_STRING8] = "pci_device_region_read_string8",
+    [PCI_FUZZER_WRITE_STRING16] = "pci_device_region_write_string16",
+    [PCI_FUZZER_WRITE_STRING32] = "pci_device_region_write_string32",
+    [PCI_FUZZER_WRITE_STRING8] = "pci_device_region_write_string8",
+    [PCI_FUZZER_READ128] = "pci_device_region_read128",
+    [PCI_FUZZER_READ256] = "pci_device_region_read256",
+    [PCI_FUZZER_READ64] = "pci_device_region_read64",
+    [PCI_FUZZER_READ_BURST] = "pci_device_region_read_burst",
+    [PCI_FUZZER_WRITE128] = "pci_device_region_write128",
+    [PCI_FUZZER_WRITE256] = "pci_device_region_write256",
+    [PCI_FUZZER_WRITE64] = "pci_device_region_write64",
+    [PCI_FUZZER_WRITE_BURST] = "pci_device_region_write_burst",
+};
+
+/* The accessors of the operations on regions (or at offsets) the PCI fuzzer
+   did not resolve (e.g., replayed operations), which validate them. */
+static const pci_device_region_ops_t checked_ops = {
+    .read16 = pci_device_region_read16,
+    .read32 = pci_device_region_read32,
+    .read8 = pci_device_region_read8,
+    .write16 = pci_device_region_write16,
+    .write32 = pci_device_region_write32,
+    .write8 = pci_device_region_write8,
+};
+
+static const int function_directions[PCI_FUZZER_NUM_FUNCTIONS] = {
+    [PCI_FUZZER_READ16] = LATENCY_READ,
+    [PCI_FUZZER_READ32] = LATENCY_READ,
+    [PCI_FUZZER_READ8] = LATENCY_READ,
+    [PCI_FUZZER_WRITE16] = LATENCY_WRITE,
+    [PCI_FUZZER_WRITE32] = LATENCY_WRITE,
+    [PCI_FUZZER_WRITE8] = LATENCY_WRITE,
+    [PCI_FUZZER_READ_STRING16] = LATENCY_READ_STRING,
+    [PCI_FUZZER_READ_STRING32] = LATENCY_READ_STRING,
+    [PCI_FUZZER_READ_STRING8] = LATENCY_READ_STRING,
+    [PCI_FUZZER_WRITE_STRING16] = LATENCY_WRITE_STRING,
+    [PCI_FUZZER_WRITE_STRING32] = LATENCY_WRITE_STRING,
+    [PCI_FUZZER_WRITE_STRING8] = LATENCY_WRITE_STRING,
+    [PCI_FUZZER_READ128] = LATENCY_READ,
+    [PCI_FUZZER_READ256] = LATENCY_READ,
+    [PCI_FUZZER_READ64] = LATENCY_READ,
+    [PCI_FUZZER_READ_BURST] = LATENCY_READ_BURST,
+    [PCI_FUZZER_WRITE128] = LATENCY_WRITE,
+    [PCI_FUZZER_WRITE256] = LATENCY_WRITE,
+    [PCI_FUZZER_WRITE64] = LATENCY_WRITE,
+    [PCI_FUZZER_WRITE_BURST] = LATENCY_WRITE_BURST,
+};
+
+/* The functions of each access width (i.e., indexed by the base-2 logarithm
+   of the width), to fit the operations to the widths of profiled registers */
+static const int read_functions[] = {
+    PCI_FUZZER_READ8,
+    PCI_FUZZER_READ16,
+    PCI_FUZZER_READ32,
+    PCI_FUZZER_READ64,
+};
+
+static const int read_string_functions[] = {
+    PCI_FUZZER_READ_STRING8,
+    PCI_FUZZER_READ_STRING16,
+    PCI_FUZZER_READ_STRING32,
+};
+
+static const int write_functions[] = {
+    PCI_FUZZER_WRITE8,
+    PCI_FUZZER_WRITE16,
+    PCI_FUZZER_WRITE32,
+    PCI_FUZZER_WRITE64,
+};
+
+static const int write_string_functions[] = {
+    PCI_FUZZER_WRITE_STRING8,
+    PCI_FUZZER_WRITE_STRING16,
+    PCI_FUZZER_WRITE_STRING32,
+};
+
+static const size_t function_widths[PCI_FUZZER_NUM_FUNCTIONS] = {
+    [PCI_FUZZER_READ16] = sizeof(uint16_t),
+    [PCI_FUZZER_READ32] = sizeof(uint32_t),
+    [PCI_FUZZER_READ8] = sizeof(uint8_t),
+    [PCI_FUZZER_WRITE16] = sizeof(uint16_t),
+    [PCI_FUZZER_WRITE32] = sizeof(uint32_t),
+    [PCI_FUZZER_WRITE8] = sizeof(uint8_t),
+    [PCI_FUZZER_READ_STRING16] = sizeof(uint16_t),
+    [PCI_FUZZER_READ_STRING32] = sizeof(uint32_t),
+    [PCI_FUZZER_READ_STRING8] = sizeof(uint8_t),
+    [PCI_FUZZER_WRITE_STRING16] = sizeof(uint16_t),
+    [PCI_FUZZER_WRITE_STRING32] = sizeof(uint32_t),
+    [PCI_FUZZER_WRITE_STRING8] = sizeof(uint8_t),
+    [PCI_FUZZER_READ128] = 16,
+    [PCI_FUZZER_READ256] = 32,
+    [PCI_FUZZER_READ64] = sizeof(uint64_t),
+    [PCI_FUZZER_READ_BURST] = sizeof(uint64_t),
+    [PCI_FUZZER_WRITE128] = 16,
+    [PCI_FUZZER_WRITE256] = 32,
+    [PCI_FUZZER_WRITE64] = sizeof(uint64_t),
+    [PCI_FUZZER_WRITE_BURST] = sizeof(uint64_t),
+};
+
+int pci_fuzzer_clamp(const struct target *restrict target, pci_fuzzer_op_t *restrict op);
+int pci_fuzzer_decode(pci_fuzzer_t *restrict pci_fuzzer, input_buffer_t *restrict buffer, pci_fuzzer_op_t *restrict op);
+int pci_fuzzer_decode_v1(
+        pci_fuzzer_t *restrict pci_fuzzer, input_buffer_t *restrict buffer, pci_fuzzer_op_t *restrict op);
+int pci_fuzzer_decode_v2(
+        pci_fuzzer_t *restrict pci_fuzzer, input_buffer_t *restrict buffer, pci_fuzzer_op_t *restrict op);
 void pci_fuzzer_error(pci_fuzzer_t *restrict pci_fuzzer, int status, int error, const char *restrict format, ...);
+void pci_fuzzer_fill(pci_fuzzer_t *restrict pci_fuzzer, uint32_t value, size_t size);
+void pci_fuzzer_fit(
+        const struct target *restrict target, const profile_entry_t *restrict entry, pci_fuzzer_op_t *restrict op);
 void pci_fuzzer_log(pci_fuzzer_t *restrict pci_fuzzer, const char *restrict format, ...);
+void pci_fuzzer_pull(pci_fuzzer_t *restrict pci_fuzzer, uint64_t cycles);
+void pci_fuzzer_reward(pci_fuzzer_t *restrict pci_fuzzer);
+struct target *pci_fuzzer_select(pci_fuzzer_t *restrict pci_fuzzer);
+uint64_t pci_fuzzer_start(pci_fuzzer_t *restrict pci_fuzzer);
+void pci_fuzzer_update(pci_fuzzer_t *restrict pci_fuzzer, size_t size);
+
+int
+pci_fuzzer_clamp(const struct target *restrict target, pci_fuzzer_op_t *restrict op)
+{
+    /* Returns 0 if the operation ends within its region (moving it back, so
+       it ends at the end of the region, if it would straddle it), or 1 if
+       the operation is wider than the region. The bursts end at the end of
+       the region anyway, so only their first word is fitted. */
+    size_t width = function_widths[op->function];
+    if (width > target->size) {
+        return 1;
+    }
+
+    if (op->offset > (target->size - width)) {
+        op->offset = target->size - width;
+    }
+
+    return 0;
+}
 
 pci_fuzzer_t *
 pci_fuzzer_create(pci_device_t *restrict pci_device, const int *regions, size_t num_regions)
 {
-    pci_fuzzer_t *pci_fuzzer = (pci_fuzzer_t *)calloc(1, sizeof(*pci_fuzzer));
+    /* Align the statistics to a cache line (see pci_fuzzer_stats_t) */
+    pci_fuzzer_t *pci_fuzzer = (pci_fuzzer_t *)aligned_alloc(64, sizeof(*pci_fuzzer));
     if (pci_fuzzer == NULL) {
         pci_fuzzer_error(pci_fuzzer, 0, errno, __func__);
         return NULL;
     }
 
+    memset(pci_fuzzer, 0, sizeof(*pci_fuzzer));
+
     pci_fuzzer->pci_device = pci_device;
     pci_fuzzer->regions = regions;
     pci_fuzzer->num_regions = num_regions;
+    /* Resolve the regions to be fuzzed, and whether they can be accessed at
+       all, once so that decoding does not have to query the device. */
+    pci_fuzzer->num_targets = num_regions;
+    if (regions == NULL || num_regions == 0) {
+        pci_fuzzer->num_targets = pci_device_get_num_regions(pci_device);
+    }
+
+    pci_fuzzer->targets = (struct target *)calloc(pci_fuzzer->num_targets, sizeof(*pci_fuzzer->targets));
+    if (pci_fuzzer->targets == NULL) {
+        pci_fuzzer_error(pci_fuzzer, 0, errno, __func__);
+        goto err;
+    }
+
+    /* The values of string and wide operations are read into (and written
+       from) a single buffer, allocated once, with room for a word of
+       padding. */
+    pci_fuzzer->string = (uint64_t *)aligned_alloc(64, (PCI_FUZZER_MAX_STRING * sizeof(uint32_t)) + 64);
+    if (pci_fuzzer->string == NULL) {
+        pci_fuzzer_error(pci_fuzzer, 0, errno, __func__);
+        goto err;
+    }
+
+    /* Resolve the accessors of each region once, so the operations within
+       the regions go straight to them (see pci_device_region_get_ops()). */
+    for (size_t i = 0; i < pci_device_get_num_regions(pci_device) && i < PCI_FUZZER_MAX_REGIONS; ++i) {
+        pci_fuzzer->region_ops[i] = pci_device_region_get_ops(pci_device, i);
+        pci_fuzzer->region_sizes[i] = pci_device_region_get_size(pci_device, i);
+    }
+
+    for (size_t i = 0; i < pci_fuzzer->num_targets; ++i) {
+        struct target *target = &pci_fuzzer->targets[i];
+        target->region = (regions == NULL || num_regions == 0) ? i : (size_t)regions[i];
+        target->size = pci_device_region_get_size(pci_device, target->region);
+        target->is_io = pci_device_region_is_io(pci_device, target->region);
+        target->is_live = target->is_io || pci_device_region_is_mapped(pci_device, target->region);
+    }
+
+    /* Prune the regions that cannot be accessed at all (e.g., unimplemented
+       or unmapped memory regions) up front, so no iteration is wasted on them,
+       unless there are no other regions. */
+    size_t num_live = 0;
+    for (size_t i = 0; i < pci_fuzzer->num_targets; ++i) {
+        if (pci_fuzzer->targets[i].is_live) {
+            pci_fuzzer->targets[num_live++] = pci_fuzzer->targets[i];
+        }
+    }
+
+    if (num_live > 0) {
+        pci_fuzzer->num_targets = num_live;
+    }
+
+    pci_fuzzer->arms = (struct arm *)calloc(num_live * PCI_FUZZER_NUM_FUNCTIONS, sizeof(*pci_fuzzer->arms));
+    if (num_live > 0 && pci_fuzzer->arms == NULL) {
+        pci_fuzzer_error(pci_fuzzer, 0, errno, __func__);
+        goto err;
+    }
+
+    /* The functions wider than the target (e.g., a 256-bit access to a
+       16-byte region) would never be pulled, so they get no arm */
+    for (size_t i = 0; i < num_live; ++i) {
+        int num_functions = pci_fuzzer->targets[i].is_io ? PCI_FUZZER_NUM_IO_FUNCTIONS : PCI_FUZZER_NUM_FUNCTIONS;
+        for (int j = 0; j < num_functions; ++j) {
+            if (function_widths[j] <= pci_fuzzer->targets[i].size) {
+                pci_fuzzer->arms[pci_fuzzer->num_arms++] = (struct arm){.target = i, .function = j};
+            }
+        }
+    }
+
+    pci_fuzzer->arm = SIZE_MAX;
+    pci_fuzzer->fingerprint_iteration = UINT64_MAX;
     return pci_fuzzer;
+
+err:
+    pci_fuzzer_destroy(pci_fuzzer);
+    return NULL;
+}
+
+int
+pci_fuzzer_decode(pci_fuzzer_t *restrict pci_fuzzer, input_buffer_t *restrict buffer, pci_fuzzer_op_t *restrict op)
+{
+    /* Returns 0 if an operation was decoded, 1 if the input selected a region
+       that cannot be accessed (or an operation wider than its region), or -1
+       if the input ended before an operation could be decoded. */
+    if (pci_fuzzer->format == PCI_FUZZER_FORMAT_V2) {
+        return pci_fuzzer_decode_v2(pci_fuzzer, buffer, op);
+    }
+
+    return pci_fuzzer_decode_v1(pci_fuzzer, buffer, op);
+}
+
+int
+pci_fuzzer_decode_v1(pci_fuzzer_t *restrict pci_fuzzer, input_buffer_t *restrict buffer, pci_fuzzer_op_t *restrict op)
+{
+    if (input_buffer_get_remaining(buffer) < sizeof(uint64_t)) {
+        return -1;
+    }
+
+    struct target *target = &pci_fuzzer->targets[input_buffer_derive_range(buffer, 0, pci_fuzzer->num_targets - 1)];
+    if (pci_fuzzer->scheduler != NULL) {
+        target = pci_fuzzer_select(pci_fuzzer);
+    }
+
+    if (!target->is_live) {
+        return 1;
+    }
+
+    if (input_buffer_get_remaining(buffer) < (2 * sizeof(uint64_t))) {
+        return -1;
+    }
+
+    /* The offset in a profiled region is the register sampled from the lower
+       32 bits of its field */
+    const profile_entry_t *entry = NULL;
+    op->region = target->region;
+    if (target->profile != NULL) {
+        entry = profile_region_sample(target->profile, input_buffer_read64(buffer));
+    } else {
+        op->offset = input_buffer_derive_range(buffer, 0, target->size - 1);
+    }
+
+    op->function = input_buffer_derive_range(
+            buffer, 0, (target->is_io ? PCI_FUZZER_NUM_IO_FUNCTIONS : PCI_FUZZER_NUM_FUNCTIONS) - 1);
+    if (entry != NULL) {
+        pci_fuzzer_fit(target, entry, op);
+    }
+
+    if (pci_fuzzer->scheduler != NULL) {
+        op->function = pci_fuzzer->arms[pci_fuzzer->arm].function;
+    }
+
+    op->value = 0;
+    switch (op->function) {
+    case PCI_FUZZER_WRITE16:
+        if (input_buffer_get_remaining(buffer) < sizeof(uint16_t)) {
+            return -1;
+        }
+
+        op->value = input_buffer_read16(buffer);
+        break;
+
+    case PCI_FUZZER_WRITE32:
+    case PCI_FUZZER_READ_STRING16:
+    case PCI_FUZZER_READ_STRING32:
+    case PCI_FUZZER_READ_STRING8:
+    case PCI_FUZZER_WRITE_STRING16:
+    case PCI_FUZZER_WRITE_STRING32:
+    case PCI_FUZZER_WRITE_STRING8:
+    case PCI_FUZZER_READ_BURST:
+    case PCI_FUZZER_WRITE128:
+    case PCI_FUZZER_WRITE256:
+    case PCI_FUZZER_WRITE_BURST:
+        if (input_buffer_get_remaining(buffer) < sizeof(uint32_t)) {
+            return -1;
+        }
+
+        op->value = input_buffer_read32(buffer);
+        break;
+
+    case PCI_FUZZER_WRITE64:
+        if (input_buffer_get_remaining(buffer) < sizeof(uint64_t)) {
+            return -1;
+        }
+
+        op->value = input_buffer_read64(buffer);
+        break;
+
+    case PCI_FUZZER_WRITE8:
+        if (input_buffer_get_remaining(buffer) < sizeof(uint8_t)) {
+            return -1;
+        }
+
+        op->value = input_buffer_read8(buffer);
+        break;
+    }
+
+    return pci_fuzzer_clamp(target, op);
+}
+
+int
+pci_fuzzer_decode_v2(pci_fuzzer_t *restrict pci_fuzzer, input_buffer_t *restrict buffer, pci_fuzzer_op_t *restrict op)
+{
+    /* The region and function take as many bits as their ranges need, and
+       the offset is a varint, so the common case (e.g., a register in the
+       first 128 bytes of a region) takes a single byte. */
+    size_t num_targets = pci_fuzzer->num_targets;
+    size_t num_bits = (num_targets > 1) ? (64 - __builtin_clzll(num_targets - 1)) : 0;
+    if (input_buffer_get_remaining_bits(buffer) < num_bits) {
+        return -1;
+    }
+
+    struct target *target = &pci_fuzzer->targets[input_buffer_derive_packed_range(buffer, 0, num_targets - 1)];
+    if (pci_fuzzer->scheduler != NULL) {
+        target = pci_fuzzer_select(pci_fuzzer);
+    }
+
+    if (!target->is_live) {
+        return 1;
+    }
+
+    size_t num_functions = target->is_io ? PCI_FUZZER_NUM_IO_FUNCTIONS : PCI_FUZZER_NUM_FUNCTIONS;
+    num_bits = 64 - __builtin_clzll(num_functions - 1);
+    if (input_buffer_get_remaining_bits(buffer) < num_bits) {
+        return -1;
+    }
+
+    op->region = target->region;
+    op->function = input_buffer_derive_packed_range(buffer, 0, num_functions - 1);
+
+    if (target->profile != NULL) {
+        /* The offset in a profiled region is the register sampled from a
+           32-bit field */
+        if (input_buffer_get_remaining_bits(buffer) < 32) {
+            return -1;
+        }
+
+        pci_fuzzer_fit(target, profile_region_sample(target->profile, input_buffer_read_bits(buffer, 32)), op);
+    } else {
+        uint64_t offset;
+        if (!input_buffer_read_varint(buffer, &offset)) {
+            return -1;
+        }
+
+        /* Offsets past the end of the region wrap around (a division, but
+           only for the large offsets) */
+        op->offset = (offset < target->size) ? offset : (offset % target->size);
+    }
+
+    if (pci_fuzzer->scheduler != NULL) {
+        op->function = pci_fuzzer->arms[pci_fuzzer->arm].function;
+    }
+
+    op->value = 0;
+    if (!pci_fuzzer_function_has_value(op->function)) {
+        return pci_fuzzer_clamp(target, op);
+    }
+
+    switch (op->function) {
+    case PCI_FUZZER_WRITE16:
+        num_bits = 16;
+        break;
+
+    case PCI_FUZZER_WRITE64:
+        num_bits = 64;
+        break;
+
+    case PCI_FUZZER_WRITE8:
+        num_bits = 8;
+        break;
+
+    default:
+        num_bits = 32;
+        break;
+    }
+
+    if (input_buffer_get_remaining_bits(buffer) < num_bits) {
+        return -1;
+    }
+
+    if (num_bits == 64) {
+        op->value = input_buffer_read_bits(buffer, 32);
+        op->value |= (uint64_t)input_buffer_read_bits(buffer, 32) << 32;
+    } else {
+        op->value = input_buffer_read_bits(buffer, num_bits);
+    }
+
+    return pci_fuzzer_clamp(target, op);
 }
 
 void
@@ -46,6 +520,11 @@ pci_fuzzer_destroy(pci_fuzzer_t *restrict pci_fuzzer)
         return;
     }
 
+    scheduler_destroy(pci_fuzzer->scheduler);
+    free(pci_fuzzer->targets);
+    free(pci_fuzzer->arms);
+    free(pci_fuzzer->pulls);
+    free(pci_fuzzer->string);
     free(pci_fuzzer);
 }
 
@@ -63,70 +542,568 @@ pci_fuzzer_error(pci_fuzzer_t *restrict pci_fuzzer, int status, int error, const
 }
 
 void
-pci_fuzzer_iterate(pci_fuzzer_t *restrict pci_fuzzer, FILE *restrict stream)
+pci_fuzzer_execute(pci_fuzzer_t *restrict pci_fuzzer, const pci_fuzzer_op_t *restrict op)
 {
-    size_t region = 0;
-    if (pci_fuzzer->regions == NULL || pci_fuzzer->num_regions == 0) {
-        size_t num_regions = pci_device_get_num_regions(pci_fuzzer->pci_device);
-        region = input_derive_range(stream, 0, num_regions - 1);
-    } else {
-        size_t region_num = input_derive_range(stream, 0, pci_fuzzer->num_regions - 1);
-        region = pci_fuzzer->regions[region_num];
+    /* Operations of unknown functions (e.g., from a corrupted replay file) are
+       skipped */
+    if (op->function < 0 || op->function >= PCI_FUZZER_NUM_FUNCTIONS) {
+        return;
     }
 
-    if (!pci_device_region_is_io(pci_fuzzer->pci_device, region)
-            && !pci_device_region_is_mapped(pci_fuzzer->pci_device, region)) {
-        return;
+    size_t region = op->region;
+    size_t offset = op->offset;
+    if (pci_fuzzer->recorder != NULL) {
+        recorder_append(pci_fuzzer->recorder, pci_fuzzer->iteration, region, op->function, offset, op->value);
     }
 
-    size_t region_size = pci_device_region_get_size(pci_fuzzer->pci_device, region);
-    size_t offset = input_derive_range(stream, 0, region_size - 1);
-    switch (input_derive_range(stream, 0, 5)) {
-    case 0: {
+    /* The heartbeat is odd while the operation is in progress, so a watchdog
+       thread can tell a stalled access from an idle fuzzer (e.g., one waiting
+       for test cases) at the cost of a few stores and no system calls. */
+    uint64_t heartbeat = pci_fuzzer->heartbeat;
+    pci_fuzzer->op = op;
+    __atomic_store_n(&pci_fuzzer->heartbeat, heartbeat + 1, __ATOMIC_RELEASE);
+
+    const pci_device_region_ops_t *ops = &checked_ops;
+    if (region < PCI_FUZZER_MAX_REGIONS && offset < pci_fuzzer->region_sizes[region]
+            && function_widths[op->function] <= (pci_fuzzer->region_sizes[region] - offset)) {
+        ops = pci_fuzzer->region_ops[region];
+    }
+
+    uint64_t start;
+    size_t count = 1;
+    size_t size = 0;
+    switch (op->function) {
+    case PCI_FUZZER_READ16: {
         pci_fuzzer_log(pci_fuzzer, "suu", "function", "pci_device_region_read16", "region", region, "offset", offset);
-        pci_device_region_read16(pci_fuzzer->pci_device, region, offset);
+        start = pci_fuzzer_start(pci_fuzzer);
+        uint16_t value = ops->read16(pci_fuzzer->pci_device, region, offset);
+        pci_fuzzer->response = (pci_fuzzer->response ^ value) * FNV_PRIME;
         break;
     }
 
-    case 1: {
+    case PCI_FUZZER_READ32: {
         pci_fuzzer_log(pci_fuzzer, "suu", "function", "pci_device_region_read32", "region", region, "offset", offset);
-        pci_device_region_read32(pci_fuzzer->pci_device, region, offset);
+        start = pci_fuzzer_start(pci_fuzzer);
+        uint32_t value = ops->read32(pci_fuzzer->pci_device, region, offset);
+        pci_fuzzer->response = (pci_fuzzer->response ^ value) * FNV_PRIME;
         break;
     }
 
-    case 2: {
+    case PCI_FUZZER_READ8: {
         pci_fuzzer_log(pci_fuzzer, "suu", "function", "pci_device_region_read8", "region", region, "offset", offset);
-        pci_device_region_read8(pci_fuzzer->pci_device, region, offset);
+        start = pci_fuzzer_start(pci_fuzzer);
+        uint8_t value = ops->read8(pci_fuzzer->pci_device, region, offset);
+        pci_fuzzer->response = (pci_fuzzer->response ^ value) * FNV_PRIME;
         break;
     }
 
-    case 3: {
-        uint16_t value = input_read16(stream);
+    case PCI_FUZZER_WRITE16: {
+        uint16_t value = op->value;
         pci_fuzzer_log(pci_fuzzer, "suuu", "function", "pci_device_region_write16", "region", region, "offset", offset,
                 "value", value);
-        pci_device_region_write16(pci_fuzzer->pci_device, region, offset, value);
+        start = pci_fuzzer_start(pci_fuzzer);
+        ops->write16(pci_fuzzer->pci_device, region, offset, value);
         break;
     }
 
-    case 4: {
-        uint32_t value = input_read32(stream);
+    case PCI_FUZZER_WRITE32: {
+        uint32_t value = op->value;
         pci_fuzzer_log(pci_fuzzer, "suuu", "function", "pci_device_region_write32", "region", region, "offset", offset,
                 "value", value);
-        pci_device_region_write32(pci_fuzzer->pci_device, region, offset, value);
+        start = pci_fuzzer_start(pci_fuzzer);
+        ops->write32(pci_fuzzer->pci_device, region, offset, value);
         break;
     }
 
-    case 5: {
-        uint8_t value = input_read8(stream);
+    case PCI_FUZZER_WRITE8: {
+        uint8_t value = op->value;
         pci_fuzzer_log(pci_fuzzer, "suuu", "function", "pci_device_region_write8", "region", region, "offset", offset,
                 "value", value);
-        pci_device_region_write8(pci_fuzzer->pci_device, region, offset, value);
+        start = pci_fuzzer_start(pci_fuzzer);
+        ops->write8(pci_fuzzer->pci_device, region, offset, value);
+        break;
+    }
+
+    case PCI_FUZZER_READ_STRING16: {
+        uint32_t value = op->value;
+        count = (value % PCI_FUZZER_MAX_STRING) + 1;
+        size = count * sizeof(uint16_t);
+        pci_fuzzer_log(pci_fuzzer, "suuu", "function", "pci_device_region_read_string16", "region", region, "offset",
+                offset, "value", value);
+        start = pci_fuzzer_start(pci_fuzzer);
+        pci_device_region_read_string16(pci_fuzzer->pci_device, region, offset, (uint16_t *)pci_fuzzer->string, count);
+        break;
+    }
+
+    case PCI_FUZZER_READ_STRING32: {
+        uint32_t value = op->value;
+        count = (value % PCI_FUZZER_MAX_STRING) + 1;
+        size = count * sizeof(uint32_t);
+        pci_fuzzer_log(pci_fuzzer, "suuu", "function", "pci_device_region_read_string32", "region", region, "offset",
+                offset, "value", value);
+        start = pci_fuzzer_start(pci_fuzzer);
+        pci_device_region_read_string32(pci_fuzzer->pci_device, region, offset, (uint32_t *)pci_fuzzer->string, count);
+        break;
+    }
+
+    case PCI_FUZZER_READ_STRING8: {
+        uint32_t value = op->value;
+        count = (value % PCI_FUZZER_MAX_STRING) + 1;
+        size = count * sizeof(uint8_t);
+        pci_fuzzer_log(pci_fuzzer, "suuu", "function", "pci_device_region_read_string8", "region", region, "offset",
+                offset, "value", value);
+        start = pci_fuzzer_start(pci_fuzzer);
+        pci_device_region_read_string8(pci_fuzzer->pci_device, region, offset, (uint8_t *)pci_fuzzer->string, count);
+        break;
+    }
+
+    case PCI_FUZZER_WRITE_STRING16: {
+        uint32_t value = op->value;
+        count = (value % PCI_FUZZER_MAX_STRING) + 1;
+        pci_fuzzer_fill(pci_fuzzer, value, count * sizeof(uint16_t));
+        pci_fuzzer_log(pci_fuzzer, "suuu", "function", "pci_device_region_write_string16", "region", region, "offset",
+                offset, "value", value);
+        start = pci_fuzzer_start(pci_fuzzer);
+        pci_device_region_write_string16(
+                pci_fuzzer->pci_device, region, offset, (const uint16_t *)pci_fuzzer->string, count);
+        break;
+    }
+
+    case PCI_FUZZER_WRITE_STRING32: {
+        uint32_t value = op->value;
+        count = (value % PCI_FUZZER_MAX_STRING) + 1;
+        pci_fuzzer_fill(pci_fuzzer, value, count * sizeof(uint32_t));
+        pci_fuzzer_log(pci_fuzzer, "suuu", "function", "pci_device_region_write_string32", "region", region, "offset",
+                offset, "value", value);
+        start = pci_fuzzer_start(pci_fuzzer);
+        pci_device_region_write_string32(
+                pci_fuzzer->pci_device, region, offset, (const uint32_t *)pci_fuzzer->string, count);
+        break;
+    }
+
+    case PCI_FUZZER_WRITE_STRING8: {
+        uint32_t value = op->value;
+        count = (value % PCI_FUZZER_MAX_STRING) + 1;
+        pci_fuzzer_fill(pci_fuzzer, value, count * sizeof(uint8_t));
+        pci_fuzzer_log(pci_fuzzer, "suuu", "function", "pci_device_region_write_string8", "region", region, "offset",
+                offset, "value", value);
+        start = pci_fuzzer_start(pci_fuzzer);
+        pci_device_region_write_string8(
+                pci_fuzzer->pci_device, region, offset, (const uint8_t *)pci_fuzzer->string, count);
+        break;
+    }
+
+    case PCI_FUZZER_READ128:
+        pci_fuzzer_log(pci_fuzzer, "suu", "function", "pci_device_region_read128", "region", region, "offset", offset);
+        size = 16;
+        start = pci_fuzzer_start(pci_fuzzer);
+        pci_device_region_read128(pci_fuzzer->pci_device, region, offset, pci_fuzzer->string);
+        break;
+
+    case PCI_FUZZER_READ256:
+        pci_fuzzer_log(pci_fuzzer, "suu", "function", "pci_device_region_read256", "region", region, "offset", offset);
+        size = 32;
+        start = pci_fuzzer_start(pci_fuzzer);
+        pci_device_region_read256(pci_fuzzer->pci_device, region, offset, pci_fuzzer->string);
+        break;
+
+    case PCI_FUZZER_READ64: {
+        pci_fuzzer_log(pci_fuzzer, "suu", "function", "pci_device_region_read64", "region", region, "offset", offset);
+        start = pci_fuzzer_start(pci_fuzzer);
+        uint64_t value = pci_device_region_read64(pci_fuzzer->pci_device, region, offset);
+        pci_fuzzer->response = (pci_fuzzer->response ^ value) * FNV_PRIME;
+        break;
+    }
+
+    case PCI_FUZZER_READ_BURST: {
+        uint32_t value = op->value;
+        pci_fuzzer_log(pci_fuzzer, "suuu", "function", "pci_device_region_read_burst", "region", region, "offset",
+                offset, "value", value);
+        start = pci_fuzzer_start(pci_fuzzer);
+        size = pci_device_region_read_burst(pci_fuzzer->pci_device, region, offset, pci_fuzzer->string,
+                (value % PCI_FUZZER_MAX_BURST) + 1);
+        count = (size + (sizeof(uint64_t) - 1)) / sizeof(uint64_t);
+        break;
+    }
+
+    case PCI_FUZZER_WRITE128: {
+        uint32_t value = op->value;
+        pci_fuzzer_fill(pci_fuzzer, value, 16);
+        pci_fuzzer_log(pci_fuzzer, "suuu", "function", "pci_device_region_write128", "region", region, "offset", offset,
+                "value", value);
+        start = pci_fuzzer_start(pci_fuzzer);
+        pci_device_region_write128(pci_fuzzer->pci_device, region, offset, pci_fuzzer->string);
+        break;
+    }
+
+    case PCI_FUZZER_WRITE256: {
+        uint32_t value = op->value;
+        pci_fuzzer_fill(pci_fuzzer, value, 32);
+        pci_fuzzer_log(pci_fuzzer, "suuu", "function", "pci_device_region_write256", "region", region, "offset", offset,
+                "value", value);
+        start = pci_fuzzer_start(pci_fuzzer);
+        pci_device_region_write256(pci_fuzzer->pci_device, region, offset, pci_fuzzer->string);
+        break;
+    }
+
+    case PCI_FUZZER_WRITE64: {
+        uint64_t value = op->value;
+        pci_fuzzer_log(pci_fuzzer, "suuq", "function", "pci_device_region_write64", "region", region, "offset", offset,
+                "value", (unsigned long long)value);
+        start = pci_fuzzer_start(pci_fuzzer);
+        pci_device_region_write64(pci_fuzzer->pci_device, region, offset, value);
+        break;
+    }
+
+    case PCI_FUZZER_WRITE_BURST: {
+        uint32_t value = op->value;
+        pci_fuzzer_fill(pci_fuzzer, value, (value % PCI_FUZZER_MAX_BURST) + 1);
+        pci_fuzzer_log(pci_fuzzer, "suuu", "function", "pci_device_region_write_burst", "region", region, "offset",
+                offset, "value", value);
+        start = pci_fuzzer_start(pci_fuzzer);
+        size = pci_device_region_write_burst(pci_fuzzer->pci_device, region, offset, pci_fuzzer->string,
+                (value % PCI_FUZZER_MAX_BURST) + 1);
+        count = (size + (sizeof(uint64_t) - 1)) / sizeof(uint64_t);
+        /* Nothing was read, so there is nothing to hash */
+        size = 0;
         break;
     }
 
     default:
         abort();
     }
+
+    if (pci_fuzzer->latency != NULL || pci_fuzzer->arm != SIZE_MAX) {
+        uint64_t cycles = (latency_stop() - start) / ((count != 0) ? count : 1);
+        if (pci_fuzzer->latency != NULL) {
+            latency_record(pci_fuzzer->latency, region, offset, function_widths[op->function],
+                    function_directions[op->function], cycles);
+        }
+
+        if (pci_fuzzer->arm != SIZE_MAX) {
+            pci_fuzzer_pull(pci_fuzzer, cycles);
+        }
+    }
+
+    /* The values of a string or wide read are hashed only once it was timed */
+    if (size != 0) {
+        pci_fuzzer_update(pci_fuzzer, size);
+    }
+
+    __atomic_store_n(&pci_fuzzer->heartbeat, heartbeat + 2, __ATOMIC_RELEASE);
+    pci_fuzzer_count(pci_fuzzer->stats.num_function_ops[op->function]);
+    if (region < PCI_FUZZER_MAX_REGIONS) {
+        pci_fuzzer_count(pci_fuzzer->stats.num_region_ops[region]);
+    }
+}
+
+void
+pci_fuzzer_fill(pci_fuzzer_t *restrict pci_fuzzer, uint32_t value, size_t size)
+{
+    /* Fills the buffer with the bytes written by a string or wide operation
+       (i.e., a SplitMix64 sequence seeded by the value of the operation, so
+       replaying the operation writes the same bytes). */
+    size_t num_words = (size + (sizeof(uint64_t) - 1)) / sizeof(uint64_t);
+    uint64_t state = value;
+    for (size_t i = 0; i < num_words; ++i) {
+        uint64_t z = (state += UINT64_C(0x9e3779b97f4a7c15));
+        z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+        z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+        pci_fuzzer->string[i] = z ^ (z >> 31);
+    }
+}
+
+void
+pci_fuzzer_fit(
+        const struct target *restrict target, const profile_entry_t *restrict entry, pci_fuzzer_op_t *restrict op)
+{
+    /* Moves the operation to a profiled register, and replaces its function
+       with the function of the same kind (e.g., a read) of the widest valid
+       access width, unless its width is valid. The wide and burst operations
+       span several registers anyway, so they are left as they are. */
+    op->offset = (entry->offset < target->size) ? entry->offset : (entry->offset % target->size);
+    const int *functions;
+    unsigned int widths = entry->widths;
+    switch (op->function) {
+    case PCI_FUZZER_READ16:
+    case PCI_FUZZER_READ32:
+    case PCI_FUZZER_READ8:
+    case PCI_FUZZER_READ64:
+        functions = read_functions;
+        break;
+
+    case PCI_FUZZER_WRITE16:
+    case PCI_FUZZER_WRITE32:
+    case PCI_FUZZER_WRITE8:
+    case PCI_FUZZER_WRITE64:
+        functions = write_functions;
+        break;
+
+    case PCI_FUZZER_READ_STRING16:
+    case PCI_FUZZER_READ_STRING32:
+    case PCI_FUZZER_READ_STRING8:
+        functions = read_string_functions;
+        widths &= 1 | 2 | 4;
+        break;
+
+    case PCI_FUZZER_WRITE_STRING16:
+    case PCI_FUZZER_WRITE_STRING32:
+    case PCI_FUZZER_WRITE_STRING8:
+        functions = write_string_functions;
+        widths &= 1 | 2 | 4;
+        break;
+
+    default:
+        return;
+    }
+
+    /* There are no 64-bit I/O accesses */
+    if (target->is_io) {
+        widths &= 1 | 2 | 4;
+    }
+
+    if (widths == 0 || (widths & function_widths[op->function]) != 0) {
+        return;
+    }
+
+    op->function = functions[31 - __builtin_clz(widths)];
+}
+
+bool
+pci_fuzzer_function_has_value(int function)
+{
+    switch (function) {
+    case PCI_FUZZER_READ128:
+    case PCI_FUZZER_READ256:
+    case PCI_FUZZER_READ64:
+        return false;
+
+    default:
+        return function >= PCI_FUZZER_WRITE16 && function < PCI_FUZZER_NUM_FUNCTIONS;
+    }
+}
+
+uint64_t
+pci_fuzzer_get_fingerprint(pci_fuzzer_t *restrict pci_fuzzer)
+{
+    /* The Status register records errors (e.g., master and target aborts)
+       that no read back reflects. The scheduler already read it at the end
+       of the iteration. */
+    if (pci_fuzzer->fingerprint_iteration == pci_fuzzer->iteration) {
+        return pci_fuzzer->fingerprint;
+    }
+
+    uint16_t status = pci_device_config_read16(pci_fuzzer->pci_device, PCI_STATUS);
+    return (pci_fuzzer->response ^ status) * FNV_PRIME;
+}
+
+uint64_t
+pci_fuzzer_get_heartbeat(pci_fuzzer_t *restrict pci_fuzzer, pci_fuzzer_op_t *restrict op)
+{
+    /* The operation in progress is only pointed to (it stays valid for as
+       long as the operation is stalled), so as not to copy every operation. */
+    uint64_t heartbeat = __atomic_load_n(&pci_fuzzer->heartbeat, __ATOMIC_ACQUIRE);
+    if (op != NULL && (heartbeat & 1) != 0) {
+        *op = *pci_fuzzer->op;
+    }
+
+    return heartbeat;
+}
+
+int
+pci_fuzzer_get_format(const char *restrict name)
+{
+    for (int i = 0; i < PCI_FUZZER_NUM_FORMATS; ++i) {
+        if (strcmp(name, format_names[i]) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+const char *
+pci_fuzzer_get_function_name(int function)
+{
+    if (function < 0 || function >= PCI_FUZZER_NUM_FUNCTIONS) {
+        return NULL;
+    }
+
+    return function_names[function];
+}
+
+uint64_t
+pci_fuzzer_get_response(pci_fuzzer_t *restrict pci_fuzzer)
+{
+    return pci_fuzzer->response;
+}
+
+int
+pci_fuzzer_get_schedule(const char *restrict name)
+{
+    for (int i = 0; i < PCI_FUZZER_NUM_SCHEDULES; ++i) {
+        if (strcmp(name, schedule_names[i]) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void
+pci_fuzzer_get_stats(pci_fuzzer_t *restrict pci_fuzzer, pci_fuzzer_stats_t *restrict stats)
+{
+    stats->num_iterations = __atomic_load_n(&pci_fuzzer->stats.num_iterations, __ATOMIC_RELAXED);
+    stats->num_skipped = __atomic_load_n(&pci_fuzzer->stats.num_skipped, __ATOMIC_RELAXED);
+    stats->num_rewarded = __atomic_load_n(&pci_fuzzer->stats.num_rewarded, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < PCI_FUZZER_MAX_REGIONS; ++i) {
+        stats->num_region_ops[i] = __atomic_load_n(&pci_fuzzer->stats.num_region_ops[i], __ATOMIC_RELAXED);
+    }
+
+    for (size_t i = 0; i < PCI_FUZZER_NUM_FUNCTIONS; ++i) {
+        stats->num_function_ops[i] = __atomic_load_n(&pci_fuzzer->stats.num_function_ops[i], __ATOMIC_RELAXED);
+    }
+}
+
+void
+pci_fuzzer_iterate(pci_fuzzer_t *restrict pci_fuzzer, FILE *restrict stream)
+{
+    if (pci_fuzzer->format == PCI_FUZZER_FORMAT_V2) {
+        /* Bit-packed fields are only decoded from buffers */
+        uint8_t buf[PCI_FUZZER_MAX_INPUT];
+        size_t size = fread(buf, 1, sizeof(buf), stream);
+        pci_fuzzer_iterate_buf(pci_fuzzer, buf, size);
+        return;
+    }
+
+    ++pci_fuzzer->iteration;
+    pci_fuzzer->response = FNV_OFFSET_BASIS;
+    pci_fuzzer_count(pci_fuzzer->stats.num_iterations);
+    struct target *target = &pci_fuzzer->targets[input_derive_range(stream, 0, pci_fuzzer->num_targets - 1)];
+    if (pci_fuzzer->scheduler != NULL) {
+        target = pci_fuzzer_select(pci_fuzzer);
+    }
+
+    if (!target->is_live) {
+        pci_fuzzer_count(pci_fuzzer->stats.num_skipped);
+        return;
+    }
+
+    const profile_entry_t *entry = NULL;
+    pci_fuzzer_op_t op = {.region = target->region};
+    if (target->profile != NULL) {
+        entry = profile_region_sample(target->profile, input_read64(stream));
+    } else {
+        op.offset = input_derive_range(stream, 0, target->size - 1);
+    }
+
+    op.function = input_derive_range(
+            stream, 0, (target->is_io ? PCI_FUZZER_NUM_IO_FUNCTIONS : PCI_FUZZER_NUM_FUNCTIONS) - 1);
+    if (entry != NULL) {
+        pci_fuzzer_fit(target, entry, &op);
+    }
+
+    if (pci_fuzzer->scheduler != NULL) {
+        op.function = pci_fuzzer->arms[pci_fuzzer->arm].function;
+    }
+
+    switch (op.function) {
+    case PCI_FUZZER_WRITE16:
+        op.value = input_read16(stream);
+        break;
+
+    case PCI_FUZZER_WRITE32:
+    case PCI_FUZZER_READ_STRING16:
+    case PCI_FUZZER_READ_STRING32:
+    case PCI_FUZZER_READ_STRING8:
+    case PCI_FUZZER_WRITE_STRING16:
+    case PCI_FUZZER_WRITE_STRING32:
+    case PCI_FUZZER_WRITE_STRING8:
+    case PCI_FUZZER_READ_BURST:
+    case PCI_FUZZER_WRITE128:
+    case PCI_FUZZER_WRITE256:
+    case PCI_FUZZER_WRITE_BURST:
+        op.value = input_read32(stream);
+        break;
+
+    case PCI_FUZZER_WRITE64:
+        op.value = input_read64(stream);
+        break;
+
+    case PCI_FUZZER_WRITE8:
+        op.value = input_read8(stream);
+        break;
+    }
+
+    if (pci_fuzzer_clamp(target, &op) == 0) {
+        pci_fuzzer_execute(pci_fuzzer, &op);
+    } else {
+        pci_fuzzer_count(pci_fuzzer->stats.num_skipped);
+    }
+
+    if (pci_fuzzer->scheduler != NULL) {
+        pci_fuzzer_reward(pci_fuzzer);
+    }
+}
+
+size_t
+pci_fuzzer_iterate_buf(pci_fuzzer_t *restrict pci_fuzzer, const void *buf, size_t size)
+{
+    ++pci_fuzzer->iteration;
+    pci_fuzzer->response = FNV_OFFSET_BASIS;
+    pci_fuzzer_count(pci_fuzzer->stats.num_iterations);
+    input_buffer_t buffer;
+    input_buffer_init(&buffer, buf, size);
+    pci_fuzzer_op_t op;
+    switch (pci_fuzzer_decode(pci_fuzzer, &buffer, &op)) {
+    case -1:
+        input_buffer_underflow(&buffer, __func__);
+
+    case 0:
+        pci_fuzzer_execute(pci_fuzzer, &op);
+        break;
+
+    case 1:
+        pci_fuzzer_count(pci_fuzzer->stats.num_skipped);
+        break;
+    }
+
+    if (pci_fuzzer->scheduler != NULL) {
+        pci_fuzzer_reward(pci_fuzzer);
+    }
+
+    return buffer.position;
+}
+
+size_t
+pci_fuzzer_iterate_program(pci_fuzzer_t *restrict pci_fuzzer, const void *buf, size_t size)
+{
+    ++pci_fuzzer->iteration;
+    pci_fuzzer->response = FNV_OFFSET_BASIS;
+    pci_fuzzer_count(pci_fuzzer->stats.num_iterations);
+    input_buffer_t buffer;
+    input_buffer_init(&buffer, buf, size);
+    size_t num_ops = 0;
+    for (;;) {
+        pci_fuzzer_op_t op;
+        int result = pci_fuzzer_decode(pci_fuzzer, &buffer, &op);
+        if (result == -1) {
+            break;
+        }
+
+        if (result == 0) {
+            pci_fuzzer_execute(pci_fuzzer, &op);
+            ++num_ops;
+        } else {
+            pci_fuzzer_count(pci_fuzzer->stats.num_skipped);
+        }
+    }
+
+    if (pci_fuzzer->scheduler != NULL) {
+        pci_fuzzer_reward(pci_fuzzer);
+    }
+
+    return num_ops;
 }
 
 void
@@ -142,6 +1119,75 @@ pci_fuzzer_log(pci_fuzzer_t *restrict pci_fuzzer, const char *restrict format, .
     va_end(ap);
 }
 
+void
+pci_fuzzer_pull(pci_fuzzer_t *restrict pci_fuzzer, uint64_t cycles)
+{
+    /* Counts the pull of the arm of the operation once it was performed, and
+       keeps it until the end of the iteration, when its events are known.
+       The pulls past the first PCI_FUZZER_MAX_PROGRAM of an iteration are
+       neither counted nor rewarded. */
+    if (pci_fuzzer->num_pulls < PCI_FUZZER_MAX_PROGRAM) {
+        bool is_outlier = scheduler_is_outlier(pci_fuzzer->scheduler, pci_fuzzer->arm, cycles);
+        scheduler_pull(pci_fuzzer->scheduler, pci_fuzzer->arm);
+        pci_fuzzer->pulls[pci_fuzzer->num_pulls++] = pci_fuzzer->arm | (is_outlier ? PULL_OUTLIER : 0);
+    }
+
+    pci_fuzzer->arm = SIZE_MAX;
+}
+
+void
+pci_fuzzer_reward(pci_fuzzer_t *restrict pci_fuzzer)
+{
+    /* Rewards the pulls of the iteration if its fingerprint is novel or it
+       set an error bit of the Status register (i.e., the closest thing to a
+       crash that does not take the fuzzer down with it), and each pull if
+       its latency was an outlier. */
+    pci_fuzzer->arm = SIZE_MAX;
+    if (pci_fuzzer->num_pulls == 0) {
+        return;
+    }
+
+    uint16_t status = pci_device_config_read16(pci_fuzzer->pci_device, PCI_STATUS);
+    pci_fuzzer->fingerprint = (pci_fuzzer->response ^ status) * FNV_PRIME;
+    pci_fuzzer->fingerprint_iteration = pci_fuzzer->iteration;
+    int events = 0;
+    if (scheduler_is_novel(pci_fuzzer->scheduler, pci_fuzzer->fingerprint)) {
+        events |= SCHEDULER_NOVEL;
+    }
+
+    /* The error bits stay set until they are cleared, so only the bits set
+       by the iteration count */
+    if ((status & ~pci_fuzzer->status & PCI_STATUS_ERRORS) != 0) {
+        events |= SCHEDULER_ERROR;
+    }
+
+    pci_fuzzer->status = status;
+    for (size_t i = 0; i < pci_fuzzer->num_pulls; ++i) {
+        uint32_t pull = pci_fuzzer->pulls[i];
+        int pull_events = events | (((pull & PULL_OUTLIER) != 0) ? SCHEDULER_OUTLIER : 0);
+        scheduler_reward(pci_fuzzer->scheduler, pull & ~PULL_OUTLIER, pull_events);
+        if (pull_events != 0) {
+            pci_fuzzer_count(pci_fuzzer->stats.num_rewarded);
+        }
+    }
+
+    pci_fuzzer->num_pulls = 0;
+}
+
+struct target *
+pci_fuzzer_select(pci_fuzzer_t *restrict pci_fuzzer)
+{
+    /* The scheduler selects the target (and the function) instead of the
+       input, and the input fields are decoded anyway, so the inputs decode
+       the same with either schedule. The pull is only counted once the
+       operation is performed (see pci_fuzzer_pull()), so an operation the
+       input ends before does not count against its arm. The function of the
+       arm is kept even if it is not a valid width of a profiled register, so
+       the rewards always go to the function that was performed. */
+    pci_fuzzer->arm = scheduler_select(pci_fuzzer->scheduler);
+    return &pci_fuzzer->targets[pci_fuzzer->arms[pci_fuzzer->arm].target];
+}
+
 pci_fuzzer_error_handler_t *
 pci_fuzzer_set_error_handler(pci_fuzzer_error_handler_t *handler)
 {
@@ -150,6 +1196,22 @@ pci_fuzzer_set_error_handler(pci_fuzzer_error_handler_t *handler)
     return previous_handler;
 }
 
+int
+pci_fuzzer_set_format(pci_fuzzer_t *restrict pci_fuzzer, int format)
+{
+    int previous_format = pci_fuzzer->format;
+    pci_fuzzer->format = format;
+    return previous_format;
+}
+
+latency_t *
+pci_fuzzer_set_latency(pci_fuzzer_t *restrict pci_fuzzer, latency_t *latency)
+{
+    latency_t *previous_latency = pci_fuzzer->latency;
+    pci_fuzzer->latency = latency;
+    return previous_latency;
+}
+
 pci_fuzzer_log_handler_t *
 pci_fuzzer_set_log_handler(pci_fuzzer_t *restrict pci_fuzzer, pci_fuzzer_log_handler_t *handler)
 {
@@ -165,3 +1227,75 @@ pci_fuzzer_set_log_stream(pci_fuzzer_t *restrict pci_fuzzer, FILE *stream)
     pci_fuzzer->log_stream = stream;
     return previous_stream;
 }
+
+profile_t *
+pci_fuzzer_set_profile(pci_fuzzer_t *restrict pci_fuzzer, profile_t *profile)
+{
+    profile_t *previous_profile = pci_fuzzer->profile;
+    pci_fuzzer->profile = profile;
+    for (size_t i = 0; i < pci_fuzzer->num_targets; ++i) {
+        struct target *target = &pci_fuzzer->targets[i];
+        target->profile = (profile != NULL) ? profile_get_region(profile, target->region) : NULL;
+    }
+
+    return previous_profile;
+}
+
+recorder_t *
+pci_fuzzer_set_recorder(pci_fuzzer_t *restrict pci_fuzzer, recorder_t *recorder)
+{
+    recorder_t *previous_recorder = pci_fuzzer->recorder;
+    pci_fuzzer->recorder = recorder;
+    return previous_recorder;
+}
+
+int
+pci_fuzzer_set_schedule(pci_fuzzer_t *restrict pci_fuzzer, int schedule)
+{
+    int previous_schedule = pci_fuzzer->schedule;
+    scheduler_destroy(pci_fuzzer->scheduler);
+    free(pci_fuzzer->pulls);
+    pci_fuzzer->scheduler = NULL;
+    pci_fuzzer->pulls = NULL;
+    pci_fuzzer->num_pulls = 0;
+    pci_fuzzer->arm = SIZE_MAX;
+    pci_fuzzer->schedule = schedule;
+    /* There is nothing to schedule if no region can be accessed */
+    if (schedule != PCI_FUZZER_SCHEDULE_UCB || pci_fuzzer->num_arms == 0) {
+        return previous_schedule;
+    }
+
+    pci_fuzzer->pulls = (uint32_t *)calloc(PCI_FUZZER_MAX_PROGRAM, sizeof(*pci_fuzzer->pulls));
+    if (pci_fuzzer->pulls == NULL) {
+        pci_fuzzer_error(pci_fuzzer, 0, errno, __func__);
+        return -1;
+    }
+
+    pci_fuzzer->scheduler = scheduler_create(pci_fuzzer->num_arms);
+    if (pci_fuzzer->scheduler == NULL) {
+        return -1;
+    }
+
+    /* Only the error bits set from now on count */
+    pci_fuzzer->status = pci_device_config_read16(pci_fuzzer->pci_device, PCI_STATUS);
+    return previous_schedule;
+}
+
+uint64_t
+pci_fuzzer_start(pci_fuzzer_t *restrict pci_fuzzer)
+{
+    /* Only the access itself is timed (i.e., not the logging and recording) */
+    return (pci_fuzzer->latency != NULL || pci_fuzzer->arm != SIZE_MAX) ? latency_start() : 0;
+}
+
+void
+pci_fuzzer_update(pci_fuzzer_t *restrict pci_fuzzer, size_t size)
+{
+    /* Hashes the values of a string or wide read a word at a time, padding
+       the last word with zeros. */
+    size_t num_words = (size + (sizeof(uint64_t) - 1)) / sizeof(uint64_t);
+    memset((uint8_t *)pci_fuzzer->string + size, 0, (num_words * sizeof(uint64_t)) - size);
+    for (size_t i = 0; i < num_words; ++i) {
+        pci_fuzzer->response = (pci_fuzzer->response ^ pci_fuzzer->string[i]) * FNV_PRIME;
+    }
+}
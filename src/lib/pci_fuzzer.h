@@ -7,21 +7,148 @@
 extern "C" {
 #endif
 
+#include "latency.h"
 #include "pci_device.h"
+#include "profile.h"
+#include "recorder.h"
 
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
-#define PCI_FUZZER_MAX_INPUT 28
+#define PCI_FUZZER_MAX_INPUT 32
+#define PCI_FUZZER_MAX_PROGRAM 1024
+#define PCI_FUZZER_MAX_REGIONS 6
+#define PCI_FUZZER_MAX_STRING 4096 /**< Maximum number of values of a string operation. */
+#define PCI_FUZZER_MAX_BURST 4096  /**< Maximum size, in bytes, of a burst operation. */
 
 typedef struct _pci_fuzzer pci_fuzzer_t; /**< PCI fuzzer. */
 
+/**
+ * PCI fuzzer functions.
+ *
+ * The values are in the order in which they are derived from the input. The
+ * string functions come after the original functions, and the memory functions
+ * (i.e., the functions only derived for memory regions, see
+ * PCI_FUZZER_NUM_IO_FUNCTIONS) come last, so the functions of the operations
+ * recorded before there were either are unchanged.
+ */
+enum pci_fuzzer_function {
+    PCI_FUZZER_READ16,         /**< pci_device_region_read16() */
+    PCI_FUZZER_READ32,         /**< pci_device_region_read32() */
+    PCI_FUZZER_READ8,          /**< pci_device_region_read8() */
+    PCI_FUZZER_WRITE16,        /**< pci_device_region_write16() */
+    PCI_FUZZER_WRITE32,        /**< pci_device_region_write32() */
+    PCI_FUZZER_WRITE8,         /**< pci_device_region_write8() */
+    PCI_FUZZER_READ_STRING16,  /**< pci_device_region_read_string16() */
+    PCI_FUZZER_READ_STRING32,  /**< pci_device_region_read_string32() */
+    PCI_FUZZER_READ_STRING8,   /**< pci_device_region_read_string8() */
+    PCI_FUZZER_WRITE_STRING16, /**< pci_device_region_write_string16() */
+    PCI_FUZZER_WRITE_STRING32, /**< pci_device_region_write_string32() */
+    PCI_FUZZER_WRITE_STRING8,  /**< pci_device_region_write_string8() */
+    PCI_FUZZER_READ128,        /**< pci_device_region_read128() */
+    PCI_FUZZER_READ256,        /**< pci_device_region_read256() */
+    PCI_FUZZER_READ64,         /**< pci_device_region_read64() */
+    PCI_FUZZER_READ_BURST,     /**< pci_device_region_read_burst() */
+    PCI_FUZZER_WRITE128,       /**< pci_device_region_write128() */
+    PCI_FUZZER_WRITE256,       /**< pci_device_region_write256() */
+    PCI_FUZZER_WRITE64,        /**< pci_device_region_write64() */
+    PCI_FUZZER_WRITE_BURST,    /**< pci_device_region_write_burst() */
+    PCI_FUZZER_NUM_FUNCTIONS   /**< Number of functions. */
+};
+
+/**
+ * Number of functions derived for I/O regions (i.e., the functions before the
+ * memory functions).
+ */
+#define PCI_FUZZER_NUM_IO_FUNCTIONS PCI_FUZZER_READ128
+
+/**
+ * PCI fuzzer input formats (i.e., how an iteration is decoded from the input).
+ *
+ * In the v1 format, the region, offset, and function of an operation are each
+ * derived from 8 bytes of input (i.e., scaled by a double precision floating
+ * point value), and its value, if any, is read as is (e.g., 4 bytes for a
+ * 32-bit write), so an operation takes 24 to 32 bytes. In the v2 format, the
+ * region and function are bit-packed fields of as many bits as their ranges
+ * need (see input_buffer_derive_packed_range()), the offset is a varint (see
+ * input_buffer_read_varint()) reduced modulo the size of the region, and the
+ * value is a bit-packed field of its width (32 bits for string, wide, and
+ * burst operations), so an operation takes 2 to 19 bytes (e.g., 6 bytes for a
+ * 32-bit write below offset 128), and the operations of a program share bytes.
+ *
+ * In either format, the offset of an operation on a profiled region (see
+ * pci_fuzzer_set_profile()) is a 32-bit field instead (the lower 32 bits of the
+ * 8-byte field in the v1 format).
+ */
+enum pci_fuzzer_format {
+    PCI_FUZZER_FORMAT_V1,  /**< Version 1 (i.e., 8-byte fields) */
+    PCI_FUZZER_FORMAT_V2,  /**< Version 2 (i.e., bit-packed fields and varint offsets) */
+    PCI_FUZZER_NUM_FORMATS /**< Number of formats. */
+};
+
+/**
+ * PCI fuzzer schedules (i.e., how the region and function of an operation are
+ * selected).
+ *
+ * With the ucb schedule, each function of each region is an arm of a
+ * multi-armed bandit (see scheduler_create()), and the region and function of
+ * each operation are the arm selected by the bandit instead of the input. The
+ * pulls of an iteration are rewarded if its fingerprint (see
+ * pci_fuzzer_get_fingerprint()) is novel, or if it sets an error bit of the
+ * Status register of the PCI device, and each pull is rewarded if its latency
+ * is an outlier. The input fields of the region and function are decoded
+ * anyway, so an input decodes the same offsets and values with either
+ * schedule.
+ */
+enum pci_fuzzer_schedule {
+    PCI_FUZZER_SCHEDULE_INPUT, /**< Selected by the input */
+    PCI_FUZZER_SCHEDULE_UCB,   /**< Selected by the multi-armed bandit (i.e., UCB1) */
+    PCI_FUZZER_NUM_SCHEDULES   /**< Number of schedules. */
+};
+
+/**
+ * PCI fuzzer operation (i.e., a single PCI device region access).
+ *
+ * The value of a string operation gives its number of values (i.e., the value
+ * modulo PCI_FUZZER_MAX_STRING, plus one), and seeds the values written. The
+ * value of a burst operation gives its size in bytes (i.e., the value modulo
+ * PCI_FUZZER_MAX_BURST, plus one), and seeds the bytes written. The value of a
+ * 128-bit or 256-bit write seeds the bytes written.
+ */
+typedef struct pci_fuzzer_op {
+    int function;   /**< Function (see pci_fuzzer_function). */
+    size_t region;  /**< Region number. */
+    size_t offset;  /**< Region offset. */
+    uint64_t value; /**< Value (for writes and string operations). */
+} pci_fuzzer_op_t;
+
+/**
+ * PCI fuzzer statistics.
+ *
+ * Each PCI fuzzer counts into statistics of its own, in cache lines of their
+ * own, so the counters of different threads never share a cache line.
+ */
+typedef struct pci_fuzzer_stats {
+    uint64_t num_iterations;                             /**< Number of iterations. */
+    uint64_t num_skipped;                                /**< Number of operations skipped (e.g., too wide). */
+    uint64_t num_rewarded;                               /**< Number of scheduled operations rewarded. */
+    uint64_t num_region_ops[PCI_FUZZER_MAX_REGIONS];     /**< Number of operations on each region. */
+    uint64_t num_function_ops[PCI_FUZZER_NUM_FUNCTIONS]; /**< Number of operations of each function. */
+} pci_fuzzer_stats_t;
+
 typedef void pci_fuzzer_error_handler_t(int status, int error, const char *restrict format, va_list ap);
 typedef void pci_fuzzer_log_handler_t(FILE *restrict stream, const char *restrict format, va_list ap);
 
 /**
  * Creates an PCI fuzzer.
  *
+ * The regions that cannot be accessed at all (e.g., unimplemented or unmapped
+ * memory regions) are pruned (i.e., the region of each operation is one of
+ * the other regions), unless there are no other regions.
+ *
  * @param [in] pci_device PCI device.
  * @param [in] regions List of PCI device regions.
  * @param [in] num_regions Number of PCI device regions.
@@ -36,14 +163,143 @@ pci_fuzzer_t *pci_fuzzer_create(pci_device_t *restrict pci_device, const int *re
  */
 void pci_fuzzer_destroy(pci_fuzzer_t *restrict pci_fuzzer);
 
+/**
+ * Performs an operation.
+ *
+ * @param [in] pci_fuzzer PCI fuzzer.
+ * @param [in] op Operation.
+ */
+void pci_fuzzer_execute(pci_fuzzer_t *restrict pci_fuzzer, const pci_fuzzer_op_t *restrict op);
+
+/**
+ * Returns whether the operations of the PCI fuzzer function have a value (see
+ * pci_fuzzer_op_t).
+ *
+ * @param [in] function Function (see pci_fuzzer_function).
+ * @return Returns true if the operations of the function have a value;
+ *   otherwise, returns false (e.g., if the function is invalid).
+ */
+bool pci_fuzzer_function_has_value(int function);
+
+/**
+ * Returns the fingerprint of the last iteration (i.e., its response
+ * fingerprint combined with the Status register of the PCI device, see
+ * pci_fuzzer_get_response()).
+ *
+ * This reads the configuration space of the PCI device (unless the ucb
+ * schedule already did at the end of the iteration, see pci_fuzzer_schedule).
+ *
+ * @param [in] pci_fuzzer PCI fuzzer.
+ * @return Fingerprint.
+ */
+uint64_t pci_fuzzer_get_fingerprint(pci_fuzzer_t *restrict pci_fuzzer);
+
+/**
+ * Returns the PCI fuzzer input format of the given name.
+ *
+ * @param [in] name Name (i.e., "v1" or "v2").
+ * @return Format (see pci_fuzzer_format), or -1 if there is no format of the
+ *   given name.
+ */
+int pci_fuzzer_get_format(const char *restrict name);
+
+/**
+ * Returns the name of the PCI fuzzer function (i.e., the name of the PCI device
+ * function it calls).
+ *
+ * @param [in] function Function (see pci_fuzzer_function).
+ * @return Name, or NULL if the function is invalid.
+ */
+const char *pci_fuzzer_get_function_name(int function);
+
+/**
+ * Returns the heartbeat of the PCI fuzzer (i.e., a counter incremented before
+ * and after each operation, so it is odd while an operation is in progress).
+ *
+ * This can be called from any thread (e.g., a watchdog thread), and makes no
+ * system calls. If the heartbeat is odd and has not changed for a while, the
+ * operation in progress is stalled, and the operation is valid.
+ *
+ * @param [in] pci_fuzzer PCI fuzzer.
+ * @param [out] op Operation in progress (unchanged if there is none), or NULL.
+ * @return Heartbeat.
+ */
+uint64_t pci_fuzzer_get_heartbeat(pci_fuzzer_t *restrict pci_fuzzer, pci_fuzzer_op_t *restrict op);
+
+/**
+ * Returns the response fingerprint of the last iteration (i.e., a hash of the
+ * sequence of values read from the PCI device by its operations).
+ *
+ * Inputs with the same fingerprint most likely drove the PCI device through
+ * the same states, so the fingerprint is a cheap substitute for coverage
+ * feedback when the PCI device model cannot be instrumented.
+ *
+ * @param [in] pci_fuzzer PCI fuzzer.
+ * @return Response fingerprint.
+ */
+uint64_t pci_fuzzer_get_response(pci_fuzzer_t *restrict pci_fuzzer);
+
+/**
+ * Returns the PCI fuzzer schedule of the given name.
+ *
+ * @param [in] name Name (i.e., "input" or "ucb").
+ * @return Schedule (see pci_fuzzer_schedule), or -1 if there is no schedule of
+ *   the given name.
+ */
+int pci_fuzzer_get_schedule(const char *restrict name);
+
+/**
+ * Returns a snapshot of the statistics of the PCI fuzzer.
+ *
+ * This can be called from any thread (e.g., a status thread), and takes no
+ * locks. The counters are read one at a time, so they can be slightly
+ * inconsistent with each other.
+ *
+ * @param [in] pci_fuzzer PCI fuzzer.
+ * @param [out] stats Statistics.
+ */
+void pci_fuzzer_get_stats(pci_fuzzer_t *restrict pci_fuzzer, pci_fuzzer_stats_t *restrict stats);
+
 /**
  * Performs an iteration.
  *
+ * In the v2 format (see pci_fuzzer_format), the iteration is decoded from (at
+ * most PCI_FUZZER_MAX_INPUT bytes) read from the stream at once.
+ *
  * @param [in] pci_fuzzer PCI fuzzer.
  * @param [in] stream Input stream.
  */
 void pci_fuzzer_iterate(pci_fuzzer_t *restrict pci_fuzzer, FILE *restrict stream);
 
+/**
+ * Performs an iteration from an input buffer.
+ *
+ * This is equivalent to pci_fuzzer_iterate() with a stream over the buffer,
+ * but without the stream setup, teardown, and locking overhead.
+ *
+ * @param [in] pci_fuzzer PCI fuzzer.
+ * @param [in] buf Input buffer.
+ * @param [in] size Input buffer size.
+ * @return Number of bytes of the input buffer decoded (i.e., the rest of the
+ *   input buffer did not affect the iteration).
+ */
+size_t pci_fuzzer_iterate_buf(pci_fuzzer_t *restrict pci_fuzzer, const void *buf, size_t size);
+
+/**
+ * Performs a program (i.e., a sequence of iterations) from an input buffer.
+ *
+ * The input buffer is decoded as consecutive iterations (see
+ * pci_fuzzer_iterate_buf()), and the decoded operations are performed
+ * back-to-back until the input buffer is exhausted. An incomplete iteration at
+ * the end of the input buffer is ignored.
+ *
+ * @param [in] pci_fuzzer PCI fuzzer.
+ * @param [in] buf Input buffer.
+ * @param [in] size Input buffer size.
+ * @return Number of operations performed.
+ */
+size_t pci_fuzzer_iterate_program(pci_fuzzer_t *restrict pci_fuzzer, const void *buf, size_t size);
+
 /**
  * Sets the error handler for the PCI fuzzer.
  *
@@ -52,6 +308,29 @@ void pci_fuzzer_iterate(pci_fuzzer_t *restrict pci_fuzzer, FILE *restrict stream
  */
 pci_fuzzer_error_handler_t *pci_fuzzer_set_error_handler(pci_fuzzer_error_handler_t *handler);
 
+/**
+ * Sets the input format of the PCI fuzzer. (The default is
+ * PCI_FUZZER_FORMAT_V1.)
+ *
+ * @param [in] pci_fuzzer PCI fuzzer.
+ * @param [in] format Format (see pci_fuzzer_format).
+ * @return Previous format.
+ */
+int pci_fuzzer_set_format(pci_fuzzer_t *restrict pci_fuzzer, int format);
+
+/**
+ * Sets the latency histograms for the PCI fuzzer.
+ *
+ * The latency of every access (i.e., without logging and recording) is
+ * measured with the time stamp counter, and recorded in the latency
+ * histograms.
+ *
+ * @param [in] pci_fuzzer PCI fuzzer.
+ * @param [in] latency Latency histograms, or NULL.
+ * @return Previous latency histograms.
+ */
+latency_t *pci_fuzzer_set_latency(pci_fuzzer_t *restrict pci_fuzzer, latency_t *latency);
+
 /**
  * Sets the log handler for the PCI fuzzer.
  *
@@ -69,6 +348,46 @@ pci_fuzzer_log_handler_t *pci_fuzzer_set_log_handler(
  */
 FILE *pci_fuzzer_set_log_stream(pci_fuzzer_t *restrict pci_fuzzer, FILE *stream);
 
+/**
+ * Sets the register map profile for the PCI fuzzer.
+ *
+ * The offset of each operation on a region the profile has entries for is a
+ * register sampled from the profile (see profile_region_sample()) instead of
+ * any offset of the region, and the function of each read, write, and string
+ * operation is replaced with the function of the widest valid access width of
+ * the register, unless its width is valid. The profile is not copied, and can
+ * be shared by several PCI fuzzers.
+ *
+ * @param [in] pci_fuzzer PCI fuzzer.
+ * @param [in] profile Register map profile, or NULL.
+ * @return Previous register map profile.
+ */
+profile_t *pci_fuzzer_set_profile(pci_fuzzer_t *restrict pci_fuzzer, profile_t *profile);
+
+/**
+ * Sets the flight recorder for the PCI fuzzer.
+ *
+ * Every operation is appended to the flight recorder before it is performed.
+ *
+ * @param [in] pci_fuzzer PCI fuzzer.
+ * @param [in] recorder Flight recorder.
+ * @return Previous flight recorder.
+ */
+recorder_t *pci_fuzzer_set_recorder(pci_fuzzer_t *restrict pci_fuzzer, recorder_t *recorder);
+
+/**
+ * Sets the schedule of the PCI fuzzer. (The default is
+ * PCI_FUZZER_SCHEDULE_INPUT.)
+ *
+ * Setting a schedule resets the statistics of the previous schedule (e.g., the
+ * rewards of the arms of the ucb schedule).
+ *
+ * @param [in] pci_fuzzer PCI fuzzer.
+ * @param [in] schedule Schedule (see pci_fuzzer_schedule).
+ * @return Previous schedule, or -1 if an error occurs.
+ */
+int pci_fuzzer_set_schedule(pci_fuzzer_t *restrict pci_fuzzer, int schedule);
+
 #ifdef __cplusplus
 }
 #endif
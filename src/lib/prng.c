@@ -0,0 +1,279 @@
+/** @file */
+
+#include "prng.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RANDOM_STATE_SIZE 128
+
+struct _prng {
+    int type;
+    union {
+        struct {
+            struct random_data data;
+            char state[RANDOM_STATE_SIZE];
+        } random;
+        uint64_t splitmix64;
+        uint64_t xoshiro256[4];
+    } state;
+};
+
+static prng_error_handler_t *error_handler = NULL;
+
+static const char *type_names[PRNG_NUM_TYPES] = {
+    [PRNG_RANDOM] = "random",
+    [PRNG_SPLITMIX64] = "splitmix64",
+    [PRNG_XOSHIRO256] = "xoshiro256",
+};
+
+void prng_error(prng_t *restrict prng, int status, int error, const char *restrict format, ...);
+
+static inline uint64_t
+rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t
+splitmix64_next(uint64_t *state)
+{
+    uint64_t z = (*state += UINT64_C(0x9e3779b97f4a7c15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t
+xoshiro256_next(uint64_t *state)
+{
+    uint64_t result = rotl(state[1] * 5, 7) * 9;
+    uint64_t t = state[1] << 17;
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotl(state[3], 45);
+    return result;
+}
+
+static void
+xoshiro256_jump(uint64_t *state)
+{
+    static const uint64_t jump[] = {UINT64_C(0x180ec6d33cfd0aba), UINT64_C(0xd5a61266f0c9392c),
+            UINT64_C(0xa9582618e03fc9aa), UINT64_C(0x39abdc4529b1661c)};
+    uint64_t s[4] = {0};
+    for (size_t i = 0; i < (sizeof(jump) / sizeof(*jump)); ++i) {
+        for (int b = 0; b < 64; ++b) {
+            if (jump[i] & (UINT64_C(1) << b)) {
+                s[0] ^= state[0];
+                s[1] ^= state[1];
+                s[2] ^= state[2];
+                s[3] ^= state[3];
+            }
+
+            xoshiro256_next(state);
+        }
+    }
+
+    memcpy(state, s, sizeof(s));
+}
+
+prng_t *
+prng_create(int type, uint64_t seed)
+{
+    prng_t *prng = (prng_t *)calloc(1, sizeof(*prng));
+    if (prng == NULL) {
+        prng_error(prng, 0, errno, __func__);
+        return NULL;
+    }
+
+    prng->type = type;
+    switch (prng->type) {
+    case PRNG_RANDOM:
+        /* The default state of random() is 128 bytes, so this produces the
+           same sequence as srandom() and random(). */
+        if (initstate_r(seed, prng->state.random.state, sizeof(prng->state.random.state), &prng->state.random.data)
+                == -1) {
+            prng_error(prng, 0, errno, __func__);
+            goto err;
+        }
+
+        break;
+
+    case PRNG_SPLITMIX64:
+        prng->state.splitmix64 = seed;
+        break;
+
+    case PRNG_XOSHIRO256:
+        /* Seed the state with the output of SplitMix64, as recommended by the
+           authors, so that it is never all zeros. */
+        for (size_t i = 0; i < 4; ++i) {
+            prng->state.xoshiro256[i] = splitmix64_next(&seed);
+        }
+
+        break;
+
+    default:
+        errno = EINVAL;
+        prng_error(prng, 0, errno, __func__);
+        goto err;
+    }
+
+    return prng;
+
+err:
+    prng_destroy(prng);
+    return NULL;
+}
+
+void
+prng_destroy(prng_t *restrict prng)
+{
+    if (prng == NULL) {
+        return;
+    }
+
+    free(prng);
+}
+
+void
+prng_error(prng_t *restrict prng, int status, int error, const char *restrict format, ...)
+{
+    if (error_handler == NULL) {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, format);
+    (*error_handler)(status, error, format, ap);
+    va_end(ap);
+}
+
+void
+prng_fill(prng_t *restrict prng, void *buf, size_t size)
+{
+    uint8_t *bytes = (uint8_t *)buf;
+    switch (prng->type) {
+    case PRNG_RANDOM: {
+        /* Use the 16 least significant bits of each value, as random() only
+           returns 31 bits. */
+        int32_t number = 0;
+        for (size_t i = 0; i < size; ++i) {
+            if ((i % sizeof(uint16_t)) == 0) {
+                random_r(&prng->state.random.data, &number);
+            }
+
+            bytes[i] = (number >> (8 * (i % sizeof(uint16_t)))) & 0xff;
+        }
+
+        break;
+    }
+
+    case PRNG_SPLITMIX64: {
+        uint64_t state = prng->state.splitmix64;
+        for (; size >= (4 * sizeof(uint64_t)); size -= (4 * sizeof(uint64_t)), bytes += (4 * sizeof(uint64_t))) {
+            uint64_t values[4] = {
+                    splitmix64_next(&state), splitmix64_next(&state), splitmix64_next(&state), splitmix64_next(&state)};
+            memcpy(bytes, values, sizeof(values));
+        }
+
+        for (; size > 0; size -= (size < sizeof(uint64_t)) ? size : sizeof(uint64_t), bytes += sizeof(uint64_t)) {
+            uint64_t value = splitmix64_next(&state);
+            memcpy(bytes, &value, (size < sizeof(value)) ? size : sizeof(value));
+        }
+
+        prng->state.splitmix64 = state;
+        break;
+    }
+
+    case PRNG_XOSHIRO256: {
+        /* Keep the state in registers for the duration of the fill */
+        uint64_t state[4];
+        memcpy(state, prng->state.xoshiro256, sizeof(state));
+        for (; size >= (4 * sizeof(uint64_t)); size -= (4 * sizeof(uint64_t)), bytes += (4 * sizeof(uint64_t))) {
+            uint64_t values[4] = {
+                    xoshiro256_next(state), xoshiro256_next(state), xoshiro256_next(state), xoshiro256_next(state)};
+            memcpy(bytes, values, sizeof(values));
+        }
+
+        for (; size > 0; size -= (size < sizeof(uint64_t)) ? size : sizeof(uint64_t), bytes += sizeof(uint64_t)) {
+            uint64_t value = xoshiro256_next(state);
+            memcpy(bytes, &value, (size < sizeof(value)) ? size : sizeof(value));
+        }
+
+        memcpy(prng->state.xoshiro256, state, sizeof(state));
+        break;
+    }
+
+    default:
+        abort();
+    }
+}
+
+int
+prng_get_type(const char *restrict name)
+{
+    for (int i = 0; i < PRNG_NUM_TYPES; ++i) {
+        if (strcmp(name, type_names[i]) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+uint64_t
+prng_next(prng_t *restrict prng)
+{
+    switch (prng->type) {
+    case PRNG_RANDOM: {
+        int32_t numbers[3];
+        for (size_t i = 0; i < 3; ++i) {
+            random_r(&prng->state.random.data, &numbers[i]);
+        }
+
+        return ((uint64_t)numbers[0] << 33) ^ ((uint64_t)numbers[1] << 2) ^ (uint64_t)numbers[2];
+    }
+
+    case PRNG_SPLITMIX64:
+        return splitmix64_next(&prng->state.splitmix64);
+
+    case PRNG_XOSHIRO256:
+        return xoshiro256_next(prng->state.xoshiro256);
+
+    default:
+        abort();
+    }
+}
+
+prng_t *
+prng_split(prng_t *restrict prng)
+{
+    if (prng->type == PRNG_XOSHIRO256) {
+        prng_t *new_prng = (prng_t *)malloc(sizeof(*new_prng));
+        if (new_prng == NULL) {
+            prng_error(prng, 0, errno, __func__);
+            return NULL;
+        }
+
+        memcpy(new_prng, prng, sizeof(*new_prng));
+        xoshiro256_jump(prng->state.xoshiro256);
+        return new_prng;
+    }
+
+    /* Seed the new stream from the current stream */
+    return prng_create(prng->type, prng_next(prng));
+}
+
+prng_error_handler_t *
+prng_set_error_handler(prng_error_handler_t *handler)
+{
+    prng_error_handler_t *previous_handler = error_handler;
+    error_handler = handler;
+    return previous_handler;
+}
@@ -0,0 +1,99 @@
+/** @file */
+
+#ifndef PRNG_H
+#define PRNG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Pseudorandom number generator engines.
+ */
+enum prng_type {
+    PRNG_RANDOM,     /**< random() (i.e., the nonlinear additive feedback generator of the C library) */
+    PRNG_SPLITMIX64, /**< SplitMix64 */
+    PRNG_XOSHIRO256, /**< xoshiro256** */
+    PRNG_NUM_TYPES   /**< Number of engines. */
+};
+
+typedef struct _prng prng_t; /**< Pseudorandom number generator. */
+
+typedef void prng_error_handler_t(int status, int error, const char *restrict format, va_list ap);
+
+/**
+ * Creates a pseudorandom number generator.
+ *
+ * The same engine and seed always produce the same sequence. The PRNG_RANDOM
+ * engine produces the same sequence as random() after srandom() with the same
+ * seed.
+ *
+ * @param [in] type Engine (see prng_type).
+ * @param [in] seed Seed.
+ * @return A pseudorandom number generator.
+ */
+prng_t *prng_create(int type, uint64_t seed);
+
+/**
+ * Destroys the pseudorandom number generator.
+ *
+ * @param [in] prng Pseudorandom number generator.
+ */
+void prng_destroy(prng_t *restrict prng);
+
+/**
+ * Fills the buffer with pseudorandom bytes.
+ *
+ * @param [in] prng Pseudorandom number generator.
+ * @param [out] buf Buffer.
+ * @param [in] size Buffer size.
+ */
+void prng_fill(prng_t *restrict prng, void *buf, size_t size);
+
+/**
+ * Returns the engine of the given name.
+ *
+ * @param [in] name Name (i.e., "random", "splitmix64", or "xoshiro256").
+ * @return Engine (see prng_type), or -1 if there is no engine of the given
+ *   name.
+ */
+int prng_get_type(const char *restrict name);
+
+/**
+ * Returns the next 64-bit pseudorandom value.
+ *
+ * @param [in] prng Pseudorandom number generator.
+ * @return 64-bit pseudorandom value.
+ */
+uint64_t prng_next(prng_t *restrict prng);
+
+/**
+ * Splits the pseudorandom number generator into a new, independent stream.
+ *
+ * Splitting is deterministic, so the streams of a given seed are always the
+ * same. For the PRNG_XOSHIRO256 engine, the new stream continues where the
+ * pseudorandom number generator was, and the pseudorandom number generator
+ * jumps 2^128 values ahead, so the streams never overlap.
+ *
+ * @param [in] prng Pseudorandom number generator.
+ * @return A pseudorandom number generator.
+ */
+prng_t *prng_split(prng_t *restrict prng);
+
+/**
+ * Sets the error handler for the pseudorandom number generator.
+ *
+ * @param [in] handler Error handler.
+ * @return Previous error handler.
+ */
+prng_error_handler_t *prng_set_error_handler(prng_error_handler_t *handler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PRNG_H */
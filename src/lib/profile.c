@@ -0,0 +1,382 @@
+/** @file */
+
+#include "profile.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROFILE_WIDTHS (1 | 2 | 4 | 8)
+
+struct _profile_region {
+    profile_entry_t *entries;
+    /* Alias table (i.e., column i is entry i if the upper 16 bits of the
+       input are below its threshold, and its alias otherwise) */
+    struct column {
+        uint32_t threshold;
+        uint32_t alias;
+    } *columns;
+    size_t num_entries;
+};
+
+struct _profile {
+    struct _profile_region regions[PROFILE_MAX_REGIONS];
+};
+
+static profile_error_handler_t *error_handler = NULL;
+
+/* ATA/IDE controller (see pci_device_is_ata_controller()). The data register
+   (i.e., PIO data transfers) and the Status/Command register are weighted the
+   most, as they drive the command state machine. */
+static const profile_entry_t ata_entries[] = {
+    /* Command block registers (i.e., BAR0 and BAR2) */
+    {.region = 0, .offset = 0x00, .widths = 2 | 4, .weight = 16}, /* Data */
+    {.region = 0, .offset = 0x01, .widths = 1, .weight = 4},      /* Error/Features */
+    {.region = 0, .offset = 0x02, .widths = 1, .weight = 4},      /* Sector Count */
+    {.region = 0, .offset = 0x03, .widths = 1, .weight = 4},      /* LBA Low */
+    {.region = 0, .offset = 0x04, .widths = 1, .weight = 4},      /* LBA Mid */
+    {.region = 0, .offset = 0x05, .widths = 1, .weight = 4},      /* LBA High */
+    {.region = 0, .offset = 0x06, .widths = 1, .weight = 8},      /* Device */
+    {.region = 0, .offset = 0x07, .widths = 1, .weight = 16},     /* Status/Command */
+    {.region = 2, .offset = 0x00, .widths = 2 | 4, .weight = 16},
+    {.region = 2, .offset = 0x01, .widths = 1, .weight = 4},
+    {.region = 2, .offset = 0x02, .widths = 1, .weight = 4},
+    {.region = 2, .offset = 0x03, .widths = 1, .weight = 4},
+    {.region = 2, .offset = 0x04, .widths = 1, .weight = 4},
+    {.region = 2, .offset = 0x05, .widths = 1, .weight = 4},
+    {.region = 2, .offset = 0x06, .widths = 1, .weight = 8},
+    {.region = 2, .offset = 0x07, .widths = 1, .weight = 16},
+    /* Control block registers (i.e., BAR1 and BAR3) */
+    {.region = 1, .offset = 0x02, .widths = 1, .weight = 1}, /* Alternate Status/Device Control */
+    {.region = 3, .offset = 0x02, .widths = 1, .weight = 1},
+    /* Bus master IDE registers (i.e., BAR4) */
+    {.region = 4, .offset = 0x00, .widths = 1, .weight = 8}, /* Bus Master IDE Command */
+    {.region = 4, .offset = 0x02, .widths = 1, .weight = 8}, /* Bus Master IDE Status */
+    {.region = 4, .offset = 0x04, .widths = 4, .weight = 4}, /* Descriptor Table Pointer */
+    {.region = 4, .offset = 0x08, .widths = 1, .weight = 8},
+    {.region = 4, .offset = 0x0a, .widths = 1, .weight = 8},
+    {.region = 4, .offset = 0x0c, .widths = 4, .weight = 4},
+};
+
+static const struct builtin {
+    const char *name;
+    const profile_entry_t *entries;
+    size_t num_entries;
+} builtins[] = {
+    {"ata", ata_entries, sizeof(ata_entries) / sizeof(ata_entries[0])},
+};
+
+int profile_build(struct _profile_region *restrict region);
+void profile_error(profile_t *restrict profile, int status, int error, const char *restrict format, ...);
+profile_t *profile_load(const char *restrict path);
+int profile_parse_line(char *line, profile_entry_t *restrict entry);
+
+int
+profile_build(struct _profile_region *restrict region)
+{
+    /* Builds the alias table with Vose's method, in integer arithmetic (i.e.,
+       each weight is scaled by the number of entries, so a column holds a
+       total weight of exactly the sum of the weights). */
+    size_t num_entries = region->num_entries;
+    uint64_t *scaled = (uint64_t *)calloc(num_entries, sizeof(*scaled));
+    uint32_t *small = (uint32_t *)calloc(num_entries, sizeof(*small));
+    uint32_t *large = (uint32_t *)calloc(num_entries, sizeof(*large));
+    if (scaled == NULL || small == NULL || large == NULL) {
+        free(scaled);
+        free(small);
+        free(large);
+        return -1;
+    }
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < num_entries; ++i) {
+        total += region->entries[i].weight;
+    }
+
+    size_t num_small = 0;
+    size_t num_large = 0;
+    for (size_t i = 0; i < num_entries; ++i) {
+        scaled[i] = (uint64_t)region->entries[i].weight * num_entries;
+        if (scaled[i] < total) {
+            small[num_small++] = i;
+        } else {
+            large[num_large++] = i;
+        }
+    }
+
+    while (num_small != 0 && num_large != 0) {
+        uint32_t s = small[--num_small];
+        uint32_t l = large[num_large - 1];
+        /* The total is at most 2^48, so the shift cannot overflow */
+        region->columns[s].threshold = (scaled[s] << 16) / total;
+        region->columns[s].alias = l;
+        scaled[l] -= total - scaled[s];
+        if (scaled[l] < total) {
+            --num_large;
+            small[num_small++] = l;
+        }
+    }
+
+    /* The columns left are full */
+    while (num_large != 0) {
+        uint32_t l = large[--num_large];
+        region->columns[l].threshold = UINT32_C(1) << 16;
+        region->columns[l].alias = l;
+    }
+
+    while (num_small != 0) {
+        uint32_t s = small[--num_small];
+        region->columns[s].threshold = UINT32_C(1) << 16;
+        region->columns[s].alias = s;
+    }
+
+    free(scaled);
+    free(small);
+    free(large);
+    return 0;
+}
+
+profile_t *
+profile_create(const profile_entry_t *entries, size_t num_entries)
+{
+    profile_t *profile = (profile_t *)calloc(1, sizeof(*profile));
+    if (profile == NULL) {
+        profile_error(profile, 0, errno, __func__);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < num_entries; ++i) {
+        const profile_entry_t *entry = &entries[i];
+        if (entry->region >= PROFILE_MAX_REGIONS || entry->widths == 0 || (entry->widths & ~PROFILE_WIDTHS) != 0
+                || entry->weight == 0 || profile->regions[entry->region].num_entries == PROFILE_MAX_ENTRIES) {
+            errno = EINVAL;
+            profile_error(profile, 0, errno, __func__);
+            goto err;
+        }
+
+        ++profile->regions[entry->region].num_entries;
+    }
+
+    for (size_t i = 0; i < PROFILE_MAX_REGIONS; ++i) {
+        struct _profile_region *region = &profile->regions[i];
+        if (region->num_entries == 0) {
+            continue;
+        }
+
+        region->entries = (profile_entry_t *)calloc(region->num_entries, sizeof(*region->entries));
+        region->columns = (struct column *)calloc(region->num_entries, sizeof(*region->columns));
+        if (region->entries == NULL || region->columns == NULL) {
+            profile_error(profile, 0, errno, __func__);
+            goto err;
+        }
+
+        /* The entries of the region, in order */
+        size_t num_region_entries = 0;
+        for (size_t j = 0; j < num_entries; ++j) {
+            if (entries[j].region == i) {
+                region->entries[num_region_entries++] = entries[j];
+            }
+        }
+
+        if (profile_build(region) == -1) {
+            profile_error(profile, 0, errno, __func__);
+            goto err;
+        }
+    }
+
+    return profile;
+
+err:
+    profile_destroy(profile);
+    return NULL;
+}
+
+void
+profile_destroy(profile_t *restrict profile)
+{
+    if (profile == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < PROFILE_MAX_REGIONS; ++i) {
+        free(profile->regions[i].entries);
+        free(profile->regions[i].columns);
+    }
+
+    free(profile);
+}
+
+void
+profile_error(profile_t *restrict profile, int status, int error, const char *restrict format, ...)
+{
+    if (error_handler == NULL) {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, format);
+    (*error_handler)(status, error, format, ap);
+    va_end(ap);
+}
+
+const profile_region_t *
+profile_get_region(profile_t *restrict profile, size_t region)
+{
+    if (region >= PROFILE_MAX_REGIONS || profile->regions[region].num_entries == 0) {
+        return NULL;
+    }
+
+    return &profile->regions[region];
+}
+
+profile_t *
+profile_load(const char *restrict path)
+{
+    FILE *stream = fopen(path, "r");
+    if (stream == NULL) {
+        profile_error(NULL, 0, errno, __func__);
+        return NULL;
+    }
+
+    profile_entry_t *entries = NULL;
+    size_t num_entries = 0;
+    size_t capacity = 0;
+    char *line = NULL;
+    size_t line_size = 0;
+    size_t line_num = 0;
+    profile_t *profile = NULL;
+    while (getline(&line, &line_size, stream) != -1) {
+        ++line_num;
+        profile_entry_t entry;
+        int result = profile_parse_line(line, &entry);
+        if (result == -1) {
+            errno = EINVAL;
+            profile_error(NULL, 0, 0, "%s: Invalid profile line %zu.\n", __func__, line_num);
+            goto out;
+        }
+
+        if (result == 1) {
+            continue;
+        }
+
+        if (num_entries == capacity) {
+            capacity = (capacity != 0) ? (capacity * 2) : 64;
+            profile_entry_t *new_entries = (profile_entry_t *)realloc(entries, capacity * sizeof(*entries));
+            if (new_entries == NULL) {
+                profile_error(NULL, 0, errno, __func__);
+                goto out;
+            }
+
+            entries = new_entries;
+        }
+
+        entries[num_entries++] = entry;
+    }
+
+    if (ferror(stream)) {
+        profile_error(NULL, 0, errno, __func__);
+        goto out;
+    }
+
+    profile = profile_create(entries, num_entries);
+
+out:
+    free(line);
+    free(entries);
+    fclose(stream);
+    return profile;
+}
+
+profile_t *
+profile_open(const char *restrict name)
+{
+    for (size_t i = 0; i < (sizeof(builtins) / sizeof(builtins[0])); ++i) {
+        if (strcmp(name, builtins[i].name) == 0) {
+            return profile_create(builtins[i].entries, builtins[i].num_entries);
+        }
+    }
+
+    return profile_load(name);
+}
+
+int
+profile_parse_line(char *line, profile_entry_t *restrict entry)
+{
+    /* Returns 0 if an entry was parsed, 1 if the line is blank (or a
+       comment), or -1 if the line is invalid. */
+    char *comment = strchr(line, '#');
+    if (comment != NULL) {
+        *comment = '\0';
+    }
+
+    char *lasts = NULL;
+    char *fields[4];
+    size_t num_fields = 0;
+    for (char *token = strtok_r(line, " \t\r\n", &lasts); token != NULL; token = strtok_r(NULL, " \t\r\n", &lasts)) {
+        if (num_fields == 4) {
+            return -1;
+        }
+
+        fields[num_fields++] = token;
+    }
+
+    if (num_fields == 0) {
+        return 1;
+    }
+
+    if (num_fields != 4) {
+        return -1;
+    }
+
+    char *end = NULL;
+    errno = 0;
+    entry->region = strtoul(fields[0], &end, 0);
+    if (errno != 0 || *end != '\0') {
+        return -1;
+    }
+
+    entry->offset = strtoul(fields[1], &end, 0);
+    if (errno != 0 || *end != '\0') {
+        return -1;
+    }
+
+    entry->widths = 0;
+    for (char *width = strtok_r(fields[2], ",", &lasts); width != NULL; width = strtok_r(NULL, ",", &lasts)) {
+        unsigned long value = strtoul(width, &end, 0);
+        if (errno != 0 || *end != '\0' || value == 0 || (value & (value - 1)) != 0 || (value & ~PROFILE_WIDTHS) != 0) {
+            return -1;
+        }
+
+        entry->widths |= value;
+    }
+
+    unsigned long weight = strtoul(fields[3], &end, 0);
+    if (errno != 0 || *end != '\0' || weight == 0 || weight > UINT32_MAX) {
+        return -1;
+    }
+
+    entry->weight = weight;
+    return (entry->widths != 0) ? 0 : -1;
+}
+
+const profile_entry_t *
+profile_region_sample(const profile_region_t *restrict region, uint32_t input)
+{
+    /* A multiply and a shift select the column, and a comparison selects the
+       entry or its alias, so sampling takes constant time. */
+    size_t column = ((input & 0xffff) * region->num_entries) >> 16;
+    const struct column *c = &region->columns[column];
+    return &region->entries[((input >> 16) < c->threshold) ? column : c->alias];
+}
+
+profile_error_handler_t *
+profile_set_error_handler(profile_error_handler_t *handler)
+{
+    profile_error_handler_t *previous_handler = error_handler;
+    error_handler = handler;
+    return previous_handler;
+}
@@ -0,0 +1,105 @@
+/** @file */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PROFILE_MAX_ENTRIES 65536 /**< Maximum number of registers of each region. */
+#define PROFILE_MAX_REGIONS 6     /**< Maximum number of regions. */
+
+typedef struct _profile profile_t;               /**< Register map profile. */
+typedef struct _profile_region profile_region_t; /**< Register map of a region. */
+
+/**
+ * Register map profile entry (i.e., a register of a region).
+ */
+typedef struct profile_entry {
+    size_t region;       /**< Region number. */
+    size_t offset;       /**< Region offset. */
+    unsigned int widths; /**< Valid access widths (i.e., the bitwise OR of the widths, in bytes). */
+    uint32_t weight;     /**< Weight (i.e., how often the register is accessed relative to the others). */
+} profile_entry_t;
+
+typedef void profile_error_handler_t(int status, int error, const char *restrict format, va_list ap);
+
+/**
+ * Creates a register map profile from an array of entries.
+ *
+ * An alias table is built for the entries of each region, so an entry is
+ * sampled (see profile_region_sample()) in constant time no matter how many
+ * entries the region has.
+ *
+ * @param [in] entries Entries.
+ * @param [in] num_entries Number of entries.
+ * @return A register map profile, or NULL (and errno is set to EINVAL if an
+ *   entry is invalid) if an error occurs.
+ */
+profile_t *profile_create(const profile_entry_t *entries, size_t num_entries);
+
+/**
+ * Destroys the register map profile.
+ *
+ * @param [in] profile Register map profile.
+ */
+void profile_destroy(profile_t *restrict profile);
+
+/**
+ * Returns the register map of a region of the profile.
+ *
+ * @param [in] profile Register map profile.
+ * @param [in] region Region number.
+ * @return Register map, or NULL if the profile has no entries for the region
+ *   (i.e., its offsets are not profiled).
+ */
+const profile_region_t *profile_get_region(profile_t *restrict profile, size_t region);
+
+/**
+ * Opens a built-in register map profile, or a register map profile file.
+ *
+ * The built-in profiles are "ata" (i.e., the command and control blocks of an
+ * ATA/IDE controller, in native or compatibility mode, and its bus master IDE
+ * registers, see pci_device_is_ata_controller()). Any other name is a file
+ * name, and each line of the file is an entry (i.e., the region number,
+ * offset, valid access widths separated by commas, and weight, separated by
+ * whitespace, e.g., "0 0x07 1 16"). Blank lines and the characters from a "#"
+ * to the end of the line are ignored.
+ *
+ * @param [in] name Built-in profile name or file name.
+ * @return A register map profile, or NULL (and errno is set to EINVAL if a line
+ *   is invalid) if an error occurs.
+ */
+profile_t *profile_open(const char *restrict name);
+
+/**
+ * Samples an entry of a register map (i.e., an entry is returned with a
+ * probability proportional to its weight).
+ *
+ * @param [in] region Register map.
+ * @param [in] input Uniformly distributed input (i.e., the lower 16 bits
+ *   select a column of the alias table, and the upper 16 bits select either
+ *   its entry or its alias).
+ * @return Entry.
+ */
+const profile_entry_t *profile_region_sample(const profile_region_t *restrict region, uint32_t input);
+
+/**
+ * Sets the error handler for the register map profile.
+ *
+ * @param [in] handler Error handler.
+ * @return Previous error handler.
+ */
+profile_error_handler_t *profile_set_error_handler(profile_error_handler_t *handler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROFILE_H */
@@ -0,0 +1,241 @@
+/** @file */
+
+#include "recorder.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct _recorder {
+    recorder_header_t *header;
+    recorder_record_t *records;
+    size_t size;
+};
+
+static recorder_error_handler_t *error_handler = NULL;
+
+void recorder_error(recorder_t *restrict recorder, int status, int error, const char *restrict format, ...);
+int recorder_map(recorder_t *restrict recorder, int fd, int prot);
+
+void
+recorder_append(recorder_t *restrict recorder, uint64_t iteration, size_t region, int function, size_t offset,
+        uint64_t value)
+{
+    uint64_t sequence = recorder->header->head;
+    recorder_record_t *record = &recorder->records[sequence % recorder->header->num_records];
+    /* Invalidate the (oldest) record being overwritten before writing any
+       other field, so that a torn record is never decoded. */
+    record->sequence = sequence;
+    __atomic_signal_fence(__ATOMIC_RELEASE);
+    record->iteration = iteration;
+    record->offset = offset;
+    record->value = value;
+    record->region = region;
+    record->function = function;
+    /* Publish the record */
+    __atomic_store_n(&recorder->header->head, sequence + 1, __ATOMIC_RELEASE);
+}
+
+recorder_t *
+recorder_create(const char *restrict path, size_t num_records)
+{
+    recorder_t *recorder = (recorder_t *)calloc(1, sizeof(*recorder));
+    if (recorder == NULL) {
+        recorder_error(recorder, 0, errno, __func__);
+        return NULL;
+    }
+
+    if (num_records == 0) {
+        errno = EINVAL;
+        recorder_error(recorder, 0, errno, __func__);
+        goto err;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        recorder_error(recorder, 0, errno, __func__);
+        goto err;
+    }
+
+    recorder->size = sizeof(*recorder->header) + (num_records * sizeof(*recorder->records));
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        recorder_error(recorder, 0, errno, __func__);
+        goto err;
+    }
+
+    /* Preallocate regular files. Other files (e.g., the resource file of a
+       shared memory BAR) are mapped as they are. */
+    if (S_ISREG(st.st_mode)) {
+        if (ftruncate(fd, 0) == -1 || ftruncate(fd, recorder->size) == -1) {
+            close(fd);
+            recorder_error(recorder, 0, errno, __func__);
+            goto err;
+        }
+    }
+
+    if (recorder_map(recorder, fd, PROT_READ | PROT_WRITE) == -1) {
+        close(fd);
+        recorder_error(recorder, 0, errno, __func__);
+        goto err;
+    }
+
+    close(fd);
+    recorder->header->magic = RECORDER_MAGIC;
+    recorder->header->version = RECORDER_VERSION;
+    recorder->header->record_size = sizeof(*recorder->records);
+    recorder->header->num_records = num_records;
+    recorder->header->head = 0;
+    return recorder;
+
+err:
+    recorder_destroy(recorder);
+    return NULL;
+}
+
+void
+recorder_destroy(recorder_t *restrict recorder)
+{
+    if (recorder == NULL) {
+        return;
+    }
+
+    if (recorder->header != NULL) {
+        munmap(recorder->header, recorder->size);
+    }
+
+    free(recorder);
+}
+
+void
+recorder_error(recorder_t *restrict recorder, int status, int error, const char *restrict format, ...)
+{
+    if (error_handler == NULL) {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, format);
+    (*error_handler)(status, error, format, ap);
+    va_end(ap);
+}
+
+size_t
+recorder_get_num_records(recorder_t *restrict recorder)
+{
+    uint64_t head = __atomic_load_n(&recorder->header->head, __ATOMIC_ACQUIRE);
+    return (head < recorder->header->num_records) ? head : recorder->header->num_records;
+}
+
+const recorder_record_t *
+recorder_get_record(recorder_t *restrict recorder, size_t index)
+{
+    uint64_t head = __atomic_load_n(&recorder->header->head, __ATOMIC_ACQUIRE);
+    uint64_t first = (head < recorder->header->num_records) ? 0 : (head - recorder->header->num_records);
+    uint64_t sequence = first + index;
+    if (sequence >= head) {
+        errno = EINVAL;
+        recorder_error(recorder, 0, errno, __func__);
+        return NULL;
+    }
+
+    const recorder_record_t *record = &recorder->records[sequence % recorder->header->num_records];
+    if (record->sequence != sequence) {
+        return NULL;
+    }
+
+    return record;
+}
+
+int
+recorder_map(recorder_t *restrict recorder, int fd, int prot)
+{
+    void *map = mmap(NULL, recorder->size, prot, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    recorder->header = (recorder_header_t *)map;
+    recorder->records = (recorder_record_t *)(recorder->header + 1);
+    return 0;
+}
+
+recorder_t *
+recorder_open(const char *restrict path)
+{
+    recorder_t *recorder = (recorder_t *)calloc(1, sizeof(*recorder));
+    if (recorder == NULL) {
+        recorder_error(recorder, 0, errno, __func__);
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        recorder_error(recorder, 0, errno, __func__);
+        goto err;
+    }
+
+    /* Read the header first to find the size of the ring buffer */
+    recorder_header_t header;
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+        close(fd);
+        recorder_error(recorder, 0, 0, "%s: Truncated file.\n", __func__);
+        goto err;
+    }
+
+    if (header.magic != RECORDER_MAGIC || header.version != RECORDER_VERSION
+            || header.record_size != sizeof(*recorder->records) || header.num_records == 0) {
+        close(fd);
+        recorder_error(recorder, 0, 0, "%s: Invalid file.\n", __func__);
+        goto err;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        recorder_error(recorder, 0, errno, __func__);
+        goto err;
+    }
+
+    /* The number of records is checked by division, as a crafted one would
+       wrap the size of the ring buffer */
+    size_t max_records = (SIZE_MAX - sizeof(header)) / sizeof(*recorder->records);
+    if (S_ISREG(st.st_mode)) {
+        max_records = ((size_t)st.st_size - sizeof(header)) / sizeof(*recorder->records);
+    }
+
+    if (header.num_records > max_records) {
+        close(fd);
+        recorder_error(recorder, 0, 0, "%s: Truncated file.\n", __func__);
+        goto err;
+    }
+
+    recorder->size = sizeof(header) + (header.num_records * sizeof(*recorder->records));
+    if (recorder_map(recorder, fd, PROT_READ) == -1) {
+        close(fd);
+        recorder_error(recorder, 0, errno, __func__);
+        goto err;
+    }
+
+    close(fd);
+    return recorder;
+
+err:
+    recorder_destroy(recorder);
+    return NULL;
+}
+
+recorder_error_handler_t *
+recorder_set_error_handler(recorder_error_handler_t *handler)
+{
+    recorder_error_handler_t *previous_handler = error_handler;
+    error_handler = handler;
+    return previous_handler;
+}
@@ -0,0 +1,127 @@
+/** @file */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RECORDER_MAGIC UINT64_C(0x4345525a46494350) /**< "PCIFZREC" */
+#define RECORDER_VERSION 1
+#define RECORDER_NUM_RECORDS 65536
+
+typedef struct _recorder recorder_t; /**< Flight recorder. */
+
+typedef void recorder_error_handler_t(int status, int error, const char *restrict format, va_list ap);
+
+/**
+ * Flight recorder file header.
+ *
+ * The header is followed by num_records records laid out as a ring buffer.
+ * All fields are in host byte order.
+ */
+typedef struct recorder_header {
+    uint64_t magic;       /**< Magic number (see RECORDER_MAGIC). */
+    uint32_t version;     /**< Version (see RECORDER_VERSION). */
+    uint32_t record_size; /**< Size of each record. */
+    uint64_t num_records; /**< Number of records in the ring buffer. */
+    uint64_t head;        /**< Number of records ever appended. */
+    uint64_t reserved[4];
+} recorder_header_t;
+
+/**
+ * Flight recorder record.
+ */
+typedef struct recorder_record {
+    uint64_t sequence;  /**< Sequence number (i.e., index since creation). */
+    uint64_t iteration; /**< Iteration counter. */
+    uint64_t offset;    /**< Region offset. */
+    uint64_t value;     /**< Value (for writes). */
+    uint8_t region;     /**< Region number. */
+    uint8_t function;   /**< Function (see pci_fuzzer_function). */
+    uint8_t reserved[6];
+} recorder_record_t;
+
+/**
+ * Creates a flight recorder.
+ *
+ * The file is created (or truncated) and mapped shared, so records are written
+ * with plain stores and no system calls. For the records to survive a guest
+ * kernel panic, the file must be backed by memory that outlives the guest
+ * kernel (e.g., a DAX file system, or the resource file of a shared memory
+ * BAR).
+ *
+ * @param [in] path File name.
+ * @param [in] num_records Number of records in the ring buffer.
+ * @return A flight recorder.
+ */
+recorder_t *recorder_create(const char *restrict path, size_t num_records);
+
+/**
+ * Opens an existing flight recorder file for reading.
+ *
+ * @param [in] path File name.
+ * @return A flight recorder.
+ */
+recorder_t *recorder_open(const char *restrict path);
+
+/**
+ * Destroys the flight recorder.
+ *
+ * @param [in] recorder Flight recorder.
+ */
+void recorder_destroy(recorder_t *restrict recorder);
+
+/**
+ * Appends a record to the flight recorder.
+ *
+ * The record is completely written before it is published, so the last
+ * record in the ring buffer is the operation in progress when the process or
+ * system stopped.
+ *
+ * @param [in] recorder Flight recorder.
+ * @param [in] iteration Iteration counter.
+ * @param [in] region Region number.
+ * @param [in] function Function (see pci_fuzzer_function).
+ * @param [in] offset Region offset.
+ * @param [in] value Value.
+ */
+void recorder_append(recorder_t *restrict recorder, uint64_t iteration, size_t region, int function, size_t offset,
+        uint64_t value);
+
+/**
+ * Returns the number of valid records in the flight recorder.
+ *
+ * @param [in] recorder Flight recorder.
+ * @return Number of valid records.
+ */
+size_t recorder_get_num_records(recorder_t *restrict recorder);
+
+/**
+ * Returns a record from the flight recorder, from the oldest to the newest.
+ *
+ * @param [in] recorder Flight recorder.
+ * @param [in] index Record index (in the range given by the interval
+ *   [0,recorder_get_num_records())).
+ * @return Record, or NULL if the record is invalid (e.g., torn).
+ */
+const recorder_record_t *recorder_get_record(recorder_t *restrict recorder, size_t index);
+
+/**
+ * Sets the error handler for the flight recorder.
+ *
+ * @param [in] handler Error handler.
+ * @return Previous error handler.
+ */
+recorder_error_handler_t *recorder_set_error_handler(recorder_error_handler_t *handler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RECORDER_H */
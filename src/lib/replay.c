@@ -0,0 +1,476 @@
+/** @file */
+
+#include "replay.h"
+
+#include "pci_fuzzer.h"
+#include "recorder.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct _replay {
+    replay_op_t *ops;
+    size_t num_ops;
+    size_t capacity;
+    void *map;
+    size_t size;
+};
+
+static replay_error_handler_t *error_handler = NULL;
+
+int replay_append(replay_t *restrict replay, const replay_op_t *restrict op);
+void replay_error(replay_t *restrict replay, int status, int error, const char *restrict format, ...);
+int replay_load_log(replay_t *restrict replay, int fd, size_t size);
+int replay_load_recorder(replay_t *restrict replay, const char *restrict path);
+int replay_map(replay_t *restrict replay, int fd, size_t size);
+int replay_parse_line(const char *p, const char *end, replay_op_t *restrict op);
+
+int
+replay_append(replay_t *restrict replay, const replay_op_t *restrict op)
+{
+    if (replay->num_ops == replay->capacity) {
+        size_t capacity = (replay->capacity != 0) ? (replay->capacity * 2) : 65536;
+        replay_op_t *ops = (replay_op_t *)realloc(replay->ops, capacity * sizeof(*ops));
+        if (ops == NULL) {
+            return -1;
+        }
+
+        replay->ops = ops;
+        replay->capacity = capacity;
+    }
+
+    replay->ops[replay->num_ops++] = *op;
+    return 0;
+}
+
+replay_t *
+replay_create(const replay_op_t *ops, size_t num_ops)
+{
+    replay_t *replay = (replay_t *)calloc(1, sizeof(*replay));
+    if (replay == NULL) {
+        replay_error(replay, 0, errno, __func__);
+        return NULL;
+    }
+
+    if (num_ops > 0) {
+        replay->ops = (replay_op_t *)malloc(num_ops * sizeof(*replay->ops));
+        if (replay->ops == NULL) {
+            replay_error(replay, 0, errno, __func__);
+            goto err;
+        }
+
+        memcpy(replay->ops, ops, num_ops * sizeof(*replay->ops));
+    }
+
+    replay->num_ops = num_ops;
+    replay->capacity = num_ops;
+    return replay;
+
+err:
+    replay_destroy(replay);
+    return NULL;
+}
+
+void
+replay_destroy(replay_t *restrict replay)
+{
+    if (replay == NULL) {
+        return;
+    }
+
+    if (replay->map != NULL) {
+        munmap(replay->map, replay->size);
+    } else {
+        free(replay->ops);
+    }
+
+    free(replay);
+}
+
+void
+replay_error(replay_t *restrict replay, int status, int error, const char *restrict format, ...)
+{
+    if (error_handler == NULL) {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, format);
+    (*error_handler)(status, error, format, ap);
+    va_end(ap);
+}
+
+size_t
+replay_get_num_ops(replay_t *restrict replay)
+{
+    return replay->num_ops;
+}
+
+const replay_op_t *
+replay_get_op(replay_t *restrict replay, size_t index)
+{
+    if (index >= replay->num_ops) {
+        errno = EINVAL;
+        replay_error(replay, 0, errno, __func__);
+        return NULL;
+    }
+
+    return &replay->ops[index];
+}
+
+int
+replay_load_log(replay_t *restrict replay, int fd, size_t size)
+{
+    if (size == 0) {
+        return 0;
+    }
+
+    /* Parse the log in place, without copying it line by line */
+    const char *buf = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (buf == MAP_FAILED) {
+        replay_error(replay, 0, errno, __func__);
+        return -1;
+    }
+
+    madvise((void *)buf, size, MADV_SEQUENTIAL);
+    const char *end = buf + size;
+    size_t line = 0;
+    for (const char *p = buf; p < end;) {
+        const char *eol = (const char *)memchr(p, '\n', end - p);
+        if (eol == NULL) {
+            eol = end;
+        }
+
+        ++line;
+        replay_op_t op;
+        switch (replay_parse_line(p, eol, &op)) {
+        case -1:
+            munmap((void *)buf, size);
+            replay_error(replay, 0, 0, "%s: Invalid log line %zu.\n", __func__, line);
+            return -1;
+
+        case 0:
+            if (replay_append(replay, &op) == -1) {
+                munmap((void *)buf, size);
+                replay_error(replay, 0, errno, __func__);
+                return -1;
+            }
+
+            break;
+        }
+
+        p = eol + 1;
+    }
+
+    munmap((void *)buf, size);
+    return 0;
+}
+
+int
+replay_load_recorder(replay_t *restrict replay, const char *restrict path)
+{
+    recorder_t *recorder = recorder_open(path);
+    if (recorder == NULL) {
+        return -1;
+    }
+
+    size_t num_records = recorder_get_num_records(recorder);
+    for (size_t i = 0; i < num_records; ++i) {
+        /* Torn records are skipped, as by pcifuzzer-decode */
+        const recorder_record_t *record = recorder_get_record(recorder, i);
+        if (record == NULL || pci_fuzzer_get_function_name(record->function) == NULL) {
+            continue;
+        }
+
+        replay_op_t op = {
+                .offset = record->offset,
+                .value = record->value,
+                .region = record->region,
+                .function = record->function,
+        };
+        if (replay_append(replay, &op) == -1) {
+            recorder_destroy(recorder);
+            replay_error(replay, 0, errno, __func__);
+            return -1;
+        }
+    }
+
+    recorder_destroy(recorder);
+    return 0;
+}
+
+int
+replay_map(replay_t *restrict replay, int fd, size_t size)
+{
+    replay_header_t header;
+    if (size < sizeof(header) || pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+        replay_error(replay, 0, 0, "%s: Truncated file.\n", __func__);
+        return -1;
+    }
+
+    if (header.version != REPLAY_VERSION || header.op_size != sizeof(replay_op_t)) {
+        replay_error(replay, 0, 0, "%s: Invalid file.\n", __func__);
+        return -1;
+    }
+
+    if (header.num_ops > ((size - sizeof(header)) / sizeof(replay_op_t))) {
+        replay_error(replay, 0, 0, "%s: Truncated file.\n", __func__);
+        return -1;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        replay_error(replay, 0, errno, __func__);
+        return -1;
+    }
+
+    /* Reject unknown functions (e.g., from a corrupted file) once, as the
+       operations are executed as they are */
+    const replay_op_t *ops = (const replay_op_t *)((replay_header_t *)map + 1);
+    for (uint64_t i = 0; i < header.num_ops; ++i) {
+        if (pci_fuzzer_get_function_name(ops[i].function) == NULL) {
+            munmap(map, size);
+            replay_error(replay, 0, 0, "%s: Invalid file.\n", __func__);
+            return -1;
+        }
+    }
+
+    replay->map = map;
+    replay->size = size;
+    replay->ops = (replay_op_t *)((replay_header_t *)map + 1);
+    replay->num_ops = header.num_ops;
+    return 0;
+}
+
+replay_t *
+replay_open(const char *restrict path)
+{
+    replay_t *replay = (replay_t *)calloc(1, sizeof(*replay));
+    if (replay == NULL) {
+        replay_error(replay, 0, errno, __func__);
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        replay_error(replay, 0, errno, __func__);
+        goto err;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        replay_error(replay, 0, errno, __func__);
+        goto err;
+    }
+
+    uint64_t magic = 0;
+    if (pread(fd, &magic, sizeof(magic), 0) != sizeof(magic)) {
+        magic = 0;
+    }
+
+    int result;
+    switch (magic) {
+    case REPLAY_MAGIC:
+        result = replay_map(replay, fd, st.st_size);
+        break;
+
+    case RECORDER_MAGIC:
+        result = replay_load_recorder(replay, path);
+        break;
+
+    default:
+        result = replay_load_log(replay, fd, st.st_size);
+        break;
+    }
+
+    close(fd);
+    if (result == -1) {
+        goto err;
+    }
+
+    return replay;
+
+err:
+    replay_destroy(replay);
+    return NULL;
+}
+
+int
+replay_parse_line(const char *p, const char *end, replay_op_t *restrict op)
+{
+    /* Returns 0 if an operation was parsed, 1 if the line has no function
+       field (e.g., it is empty), or -1 if the line is invalid. Only the flat
+       objects written by the log handler are parsed, so the parser scans for
+       the quoted keys instead of tokenizing the whole line. */
+    int function = -1;
+    uint64_t region = UINT64_MAX;
+    uint64_t offset = UINT64_MAX;
+    uint64_t value = 0;
+    while ((p = (const char *)memchr(p, '"', end - p)) != NULL) {
+        const char *key = ++p;
+        p = (const char *)memchr(p, '"', end - p);
+        if (p == NULL) {
+            return -1;
+        }
+
+        size_t key_length = p - key;
+        for (++p; p < end && (*p == ':' || *p == ' '); ++p) {
+        }
+
+        if (p < end && *p == '"') {
+            const char *string = ++p;
+            p = (const char *)memchr(p, '"', end - p);
+            if (p == NULL) {
+                return -1;
+            }
+
+            size_t string_length = p++ - string;
+            if (key_length == 8 && memcmp(key, "function", 8) == 0) {
+                for (function = 0; function < PCI_FUZZER_NUM_FUNCTIONS; ++function) {
+                    const char *name = pci_fuzzer_get_function_name(function);
+                    if (strlen(name) == string_length && memcmp(name, string, string_length) == 0) {
+                        break;
+                    }
+                }
+
+                if (function == PCI_FUZZER_NUM_FUNCTIONS) {
+                    return -1;
+                }
+            }
+
+            continue;
+        }
+
+        /* Other values (e.g., the time) are skipped */
+        uint64_t number = 0;
+        const char *digits = p;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+            if (number > ((UINT64_MAX - (*p - '0')) / 10)) {
+                return -1;
+            }
+
+            number = (number * 10) + (*p - '0');
+        }
+
+        if (p == digits) {
+            continue;
+        }
+
+        if (key_length == 6 && memcmp(key, "region", 6) == 0) {
+            region = number;
+        } else if (key_length == 6 && memcmp(key, "offset", 6) == 0) {
+            offset = number;
+        } else if (key_length == 5 && memcmp(key, "value", 5) == 0) {
+            value = number;
+        }
+    }
+
+    if (function == -1) {
+        return 1;
+    }
+
+    if (region > UINT8_MAX || offset == UINT64_MAX) {
+        return -1;
+    }
+
+    op->offset = offset;
+    op->value = value;
+    op->region = region;
+    op->function = function;
+    memset(op->reserved, 0, sizeof(op->reserved));
+    return 0;
+}
+
+size_t
+replay_run(replay_t *restrict replay, pci_fuzzer_t *restrict pci_fuzzer, uint64_t interval)
+{
+    if (interval == 0) {
+        for (size_t i = 0; i < replay->num_ops; ++i) {
+            const replay_op_t *replay_op = &replay->ops[i];
+            pci_fuzzer_op_t op = {
+                    .function = replay_op->function,
+                    .region = replay_op->region,
+                    .offset = replay_op->offset,
+                    .value = replay_op->value,
+            };
+            pci_fuzzer_execute(pci_fuzzer, &op);
+        }
+
+        return replay->num_ops;
+    }
+
+    /* Sleep until absolute deadlines, so that the time spent performing the
+       operations does not accumulate into drift. */
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    for (size_t i = 0; i < replay->num_ops; ++i) {
+        const replay_op_t *replay_op = &replay->ops[i];
+        pci_fuzzer_op_t op = {
+                .function = replay_op->function,
+                .region = replay_op->region,
+                .offset = replay_op->offset,
+                .value = replay_op->value,
+        };
+        pci_fuzzer_execute(pci_fuzzer, &op);
+        deadline.tv_sec += interval / 1000000000;
+        deadline.tv_nsec += interval % 1000000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            ++deadline.tv_sec;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+        }
+    }
+
+    return replay->num_ops;
+}
+
+int
+replay_save(replay_t *restrict replay, const char *restrict path)
+{
+    FILE *stream = fopen(path, "w");
+    if (stream == NULL) {
+        replay_error(replay, 0, errno, __func__);
+        return -1;
+    }
+
+    replay_header_t header = {
+            .magic = REPLAY_MAGIC,
+            .version = REPLAY_VERSION,
+            .op_size = sizeof(replay_op_t),
+            .num_ops = replay->num_ops,
+    };
+    if (fwrite(&header, sizeof(header), 1, stream) != 1
+            || fwrite(replay->ops, sizeof(*replay->ops), replay->num_ops, stream) != replay->num_ops) {
+        fclose(stream);
+        replay_error(replay, 0, errno, __func__);
+        return -1;
+    }
+
+    if (fclose(stream) == EOF) {
+        replay_error(replay, 0, errno, __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
+replay_error_handler_t *
+replay_set_error_handler(replay_error_handler_t *handler)
+{
+    replay_error_handler_t *previous_handler = error_handler;
+    error_handler = handler;
+    return previous_handler;
+}
@@ -0,0 +1,134 @@
+/** @file */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "pci_fuzzer.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REPLAY_MAGIC UINT64_C(0x4c50525a46494350) /**< "PCIFZRPL" */
+#define REPLAY_VERSION 2
+
+typedef struct _replay replay_t; /**< Replay. */
+
+typedef void replay_error_handler_t(int status, int error, const char *restrict format, va_list ap);
+
+/**
+ * Replay file header.
+ *
+ * The header is followed by num_ops operations. All fields are in host byte
+ * order.
+ */
+typedef struct replay_header {
+    uint64_t magic;   /**< Magic number (see REPLAY_MAGIC). */
+    uint32_t version; /**< Version (see REPLAY_VERSION). */
+    uint32_t op_size; /**< Size of each operation. */
+    uint64_t num_ops; /**< Number of operations. */
+    uint64_t reserved[5];
+} replay_header_t;
+
+/**
+ * Replay operation (i.e., the compact form of a PCI fuzzer operation, see
+ * pci_fuzzer_op_t).
+ */
+typedef struct replay_op {
+    uint64_t offset;  /**< Region offset. */
+    uint64_t value;   /**< Value (for writes). */
+    uint8_t region;   /**< Region number. */
+    uint8_t function; /**< Function (see pci_fuzzer_function). */
+    uint8_t reserved[6];
+} replay_op_t;
+
+/**
+ * Creates a replay from an array of operations.
+ *
+ * The operations are copied.
+ *
+ * @param [in] ops Operations.
+ * @param [in] num_ops Number of operations.
+ * @return A replay.
+ */
+replay_t *replay_create(const replay_op_t *ops, size_t num_ops);
+
+/**
+ * Destroys the replay.
+ *
+ * @param [in] replay Replay.
+ */
+void replay_destroy(replay_t *restrict replay);
+
+/**
+ * Returns the number of operations of the replay.
+ *
+ * @param [in] replay Replay.
+ * @return Number of operations.
+ */
+size_t replay_get_num_ops(replay_t *restrict replay);
+
+/**
+ * Returns an operation of the replay.
+ *
+ * @param [in] replay Replay.
+ * @param [in] index Operation index (in the range given by the interval
+ *   [0,replay_get_num_ops())).
+ * @return Operation.
+ */
+const replay_op_t *replay_get_op(replay_t *restrict replay, size_t index);
+
+/**
+ * Opens a log, flight recorder, or replay file, and compiles its operations
+ * into an array.
+ *
+ * The format is detected from the magic number: replay files (see
+ * replay_save()) are mapped and used as they are, the valid records of flight
+ * recorder files are copied from the oldest to the newest, and anything else
+ * is parsed as log lines (i.e., JSON objects with function, region, offset,
+ * and value fields, as written by the log handler or pcifuzzer-decode). Log
+ * lines without a function field are ignored.
+ *
+ * @param [in] path File name.
+ * @return A replay.
+ */
+replay_t *replay_open(const char *restrict path);
+
+/**
+ * Performs the operations of the replay, in order.
+ *
+ * @param [in] replay Replay.
+ * @param [in] pci_fuzzer PCI fuzzer.
+ * @param [in] interval Interval, in nanoseconds, between the start of
+ *   consecutive operations, or 0 to perform them back-to-back.
+ * @return Number of operations performed.
+ */
+size_t replay_run(replay_t *restrict replay, pci_fuzzer_t *restrict pci_fuzzer, uint64_t interval);
+
+/**
+ * Saves the operations of the replay to a replay file (i.e., the compact
+ * binary form of a log).
+ *
+ * @param [in] replay Replay.
+ * @param [in] path File name.
+ * @return 0 on success, or -1 on error.
+ */
+int replay_save(replay_t *restrict replay, const char *restrict path);
+
+/**
+ * Sets the error handler for the replay.
+ *
+ * @param [in] handler Error handler.
+ * @return Previous error handler.
+ */
+replay_error_handler_t *replay_set_error_handler(replay_error_handler_t *handler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REPLAY_H */
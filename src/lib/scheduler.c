@@ -0,0 +1,233 @@
+/** @file */
+
+#include "scheduler.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define SCHEDULER_LN2 0.6931471805599453
+
+struct arm {
+    uint64_t num_pulls;
+    uint64_t num_rewards;
+    uint64_t latency; /* Moving average of the latencies, times 16 */
+};
+
+struct _scheduler {
+    struct arm *arms;
+    size_t num_arms;
+    /* Upper confidence bounds (with the bound of a sentinel arm, below every
+       other bound, for the unused leaves of the tree) */
+    double *bounds;
+    /* Tournament tree of the arms (i.e., each node is the arm of the highest
+       bound of its children, and the leaves are the arms) */
+    uint32_t *tree;
+    size_t num_leaves;
+    uint64_t num_pulls;
+    uint64_t next_pulls;
+    double exploration;
+    uint64_t *fingerprints;
+};
+
+static scheduler_error_handler_t *error_handler = NULL;
+
+void scheduler_error(scheduler_t *restrict scheduler, int status, int error, const char *restrict format, ...);
+void scheduler_refresh(scheduler_t *restrict scheduler);
+double scheduler_sqrt(double value);
+void scheduler_update(scheduler_t *restrict scheduler, size_t arm);
+
+scheduler_t *
+scheduler_create(size_t num_arms)
+{
+    if (num_arms == 0 || num_arms >= UINT32_MAX) {
+        errno = EINVAL;
+        scheduler_error(NULL, 0, errno, __func__);
+        return NULL;
+    }
+
+    scheduler_t *scheduler = (scheduler_t *)calloc(1, sizeof(*scheduler));
+    if (scheduler == NULL) {
+        scheduler_error(scheduler, 0, errno, __func__);
+        return NULL;
+    }
+
+    scheduler->num_arms = num_arms;
+    scheduler->num_leaves = 1;
+    while (scheduler->num_leaves < num_arms) {
+        scheduler->num_leaves *= 2;
+    }
+
+    scheduler->arms = (struct arm *)calloc(num_arms, sizeof(*scheduler->arms));
+    scheduler->bounds = (double *)calloc(num_arms + 1, sizeof(*scheduler->bounds));
+    scheduler->tree = (uint32_t *)calloc(2 * scheduler->num_leaves, sizeof(*scheduler->tree));
+    scheduler->fingerprints = (uint64_t *)calloc(SCHEDULER_NUM_FINGERPRINTS / 64, sizeof(*scheduler->fingerprints));
+    if (scheduler->arms == NULL || scheduler->bounds == NULL || scheduler->tree == NULL
+            || scheduler->fingerprints == NULL) {
+        scheduler_error(scheduler, 0, errno, __func__);
+        goto err;
+    }
+
+    /* The arms never pulled have an infinite bound, so each arm is pulled
+       once (in order) before any is pulled twice. */
+    for (size_t i = 0; i < num_arms; ++i) {
+        scheduler->bounds[i] = __builtin_inf();
+    }
+
+    scheduler->bounds[num_arms] = -__builtin_inf();
+    scheduler->next_pulls = 2;
+    scheduler_refresh(scheduler);
+    return scheduler;
+
+err:
+    scheduler_destroy(scheduler);
+    return NULL;
+}
+
+void
+scheduler_destroy(scheduler_t *restrict scheduler)
+{
+    if (scheduler == NULL) {
+        return;
+    }
+
+    free(scheduler->arms);
+    free(scheduler->bounds);
+    free(scheduler->tree);
+    free(scheduler->fingerprints);
+    free(scheduler);
+}
+
+void
+scheduler_error(scheduler_t *restrict scheduler, int status, int error, const char *restrict format, ...)
+{
+    if (error_handler == NULL) {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, format);
+    (*error_handler)(status, error, format, ap);
+    va_end(ap);
+}
+
+bool
+scheduler_is_novel(scheduler_t *restrict scheduler, uint64_t fingerprint)
+{
+    /* The upper bits of the fingerprint (i.e., the best mixed bits of an FNV
+       hash) index the bitmap. */
+    uint64_t bit = fingerprint >> (64 - __builtin_ctz(SCHEDULER_NUM_FINGERPRINTS));
+    uint64_t mask = UINT64_C(1) << (bit % 64);
+    uint64_t *word = &scheduler->fingerprints[bit / 64];
+    if ((*word & mask) != 0) {
+        return false;
+    }
+
+    *word |= mask;
+    return true;
+}
+
+bool
+scheduler_is_outlier(scheduler_t *restrict scheduler, size_t arm, uint64_t cycles)
+{
+    /* The moving average is exponentially weighted (i.e., each latency weighs
+       1/16), starts at the first latency, and is kept times 16 so it is
+       updated without a division. */
+    struct arm *a = &scheduler->arms[arm];
+    if (a->latency == 0) {
+        a->latency = cycles * 16;
+    }
+
+    bool is_outlier = (a->num_pulls > 16) && ((cycles * 2) > a->latency);
+    a->latency += cycles - (a->latency >> 4);
+    return is_outlier;
+}
+
+void
+scheduler_pull(scheduler_t *restrict scheduler, size_t arm)
+{
+    ++scheduler->arms[arm].num_pulls;
+    if (++scheduler->num_pulls == scheduler->next_pulls) {
+        scheduler->next_pulls *= 2;
+        scheduler_refresh(scheduler);
+    } else {
+        scheduler_update(scheduler, arm);
+    }
+}
+
+void
+scheduler_refresh(scheduler_t *restrict scheduler)
+{
+    /* Recomputes the bounds of the arms pulled (with the exploration term of
+       the current number of pulls), and rebuilds the tree. */
+    scheduler->exploration = 2.0 * (63 - __builtin_clzll(scheduler->next_pulls / 2)) * SCHEDULER_LN2;
+    for (size_t i = 0; i < scheduler->num_arms; ++i) {
+        const struct arm *a = &scheduler->arms[i];
+        if (a->num_pulls != 0) {
+            scheduler->bounds[i] = ((double)a->num_rewards / a->num_pulls)
+                                   + scheduler_sqrt(scheduler->exploration / a->num_pulls);
+        }
+    }
+
+    for (size_t i = 0; i < scheduler->num_leaves; ++i) {
+        scheduler->tree[scheduler->num_leaves + i] = (i < scheduler->num_arms) ? i : scheduler->num_arms;
+    }
+
+    for (size_t i = scheduler->num_leaves - 1; i > 0; --i) {
+        uint32_t left = scheduler->tree[2 * i];
+        uint32_t right = scheduler->tree[(2 * i) + 1];
+        scheduler->tree[i] = (scheduler->bounds[left] >= scheduler->bounds[right]) ? left : right;
+    }
+}
+
+void
+scheduler_reward(scheduler_t *restrict scheduler, size_t arm, int events)
+{
+    if (events == 0) {
+        return;
+    }
+
+    ++scheduler->arms[arm].num_rewards;
+    scheduler_update(scheduler, arm);
+}
+
+size_t
+scheduler_select(scheduler_t *restrict scheduler)
+{
+    return scheduler->tree[1];
+}
+
+scheduler_error_handler_t *
+scheduler_set_error_handler(scheduler_error_handler_t *handler)
+{
+    scheduler_error_handler_t *previous_handler = error_handler;
+    error_handler = handler;
+    return previous_handler;
+}
+
+double
+scheduler_sqrt(double value)
+{
+    /* A single instruction, without the error handling of sqrt() (i.e., the
+       value is never negative), and without libm. */
+    double result;
+    asm("sqrtsd %1, %0" : "=x"(result) : "x"(value));
+    return result;
+}
+
+void
+scheduler_update(scheduler_t *restrict scheduler, size_t arm)
+{
+    /* Recomputes the bound of the arm, and replays its matches up the tree */
+    const struct arm *a = &scheduler->arms[arm];
+    double *bounds = scheduler->bounds;
+    bounds[arm] = ((double)a->num_rewards / a->num_pulls) + scheduler_sqrt(scheduler->exploration / a->num_pulls);
+    uint32_t *tree = scheduler->tree;
+    for (size_t i = (scheduler->num_leaves + arm) / 2; i > 0; i /= 2) {
+        uint32_t left = tree[2 * i];
+        uint32_t right = tree[(2 * i) + 1];
+        tree[i] = (bounds[left] >= bounds[right]) ? left : right;
+    }
+}
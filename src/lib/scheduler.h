@@ -0,0 +1,124 @@
+/** @file */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCHEDULER_NUM_FINGERPRINTS (1 << 22) /**< Number of bits of the bitmap of the responses seen. */
+
+typedef struct _scheduler scheduler_t; /**< Scheduler. */
+
+/**
+ * Scheduler reward events (i.e., the events that reward an arm).
+ */
+enum scheduler_event {
+    SCHEDULER_NOVEL = 1,  /**< Novel response (see scheduler_is_novel()). */
+    SCHEDULER_ERROR = 2,  /**< Device error (e.g., a target abort). */
+    SCHEDULER_OUTLIER = 4 /**< Latency outlier (see scheduler_is_outlier()). */
+};
+
+typedef void scheduler_error_handler_t(int status, int error, const char *restrict format, va_list ap);
+
+/**
+ * Creates a scheduler (i.e., a multi-armed bandit that selects the arm of the
+ * highest upper confidence bound (UCB1) of its reward).
+ *
+ * The confidence bounds are kept in a tournament tree, so an arm is selected
+ * in constant time, and its confidence bound is updated in time logarithmic in
+ * the number of arms. The exploration term of every arm is only recomputed
+ * when the number of pulls doubles, as it grows with the logarithm of the
+ * number of pulls.
+ *
+ * @param [in] num_arms Number of arms.
+ * @return A scheduler.
+ */
+scheduler_t *scheduler_create(size_t num_arms);
+
+/**
+ * Destroys the scheduler.
+ *
+ * @param [in] scheduler Scheduler.
+ */
+void scheduler_destroy(scheduler_t *restrict scheduler);
+
+/**
+ * Returns whether a response fingerprint was never seen, and marks it as seen.
+ *
+ * The fingerprints are hashed into a bitmap of SCHEDULER_NUM_FINGERPRINTS bits,
+ * so a novel fingerprint is sometimes taken for a seen one, and novel
+ * fingerprints get rarer as the bitmap fills up.
+ *
+ * @param [in] scheduler Scheduler.
+ * @param [in] fingerprint Response fingerprint.
+ * @return Returns true if the fingerprint was never seen; otherwise, returns
+ *   false.
+ */
+bool scheduler_is_novel(scheduler_t *restrict scheduler, uint64_t fingerprint);
+
+/**
+ * Returns whether the latency of a pull of an arm is an outlier (i.e., more
+ * than eight times the moving average of the latencies of the arm), and
+ * updates the moving average.
+ *
+ * @param [in] scheduler Scheduler.
+ * @param [in] arm Arm.
+ * @param [in] cycles Latency, in time stamp counter cycles.
+ * @return Returns true if the latency is an outlier; otherwise, returns false
+ *   (e.g., for the first 16 pulls of the arm).
+ */
+bool scheduler_is_outlier(scheduler_t *restrict scheduler, size_t arm, uint64_t cycles);
+
+/**
+ * Counts a pull of an arm (i.e., an unrewarded pull, until it is rewarded, see
+ * scheduler_reward()).
+ *
+ * @param [in] scheduler Scheduler.
+ * @param [in] arm Arm.
+ */
+void scheduler_pull(scheduler_t *restrict scheduler, size_t arm);
+
+/**
+ * Rewards a pull of an arm.
+ *
+ * The reward of a pull is 1 if any event occurred, and 0 otherwise.
+ *
+ * @param [in] scheduler Scheduler.
+ * @param [in] arm Arm.
+ * @param [in] events Events (see scheduler_event).
+ */
+void scheduler_reward(scheduler_t *restrict scheduler, size_t arm, int events);
+
+/**
+ * Selects an arm (i.e., the arm of the highest upper confidence bound).
+ *
+ * The selection is not counted as a pull, so a selection that is not followed
+ * by a pull (e.g., because the input ended) does not count against the arm.
+ * Consecutive selections are spread across the arms only if their pulls are
+ * counted (see scheduler_pull()) in between.
+ *
+ * @param [in] scheduler Scheduler.
+ * @return Arm.
+ */
+size_t scheduler_select(scheduler_t *restrict scheduler);
+
+/**
+ * Sets the error handler for the scheduler.
+ *
+ * @param [in] handler Error handler.
+ * @return Previous error handler.
+ */
+scheduler_error_handler_t *scheduler_set_error_handler(scheduler_error_handler_t *handler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCHEDULER_H */
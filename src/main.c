@@ -6,22 +6,43 @@
 
 #include "../lib/error.h"
 #include "../lib/string.h"
+#include "handler.h"
+#include "lib/channel.h"
+#include "lib/corpus.h"
+#include "lib/latency.h"
+#include "lib/pci_bus.h"
 #include "lib/pci_device.h"
+#include "lib/pci_device_mock.h"
 #include "lib/pci_fuzzer.h"
+#include "lib/prng.h"
+#include "lib/profile.h"
+#include "lib/recorder.h"
+#include "lib/replay.h"
+#include "lib/scheduler.h"
+#include "status.h"
+#include "stream.h"
+#include "watchdog.h"
+#include "worker.h"
 
 #include <errno.h>
 #include <getopt.h>
 #include <limits.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
+#include <dirent.h>
+#include <fcntl.h>
 #include <sys/io.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
+#define MAX_CPUS 1023
 #define MAX_REGIONS 6
 
 #define usage() \
@@ -34,111 +55,244 @@
             "                        default is 0.)\n" \
             "  -F, --function=NUM    Specify the PCI function number of the ATA/IDE\n" \
             "                        controller. (The default is 0.)\n" \
-            "  -d, --debug           Enable debug mode.\n" \
-            "  -g, --generate        Use the pseudorandom number generator (i.e., random())\n" \
-            "                        for input generation.\n" \
+            "  -T, --targets=LIST    Specify the list of PCI devices (i.e., BUS:DEVICE.FUNCTION\n" \
+            "                        in hexadecimal, as printed by lspci) to fuzz, each by its\n" \
+            "                        own thread. (The default is the PCI device specified by\n" \
+            "                        the above options.)\n" \
+            "  -c, --cpus=LIST       Specify the list of CPUs to pin the threads to. (The\n" \
+            "                        default is not to pin the threads.)\n" \
+            "      --channel=FILE    Perform the test cases sent through the test case\n" \
+            "                        channel file (e.g., by pcifuzzer-controller) until it\n" \
+            "                        is closed.\n" \
+            "      --config=NAME     Specify the PCI configuration space access mechanism\n" \
+            "                        (i.e., io, ecam, or sysfs). (The default is io.)\n" \
+            "      --corpus-size=NUM Specify the maximum number of inputs in the corpus. (The\n" \
+            "                        default is 4096.)\n" \
+            "  -d, --debug           Enable debug mode (i.e., write a JSON snapshot of the\n" \
+            "                        statistics of each thread every second).\n" \
+            "      --feedback        Keep the inputs that produce new responses from the PCI\n" \
+            "                        device in a corpus, and mutate them preferentially.\n" \
+            "      --format=NAME     Specify the input format (i.e., v1, or v2 for bit-packed\n" \
+            "                        fields and varint offsets). (The default is v1.)\n" \
+            "  -g, --generate        Use the pseudorandom number generator for input\n" \
+            "                        generation.\n" \
+            "      --generator=NAME  Specify the pseudorandom number generator (i.e.,\n" \
+            "                        random, splitmix64, or xoshiro256). (The default is\n" \
+            "                        random.)\n" \
             "  -h, --help            Display help information and exit.\n" \
+            "      --latency=FILE    Measure the latency of every access with the time stamp\n" \
+            "                        counter, and write the latency histograms to the file\n" \
+            "                        on exit (or when interrupted).\n" \
+            "      --list            List the PCI devices and exit.\n" \
+            "      --map=NAME        Specify the PCI device memory region mapping mechanism\n" \
+            "                        (i.e., devmem, sysfs, or sysfs-wc). (The default is\n" \
+            "                        devmem.)\n" \
+            "      --map-window=NUM  Specify the size, in bytes, of the mapped window of each\n" \
+            "                        PCI device memory region. (The default is 0, to map each\n" \
+            "                        memory region whole.)\n" \
+            "      --mock            Fuzz an in-memory mock device instead of a PCI device.\n" \
             "  -o, --output=FILE     Specify the output file name.\n" \
-            "  -q, --quiet           Enable quiet mode.\n" \
+            "      --profile=NAME    Sample the offsets of the accesses from the registers of\n" \
+            "                        the register map profile (i.e., ata, or a profile file\n" \
+            "                        name).\n" \
+            "  -p, --program         Decode each input as a program (i.e., a sequence of\n" \
+            "                        iterations).\n" \
+            "      --program-size=NUM\n" \
+            "                        Specify the size, in bytes, of each generated program.\n" \
+            "                        (The default is 1024.)\n" \
+            "  -q, --quiet           Enable quiet mode (i.e., write no status lines).\n" \
+            "  -R, --record=FILE     Record every operation to the flight recorder file. (The\n" \
+            "                        log is not written unless an output file is specified.)\n" \
+            "      --record-size=NUM Specify the number of records in the flight recorder\n" \
+            "                        file. (The default is 65536.)\n" \
+            "      --replay=FILE     Perform the operations in the log, flight recorder, or\n" \
+            "                        replay file (e.g., compiled by pcifuzzer-decode) and\n" \
+            "                        exit.\n" \
+            "      --replay-interval=NUM\n" \
+            "                        Specify the interval, in nanoseconds, between replayed\n" \
+            "                        operations. (The default is 0, to replay them\n" \
+            "                        back-to-back.)\n" \
             "  -r, --regions=LIST    Specify the list of PCI device regions. (The default is\n" \
             "                        all regions.)\n" \
+            "      --schedule=NAME   Specify the schedule of the regions and functions of the\n" \
+            "                        accesses (i.e., input, or ucb to favor the regions and\n" \
+            "                        functions that produce new responses, device errors, or\n" \
+            "                        latency outliers). (The default is input.)\n" \
             "  -s, --seed=NUM        Specify the seed for the pseudorandom number generator.\n" \
             "                        (The default is 1.)\n" \
-            "  -t, --timeout=NUM     Specify the timeout, in seconds, for each iteration.\n" \
-            "                        (The default is 5.)\n" \
-            "  -v, --verbose         Enable verbose mode.\n" \
+            "      --seeds=DIR       Mutate the inputs in the directory (i.e., the seed\n" \
+            "                        corpus) preferentially.\n" \
+            "  -t, --timeout=NUM     Specify the timeout, in seconds, for each operation, or\n" \
+            "                        0 to disable the watchdog. (The default is 5.)\n" \
+            "  -v, --verbose         Enable verbose mode (i.e., write a status line every\n" \
+            "                        second instead of every 10 seconds).\n" \
             "      --version         Display version information and exit.\n", \
             PACKAGE_NAME)
 
 #define version() fprintf(stderr, "%s\n", PACKAGE_STRING)
 
-void
-default_error_handler(int status, int error, const char *restrict format, va_list ap)
+/**
+ * PCI device address.
+ */
+struct target {
+    unsigned long bus;
+    unsigned long device;
+    unsigned long function;
+};
+
+int
+parse_targets(const char *restrict string, struct target **targets, size_t *num_targets)
 {
-    fflush(stdout);
-    vfprintf(stderr, format, ap);
-    if (error != 0) {
-        fprintf(stderr, ": %s\n", strerror(error));
+    char *str = strdup(string);
+    if (str == NULL) {
+        return -1;
     }
 
-    fflush(stderr);
-    abort();
+    *targets = NULL;
+    *num_targets = 0;
+    char *lasts = NULL;
+    for (char *token = strtok_r(str, ",", &lasts); token != NULL; token = strtok_r(NULL, ",", &lasts)) {
+        struct target target;
+        int length = 0;
+        if (sscanf(token, "%lx:%lx.%lx%n", &target.bus, &target.device, &target.function, &length) != 3
+                || token[length] != '\0' || target.bus > 255 || target.device > 31 || target.function > 7) {
+            errno = EINVAL;
+            goto err;
+        }
+
+        struct target *new_targets = (struct target *)realloc(*targets, (*num_targets + 1) * sizeof(**targets));
+        if (new_targets == NULL) {
+            goto err;
+        }
+
+        *targets = new_targets;
+        (*targets)[(*num_targets)++] = target;
+    }
+
+    free(str);
+    if (*num_targets == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+
+err:
+    free(str);
+    free(*targets);
+    *targets = NULL;
+    *num_targets = 0;
+    return -1;
 }
 
-void
-default_log_handler(FILE *restrict stream, const char *restrict format, va_list ap)
+corpus_t *
+read_seeds(const char *restrict path, size_t input_size, size_t num_inputs)
 {
-    flockfile(stream);
-    fprintf(stream, "{ ");
-    fprintf(stream, "\"time\": %d,", (unsigned int)time(NULL));
-    for (size_t i = 0; format[i] != '\0'; ++i) {
-        if (i > 0) {
-            fprintf(stream, ", ");
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return NULL;
+    }
+
+    corpus_t *seeds = corpus_create(input_size, num_inputs);
+    if (seeds == NULL) {
+        closedir(dir);
+        return NULL;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        /* Empty files are ignored */
+        struct stat st;
+        if (fstatat(dirfd(dir), entry->d_name, &st, 0) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+            continue;
         }
 
-        fprintf(stream, "\"%s\": ", va_arg(ap, char *));
-        switch (format[i]) {
-        case 'c':
-            fprintf(stream, "\"%c\"", va_arg(ap, int));
-            break;
+        int fd = openat(dirfd(dir), entry->d_name, O_RDONLY | O_CLOEXEC);
+        FILE *stream = (fd != -1) ? fdopen(fd, "r") : NULL;
+        if (stream == NULL) {
+            if (fd != -1) {
+                close(fd);
+            }
 
-        case 'd':
-            fprintf(stream, "%d", va_arg(ap, int));
-            break;
+            goto err;
+        }
 
-        case 'f':
-            fprintf(stream, "%f", va_arg(ap, double));
-            break;
+        size_t size = 0;
+        uint8_t *buf = read_stream(stream, &size);
+        fclose(stream);
+        if (buf == NULL) {
+            goto err;
+        }
 
-        case 'o':
-            fprintf(stream, "%o", va_arg(ap, unsigned int));
-            break;
+        corpus_append(seeds, buf, size);
+        free(buf);
+    }
 
-        case 'p':
-            fprintf(stream, "%p", va_arg(ap, void *));
-            break;
+    closedir(dir);
+    return seeds;
 
-        case 'q':
-            fprintf(stream, "%llu", va_arg(ap, unsigned long long int));
-            break;
+err:
+    closedir(dir);
+    corpus_destroy(seeds);
+    return NULL;
+}
 
-        case 's':
-            fprintf(stream, "\"%s\"", va_arg(ap, char *));
-            break;
+void
+serve_channel(pci_fuzzer_t *restrict pci_fuzzer, channel_t *restrict channel, int program)
+{
+    unsigned int num_polls = 0;
+    for (;;) {
+        size_t size = 0;
+        const void *buf = channel_receive(channel, &size);
+        if (buf == NULL) {
+            /* Stop once the channel is closed and every test case sent before
+               was performed. */
+            if (channel_is_closed(channel) && channel_receive(channel, &size) == NULL) {
+                break;
+            }
 
-        case 'u':
-            fprintf(stream, "%u", va_arg(ap, unsigned int));
-            break;
+            /* Poll without system calls for a while, and then back off */
+            if (++num_polls < 4096) {
+                __builtin_ia32_pause();
+            } else {
+                struct timespec ts = {.tv_sec = 0, .tv_nsec = 100000};
+                nanosleep(&ts, NULL);
+            }
 
-        case 'x':
-            fprintf(stream, "%x", va_arg(ap, unsigned int));
-            break;
+            continue;
+        }
 
-        case 'z':
-            fprintf(stream, "%zu", va_arg(ap, size_t));
-            break;
+        num_polls = 0;
+        if (program) {
+            size_t num_ops = pci_fuzzer_iterate_program(pci_fuzzer, buf, size);
+            channel_complete(channel, CHANNEL_DONE, num_ops, pci_fuzzer_get_fingerprint(pci_fuzzer));
+        } else if (size > 0) {
+            /* Iterations are decoded from inputs of a fixed size, so shorter
+               test cases (e.g., the few bytes of an operation in the v2
+               format) are padded with zeros, as the corpus inputs are */
+            uint8_t input[PCI_FUZZER_MAX_INPUT];
+            if (size < sizeof(input)) {
+                memcpy(input, buf, size);
+                memset(&input[size], 0, sizeof(input) - size);
+                buf = input;
+                size = sizeof(input);
+            }
 
-        default:
-            abort();
+            pci_fuzzer_iterate_buf(pci_fuzzer, buf, size);
+            channel_complete(channel, CHANNEL_DONE, 1, pci_fuzzer_get_fingerprint(pci_fuzzer));
+        } else {
+            channel_complete(channel, CHANNEL_REJECTED, 0, 0);
         }
     }
-
-    fprintf(stream, " }\n");
-    fflush(stream);
-    fsync(fileno(stream));
-    funlockfile(stream);
 }
 
 void
-random_buf(void *buf, size_t size)
+write_latency(worker_t **workers, size_t num_workers)
 {
-    uint32_t number = 0;
-    for (size_t i = 0; i < size; ++i) {
-        if ((i % sizeof(uint16_t)) == 0) {
-            number = random();
+    for (size_t i = 0; i < num_workers; ++i) {
+        if (worker_write_latency(workers[i]) == -1) {
+            perror("worker_write_latency");
         }
-
-        ((uint8_t *)buf)[i] = (number >> (8 * (i % sizeof(uint16_t)))) & 0xff;
     }
 }
 
@@ -148,41 +302,105 @@ main(int argc, char *argv[])
     int c = 0;
     enum
     {
-        OPT_VERSION = CHAR_MAX + 1,
+        OPT_CHANNEL = CHAR_MAX + 1,
+        OPT_CONFIG,
+        OPT_CORPUS_SIZE,
+        OPT_FEEDBACK,
+        OPT_FORMAT,
+        OPT_GENERATOR,
+        OPT_LATENCY,
+        OPT_LIST,
+        OPT_MAP,
+        OPT_MAP_WINDOW,
+        OPT_MOCK,
+        OPT_PROFILE,
+        OPT_PROGRAM_SIZE,
+        OPT_RECORD_SIZE,
+        OPT_REPLAY,
+        OPT_REPLAY_INTERVAL,
+        OPT_SCHEDULE,
+        OPT_SEEDS,
+        OPT_VERSION,
     };
     /* clang-format off */
     static struct option longopts[] = {
-        {"bus",         required_argument, NULL, 'B'             },
-        {"device",      required_argument, NULL, 'D'             },
-        {"function",    required_argument, NULL, 'F'             },
-        {"debug",       no_argument,       NULL, 'd'             },
-        {"generate",    no_argument,       NULL, 'g'             },
-        {"help",        no_argument,       NULL, 'h'             },
-        {"output",      required_argument, NULL, 'o'             },
-        {"quiet",       no_argument,       NULL, 'q'             },
-        {"regions",     required_argument, NULL, 'r'             },
-        {"seed",        required_argument, NULL, 's'             },
-        {"timeout",     required_argument, NULL, 't'             },
-        {"verbose",     no_argument,       NULL, 'v'             },
-        {"version",     no_argument,       NULL, OPT_VERSION     },
-        {NULL,          0,                 NULL, 0               }
+        {"bus",             required_argument, NULL, 'B'                 },
+        {"device",          required_argument, NULL, 'D'                 },
+        {"function",        required_argument, NULL, 'F'                 },
+        {"targets",         required_argument, NULL, 'T'                 },
+        {"cpus",            required_argument, NULL, 'c'                 },
+        {"channel",         required_argument, NULL, OPT_CHANNEL         },
+        {"config",          required_argument, NULL, OPT_CONFIG          },
+        {"corpus-size",     required_argument, NULL, OPT_CORPUS_SIZE     },
+        {"debug",           no_argument,       NULL, 'd'                 },
+        {"feedback",        no_argument,       NULL, OPT_FEEDBACK        },
+        {"format",          required_argument, NULL, OPT_FORMAT          },
+        {"generate",        no_argument,       NULL, 'g'                 },
+        {"generator",       required_argument, NULL, OPT_GENERATOR       },
+        {"help",            no_argument,       NULL, 'h'                 },
+        {"latency",         required_argument, NULL, OPT_LATENCY         },
+        {"list",            no_argument,       NULL, OPT_LIST            },
+        {"map",             required_argument, NULL, OPT_MAP             },
+        {"map-window",      required_argument, NULL, OPT_MAP_WINDOW      },
+        {"mock",            no_argument,       NULL, OPT_MOCK            },
+        {"output",          required_argument, NULL, 'o'                 },
+        {"program",         no_argument,       NULL, 'p'                 },
+        {"program-size",    required_argument, NULL, OPT_PROGRAM_SIZE    },
+        {"profile",         required_argument, NULL, OPT_PROFILE         },
+        {"record",          required_argument, NULL, 'R'                 },
+        {"record-size",     required_argument, NULL, OPT_RECORD_SIZE     },
+        {"replay",          required_argument, NULL, OPT_REPLAY          },
+        {"replay-interval", required_argument, NULL, OPT_REPLAY_INTERVAL },
+        {"quiet",           no_argument,       NULL, 'q'                 },
+        {"regions",         required_argument, NULL, 'r'                 },
+        {"schedule",        required_argument, NULL, OPT_SCHEDULE        },
+        {"seed",            required_argument, NULL, 's'                 },
+        {"seeds",           required_argument, NULL, OPT_SEEDS           },
+        {"timeout",         required_argument, NULL, 't'                 },
+        {"verbose",         no_argument,       NULL, 'v'                 },
+        {"version",         no_argument,       NULL, OPT_VERSION         },
+        {NULL,              0,                 NULL, 0                   }
     };
     /* clang-format on */
     static int longindex = 0;
     unsigned long bus = 0;
     unsigned long device = 0;
     unsigned long function = 0;
+    struct target *targets = NULL;
+    size_t num_targets = 0;
+    int *cpus = NULL;
+    size_t num_cpus = 0;
+    char *channel_path = NULL;
+    int config_access = PCI_DEVICE_CONFIG_IO;
+    size_t corpus_size = CORPUS_NUM_INPUTS;
     int debug = 0;
+    int feedback = 0;
+    int format = PCI_FUZZER_FORMAT_V1;
     int generate = 0;
+    int generator = PRNG_RANDOM;
     char *input = NULL;
+    char *latency = NULL;
+    int list = 0;
+    int map = PCI_DEVICE_REGION_DEVMEM;
+    uint64_t map_window = 0;
+    int mock = 0;
     char *output = NULL;
+    char *profile_name = NULL;
+    int program = 0;
+    size_t program_size = PCI_FUZZER_MAX_PROGRAM;
     int quiet = 0;
+    char *record = NULL;
+    size_t record_size = RECORDER_NUM_RECORDS;
+    char *replay_path = NULL;
+    uint64_t replay_interval = 0;
     int *regions = NULL;
     size_t num_regions = 0;
+    int schedule = PCI_FUZZER_SCHEDULE_INPUT;
     unsigned long seed = 1;
+    char *seeds_path = NULL;
     int timeout = 5;
     int verbose = 0;
-    while ((c = getopt_long(argc, argv, "B:D:F:dgho:qr:s:t:v", longopts, &longindex)) != -1) {
+    while ((c = getopt_long(argc, argv, "B:D:F:R:T:c:dgho:pqr:s:t:v", longopts, &longindex)) != -1) {
         switch (c) {
         case 'B':
             errno = 0;
@@ -229,6 +447,26 @@ main(int argc, char *argv[])
 
             break;
 
+        case 'R':
+            record = optarg;
+            break;
+
+        case 'T':
+            if (parse_targets(optarg, &targets, &num_targets) == -1) {
+                perror("parse_targets");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case 'c':
+            if (string_split_range(optarg, ",", MAX_CPUS, &cpus, &num_cpus) == -1) {
+                perror("getlist");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
         case 'd':
             debug = 1;
             break;
@@ -245,6 +483,10 @@ main(int argc, char *argv[])
             output = optarg;
             break;
 
+        case 'p':
+            program = 1;
+            break;
+
         case 'q':
             quiet = 1;
             break;
@@ -281,6 +523,148 @@ main(int argc, char *argv[])
             verbose = 1;
             break;
 
+        case OPT_CHANNEL:
+            channel_path = optarg;
+            break;
+
+        case OPT_CONFIG:
+            config_access = pci_device_get_config_access(optarg);
+            if (config_access == -1) {
+                fprintf(stderr, "%s: Invalid PCI configuration space access mechanism.\n", __func__);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_CORPUS_SIZE:
+            errno = 0;
+            corpus_size = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            if (corpus_size == 0) {
+                fprintf(stderr, "%s: Invalid corpus size.\n", __func__);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_FEEDBACK:
+            feedback = 1;
+            break;
+
+        case OPT_FORMAT:
+            format = pci_fuzzer_get_format(optarg);
+            if (format == -1) {
+                fprintf(stderr, "%s: Invalid input format.\n", __func__);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_GENERATOR:
+            generator = prng_get_type(optarg);
+            if (generator == -1) {
+                fprintf(stderr, "%s: Invalid pseudorandom number generator.\n", __func__);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_LATENCY:
+            latency = optarg;
+            break;
+
+        case OPT_LIST:
+            list = 1;
+            break;
+
+        case OPT_MAP:
+            map = pci_device_get_region_access(optarg);
+            if (map == -1) {
+                fprintf(stderr, "%s: Invalid PCI device memory region mapping mechanism.\n", __func__);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_MAP_WINDOW:
+            errno = 0;
+            map_window = strtoull(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoull");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_MOCK:
+            mock = 1;
+            break;
+
+        case OPT_PROFILE:
+            profile_name = optarg;
+            break;
+
+        case OPT_PROGRAM_SIZE:
+            errno = 0;
+            program_size = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            if (program_size == 0) {
+                fprintf(stderr, "%s: Invalid program size.\n", __func__);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_RECORD_SIZE:
+            errno = 0;
+            record_size = strtoul(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoul");
+                exit(EXIT_FAILURE);
+            }
+
+            if (record_size == 0) {
+                fprintf(stderr, "%s: Invalid flight recorder size.\n", __func__);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_REPLAY:
+            replay_path = optarg;
+            break;
+
+        case OPT_REPLAY_INTERVAL:
+            errno = 0;
+            replay_interval = strtoull(optarg, NULL, 0);
+            if (errno != 0) {
+                perror("strtoull");
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_SCHEDULE:
+            schedule = pci_fuzzer_get_schedule(optarg);
+            if (schedule == -1) {
+                fprintf(stderr, "%s: Invalid schedule.\n", __func__);
+                exit(EXIT_FAILURE);
+            }
+
+            break;
+
+        case OPT_SEEDS:
+            seeds_path = optarg;
+            break;
+
         case OPT_VERSION:
             version();
             exit(EXIT_FAILURE);
@@ -291,79 +675,302 @@ main(int argc, char *argv[])
         }
     }
 
-    FILE *stream = stdout;
-    if (output != NULL) {
-        stream = fopen(output, "a+");
-        if (stream == NULL) {
-            perror("fopen");
+    if (num_targets == 0) {
+        targets = (struct target *)malloc(sizeof(*targets));
+        if (targets == NULL) {
+            perror("malloc");
             exit(EXIT_FAILURE);
         }
+
+        targets[0].bus = bus;
+        targets[0].device = device;
+        targets[0].function = function;
+        num_targets = 1;
+    }
+
+    if (!generate && num_targets > 1) {
+        fprintf(stderr, "%s: Multiple targets require input generation.\n", __func__);
+        exit(EXIT_FAILURE);
+    }
+
+    if ((generate + (channel_path != NULL) + (replay_path != NULL)) > 1) {
+        fprintf(stderr, "%s: Input generation, the test case channel, and replay are mutually exclusive.\n",
+                __func__);
+        exit(EXIT_FAILURE);
     }
 
-    if (iopl(3) == -1) {
+    if (!generate && (feedback || seeds_path != NULL)) {
+        fprintf(stderr, "%s: Feedback and seed inputs require input generation.\n", __func__);
+        exit(EXIT_FAILURE);
+    }
+
+    /* Listing the PCI devices through the ECAM window or sysfs needs no port
+       I/O. */
+    if (!mock && (!list || config_access == PCI_DEVICE_CONFIG_IO) && iopl(3) == -1) {
         perror("iopl");
         exit(EXIT_FAILURE);
     }
 
     pci_device_set_error_handler(default_error_handler);
-    pci_device_t *pci_device = pci_device_create(bus, device, function);
-    if (pci_device == NULL) {
-        perror("pci_device_create");
-        fclose(stream);
-        exit(EXIT_FAILURE);
+    pci_device_set_config_access(config_access);
+    pci_device_set_region_access(map);
+    pci_device_set_region_window(map_window);
+    pci_bus_t *pci_bus = NULL;
+    if (!mock) {
+        /* Enumerate the PCI devices once, so each PCI device is created from
+           its configuration space snapshot. */
+        pci_bus = pci_bus_create(config_access);
+        if (pci_bus == NULL) {
+            perror("pci_bus_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (list) {
+        for (size_t i = 0; pci_bus != NULL && i < pci_bus_get_num_devices(pci_bus); ++i) {
+            const pci_bus_device_t *bus_device = pci_bus_get_device(pci_bus, i);
+            printf("%02x:%02x.%x %04x:%04x %06x\n", bus_device->bus, bus_device->device, bus_device->function,
+                    bus_device->vendor_id, bus_device->device_id, bus_device->class_code);
+        }
+
+        pci_bus_destroy(pci_bus);
+        exit(EXIT_SUCCESS);
     }
 
+    channel_set_error_handler(default_error_handler);
+    corpus_set_error_handler(default_error_handler);
+    latency_set_error_handler(default_error_handler);
     pci_fuzzer_set_error_handler(default_error_handler);
-    pci_fuzzer_t *pci_fuzzer = pci_fuzzer_create(pci_device, regions, num_regions);
-    if (pci_fuzzer == NULL) {
-        perror("pci_fuzzer_create");
+    prng_set_error_handler(default_error_handler);
+    recorder_set_error_handler(default_error_handler);
+    profile_set_error_handler(default_error_handler);
+    replay_set_error_handler(default_error_handler);
+    scheduler_set_error_handler(default_error_handler);
+    corpus_t *seeds = NULL;
+    if (seeds_path != NULL) {
+        seeds = read_seeds(seeds_path, program ? program_size : PCI_FUZZER_MAX_INPUT, corpus_size);
+        if (seeds == NULL) {
+            perror("read_seeds");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    profile_t *profile = NULL;
+    if (profile_name != NULL) {
+        profile = profile_open(profile_name);
+        if (profile == NULL) {
+            perror("profile_open");
+            corpus_destroy(seeds);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    worker_config_t config = {
+            .mock = mock,
+            .regions = regions,
+            .num_regions = num_regions,
+            .output = output,
+            .record = record,
+            .record_size = record_size,
+            .latency = latency,
+            .format = format,
+            .profile = profile,
+            .schedule = schedule,
+            .program = program,
+            .program_size = program ? program_size : 0,
+            .feedback = feedback,
+            .corpus_size = corpus_size,
+            .seeds = seeds,
+            .cpus = cpus,
+            .num_cpus = num_cpus,
+            .num_workers = num_targets,
+    };
+    prng_t *prng = NULL;
+    status_t *status = NULL;
+    watchdog_t *watchdog = NULL;
+    worker_t **workers = (worker_t **)calloc(num_targets, sizeof(*workers));
+    if (workers == NULL) {
+        perror("calloc");
         goto err;
     }
 
-    pci_fuzzer_set_log_handler(pci_fuzzer, default_log_handler);
-    pci_fuzzer_set_log_stream(pci_fuzzer, stream);
     if (generate) {
-        srandom(seed);
-        for (;;) {
-            uint8_t buf[PCI_FUZZER_MAX_INPUT];
-            random_buf(buf, sizeof(buf));
-            FILE *stream = fmemopen(buf, sizeof(buf), "r");
-            if (stream == NULL) {
-                perror("fmemopen");
+        prng = prng_create(generator, seed);
+        if (prng == NULL) {
+            perror("prng_create");
+            goto err;
+        }
+    }
+
+    for (size_t i = 0; i < num_targets; ++i) {
+        /* Each worker has its own stream of the pseudorandom number generator
+           (a single worker uses the pseudorandom number generator itself, so
+           its inputs are the same as before there were workers). */
+        prng_t *worker_prng = NULL;
+        if (prng != NULL) {
+            worker_prng = (num_targets == 1) ? prng : prng_split(prng);
+            if (num_targets == 1) {
+                prng = NULL;
+            }
+        }
+
+        const void *snapshot = NULL;
+        if (pci_bus != NULL) {
+            const pci_bus_device_t *bus_device
+                    = pci_bus_find_device(pci_bus, targets[i].bus, targets[i].device, targets[i].function);
+            if (bus_device == NULL) {
+                fprintf(stderr, "%s: No such PCI device: %02lx:%02lx.%lx\n", __func__, targets[i].bus,
+                        targets[i].device, targets[i].function);
+                prng_destroy(worker_prng);
                 goto err;
             }
 
-            pci_fuzzer_iterate(pci_fuzzer, stream);
-            fclose(stream);
+            snapshot = bus_device->config;
+        }
+
+        workers[i] = worker_create(
+                &config, i, targets[i].bus, targets[i].device, targets[i].function, snapshot, worker_prng);
+        if (workers[i] == NULL) {
+            perror("worker_create");
+            goto err;
         }
+    }
+
+    /* The workers never terminate, so the latency histograms are written when
+       the fuzzer is interrupted instead. The signals are blocked before any
+       other thread is created, so only this thread waits for them. */
+    sigset_t signals;
+    sigemptyset(&signals);
+    if (generate && latency != NULL) {
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    }
+
+    if (timeout > 0) {
+        watchdog = watchdog_create(workers, num_targets, timeout);
+        if (watchdog == NULL) {
+            perror("watchdog_create");
+            goto err;
+        }
+    }
+
+    /* The statistics are written to the standard error, as the log may be
+       written to the standard output. */
+    if (!quiet) {
+        status = status_create(workers, num_targets, (verbose || debug) ? 1 : 10, debug, stderr);
+        if (status == NULL) {
+            perror("status_create");
+            goto err;
+        }
+    }
+
+    if (generate) {
+        for (size_t i = 0; i < num_targets; ++i) {
+            int error = worker_start(workers[i]);
+            if (error != 0) {
+                /* The workers already started cannot be destroyed */
+                errno = error;
+                perror("worker_start");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        if (latency != NULL) {
+            int signal_number = 0;
+            sigwait(&signals, &signal_number);
+            write_latency(workers, num_targets);
+            /* Terminate by the signal, as if it was not blocked */
+            signal(signal_number, SIG_DFL);
+            pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+            raise(signal_number);
+        }
+
+        for (size_t i = 0; i < num_targets; ++i) {
+            worker_join(workers[i]);
+        }
+    } else if (channel_path != NULL) {
+        channel_t *channel = channel_open(channel_path);
+        if (channel == NULL) {
+            perror("channel_open");
+            goto err;
+        }
+
+        serve_channel(workers[0]->pci_fuzzer, channel, program);
+        channel_destroy(channel);
+    } else if (replay_path != NULL) {
+        replay_t *replay = replay_open(replay_path);
+        if (replay == NULL) {
+            perror("replay_open");
+            goto err;
+        }
+
+        replay_run(replay, workers[0]->pci_fuzzer, replay_interval);
+        replay_destroy(replay);
     } else {
+        pci_fuzzer_t *pci_fuzzer = workers[0]->pci_fuzzer;
         if (argv[optind] != NULL) {
             input = argv[optind];
         }
 
-        FILE *stream = stdin;
+        FILE *input_stream = stdin;
         if (input != NULL) {
-            FILE *stream = fopen(input, "r");
-            if (stream == NULL) {
+            input_stream = fopen(input, "r");
+            if (input_stream == NULL) {
                 perror("fopen");
-                exit(EXIT_FAILURE);
+                goto err;
             }
         }
 
-        pci_fuzzer_iterate(pci_fuzzer, stream);
-        fclose(stream);
+        if (program) {
+            size_t size = 0;
+            uint8_t *buf = read_stream(input_stream, &size);
+            if (buf == NULL) {
+                perror("read_stream");
+                fclose(input_stream);
+                goto err;
+            }
+
+            pci_fuzzer_iterate_program(pci_fuzzer, buf, size);
+            free(buf);
+        } else {
+            pci_fuzzer_iterate(pci_fuzzer, input_stream);
+        }
+
+        fclose(input_stream);
     }
 
-    pci_fuzzer_destroy(pci_fuzzer);
-    pci_device_destroy(pci_device);
-    fclose(stream);
+    write_latency(workers, num_targets);
+    status_destroy(status, verbose || debug);
+    watchdog_destroy(watchdog);
+    for (size_t i = 0; i < num_targets; ++i) {
+        worker_destroy(workers[i]);
+    }
+
+    free(workers);
+    corpus_destroy(seeds);
+    profile_destroy(profile);
+    prng_destroy(prng);
+    pci_bus_destroy(pci_bus);
+    free(targets);
+    free(cpus);
     free(regions);
     exit(EXIT_SUCCESS);
 
 err:
-    pci_fuzzer_destroy(pci_fuzzer);
-    pci_device_destroy(pci_device);
-    fclose(stream);
+    status_destroy(status, 0);
+    watchdog_destroy(watchdog);
+    for (size_t i = 0; workers != NULL && i < num_targets; ++i) {
+        worker_destroy(workers[i]);
+    }
+
+    free(workers);
+    corpus_destroy(seeds);
+    profile_destroy(profile);
+    prng_destroy(prng);
+    pci_bus_destroy(pci_bus);
+    free(targets);
+    free(cpus);
     free(regions);
     exit(EXIT_FAILURE);
 }
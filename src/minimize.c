@@ -0,0 +1,366 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "handler.h"
+#include "lib/pci_fuzzer.h"
+#include "lib/replay.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define usage() \
+    fprintf(stderr, \
+            "Usage: %s-minimize [OPTION]... -c COMMAND FILE\n" \
+            "Minimizes the operations in the log, flight recorder, or replay file that\n" \
+            "reproduce a failure, and writes the minimal operations as log lines.\n" \
+            "Options:\n" \
+            "  -T, --targets=LIST    Specify the list of targets (e.g., PCI devices or VMs) to\n" \
+            "                        run the command against in parallel. (The default is a\n" \
+            "                        single unnamed target.)\n" \
+            "  -c, --command=COMMAND Specify the shell command that replays the operations\n" \
+            "                        in the replay file PCIFUZZER_REPLAY against the target\n" \
+            "                        PCIFUZZER_TARGET, and exits with status 0 if the\n" \
+            "                        failure was reproduced.\n" \
+            "  -h, --help            Display help information and exit.\n" \
+            "  -o, --output=FILE     Write the minimal operations to the replay file.\n" \
+            "  -v, --verbose         Enable verbose mode.\n" \
+            "      --version         Display version information and exit.\n", \
+            PACKAGE_NAME)
+
+#define version() fprintf(stderr, "%s\n", PACKAGE_STRING)
+
+/**
+ * Reproduction oracle (i.e., a command run against a target).
+ */
+struct oracle {
+    const char *target;
+    char *path;
+    pid_t pid;
+};
+
+/**
+ * Delta debugging state.
+ */
+struct minimizer {
+    const char *command;
+    struct oracle *oracles;
+    size_t num_oracles;
+    replay_op_t *ops;
+    size_t num_ops;
+    replay_op_t *candidate;
+    size_t num_tests;
+};
+
+size_t
+build_candidate(const replay_op_t *ops, size_t num_ops, size_t n, size_t index, replay_op_t *candidate)
+{
+    /* Candidates 0 to n-1 are the n chunks of the operations, and candidates n
+       to 2n-1 are their complements. */
+    size_t chunk = (index < n) ? index : (index - n);
+    size_t first = (chunk * num_ops) / n;
+    size_t last = ((chunk + 1) * num_ops) / n;
+    if (index < n) {
+        memcpy(candidate, &ops[first], (last - first) * sizeof(*ops));
+        return last - first;
+    }
+
+    memcpy(candidate, ops, first * sizeof(*ops));
+    memcpy(&candidate[first], &ops[last], (num_ops - last) * sizeof(*ops));
+    return num_ops - (last - first);
+}
+
+int
+start_oracle(const char *restrict command, struct oracle *restrict oracle, const replay_op_t *ops, size_t num_ops)
+{
+    replay_t *replay = replay_create(ops, num_ops);
+    if (replay == NULL) {
+        return -1;
+    }
+
+    if (replay_save(replay, oracle->path) == -1) {
+        replay_destroy(replay);
+        return -1;
+    }
+
+    replay_destroy(replay);
+    fflush(stdout);
+    fflush(stderr);
+    oracle->pid = fork();
+    if (oracle->pid == -1) {
+        return -1;
+    }
+
+    if (oracle->pid == 0) {
+        /* The output of the command would be mixed with the log lines */
+        if (setenv("PCIFUZZER_REPLAY", oracle->path, 1) == -1
+                || (oracle->target != NULL && setenv("PCIFUZZER_TARGET", oracle->target, 1) == -1)
+                || dup2(STDERR_FILENO, STDOUT_FILENO) == -1) {
+            _exit(127);
+        }
+
+        execl("/bin/sh", "sh", "-c", command, (char *)NULL);
+        _exit(127);
+    }
+
+    return 0;
+}
+
+int
+wait_oracle(struct oracle *restrict oracle)
+{
+    /* Returns whether the failure was reproduced */
+    int status;
+    while (waitpid(oracle->pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            perror("waitpid");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+long
+test_candidates(struct minimizer *restrict minimizer, size_t n, size_t num_candidates)
+{
+    /* Tests the candidates in batches of one per oracle, and returns the first
+       (i.e., the lowest) candidate that reproduces the failure, so the result
+       does not depend on the number of oracles, or -1 if none does. */
+    for (size_t first = 0; first < num_candidates; first += minimizer->num_oracles) {
+        size_t count = num_candidates - first;
+        if (count > minimizer->num_oracles) {
+            count = minimizer->num_oracles;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            size_t size = build_candidate(minimizer->ops, minimizer->num_ops, n, first + i, minimizer->candidate);
+            if (start_oracle(minimizer->command, &minimizer->oracles[i], minimizer->candidate, size) == -1) {
+                perror("start_oracle");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        long found = -1;
+        for (size_t i = 0; i < count; ++i) {
+            if (wait_oracle(&minimizer->oracles[i]) && found == -1) {
+                found = first + i;
+            }
+        }
+
+        minimizer->num_tests += count;
+        if (found != -1) {
+            return found;
+        }
+    }
+
+    return -1;
+}
+
+void
+minimize(struct minimizer *restrict minimizer, int verbose)
+{
+    /* Delta debugging (i.e., ddmin): remove chunks of the operations, at an
+       increasing granularity, for as long as the failure reproduces. */
+    size_t n = 2;
+    while (minimizer->num_ops >= 2) {
+        if (n > minimizer->num_ops) {
+            n = minimizer->num_ops;
+        }
+
+        /* With two chunks, the complements are the chunks themselves */
+        long found = test_candidates(minimizer, n, (n == 2) ? 2 : (2 * n));
+        if (found != -1) {
+            size_t size = build_candidate(minimizer->ops, minimizer->num_ops, n, found, minimizer->candidate);
+            replay_op_t *ops = minimizer->ops;
+            minimizer->ops = minimizer->candidate;
+            minimizer->candidate = ops;
+            minimizer->num_ops = size;
+            n = ((size_t)found < n) ? 2 : ((n > 2) ? (n - 1) : 2);
+        } else if (n >= minimizer->num_ops) {
+            break;
+        } else {
+            n = ((2 * n) < minimizer->num_ops) ? (2 * n) : minimizer->num_ops;
+        }
+
+        if (verbose) {
+            fprintf(stderr, "%zu operations, %zu chunks, %zu tests\n", minimizer->num_ops, n, minimizer->num_tests);
+        }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    int c = 0;
+    enum
+    {
+        OPT_VERSION = CHAR_MAX + 1,
+    };
+    /* clang-format off */
+    static struct option longopts[] = {
+        {"targets",     required_argument, NULL, 'T'             },
+        {"command",     required_argument, NULL, 'c'             },
+        {"help",        no_argument,       NULL, 'h'             },
+        {"output",      required_argument, NULL, 'o'             },
+        {"verbose",     no_argument,       NULL, 'v'             },
+        {"version",     no_argument,       NULL, OPT_VERSION     },
+        {NULL,          0,                 NULL, 0               }
+    };
+    /* clang-format on */
+    static int longindex = 0;
+    char *targets = NULL;
+    char *command = NULL;
+    char *output = NULL;
+    int verbose = 0;
+    while ((c = getopt_long(argc, argv, "T:c:ho:v", longopts, &longindex)) != -1) {
+        switch (c) {
+        case 'T':
+            targets = optarg;
+            break;
+
+        case 'c':
+            command = optarg;
+            break;
+
+        case 'h':
+            usage();
+            exit(EXIT_FAILURE);
+
+        case 'o':
+            output = optarg;
+            break;
+
+        case 'v':
+            verbose = 1;
+            break;
+
+        case OPT_VERSION:
+            version();
+            exit(EXIT_FAILURE);
+
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (argv[optind] == NULL || command == NULL) {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    pci_fuzzer_set_error_handler(exit_error_handler);
+    replay_set_error_handler(exit_error_handler);
+    replay_t *replay = replay_open(argv[optind]);
+    if (replay == NULL) {
+        perror("replay_open");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Each oracle has a target, and a replay file of its own */
+    struct minimizer minimizer = {.command = command};
+    char *lasts = NULL;
+    char *token = (targets != NULL) ? strtok_r(targets, ",", &lasts) : NULL;
+    do {
+        struct oracle *oracles
+                = (struct oracle *)realloc(minimizer.oracles, (minimizer.num_oracles + 1) * sizeof(*oracles));
+        if (oracles == NULL) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+
+        minimizer.oracles = oracles;
+        minimizer.oracles[minimizer.num_oracles++].target = token;
+    } while (token != NULL && (token = strtok_r(NULL, ",", &lasts)) != NULL);
+
+    char dir[] = "/tmp/pcifuzzer-minimize.XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < minimizer.num_oracles; ++i) {
+        size_t size = sizeof(dir) + 32;
+        minimizer.oracles[i].path = (char *)malloc(size);
+        if (minimizer.oracles[i].path == NULL) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+
+        snprintf(minimizer.oracles[i].path, size, "%s/candidate.%zu", dir, i);
+    }
+
+    minimizer.num_ops = replay_get_num_ops(replay);
+    minimizer.ops = (replay_op_t *)malloc((minimizer.num_ops + 1) * sizeof(*minimizer.ops));
+    minimizer.candidate = (replay_op_t *)malloc((minimizer.num_ops + 1) * sizeof(*minimizer.candidate));
+    if (minimizer.ops == NULL || minimizer.candidate == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < minimizer.num_ops; ++i) {
+        minimizer.ops[i] = *replay_get_op(replay, i);
+    }
+
+    replay_destroy(replay);
+    int status = EXIT_FAILURE;
+    if (start_oracle(command, &minimizer.oracles[0], minimizer.ops, minimizer.num_ops) == -1) {
+        perror("start_oracle");
+        goto out;
+    }
+
+    if (!wait_oracle(&minimizer.oracles[0])) {
+        fprintf(stderr, "%s: The operations do not reproduce the failure.\n", __func__);
+        goto out;
+    }
+
+    minimizer.num_tests = 1;
+    minimize(&minimizer, verbose);
+    for (size_t i = 0; i < minimizer.num_ops; ++i) {
+        const replay_op_t *op = &minimizer.ops[i];
+        const char *function = pci_fuzzer_get_function_name(op->function);
+        printf("{ \"function\": \"%s\", \"region\": %u, \"offset\": %" PRIu64, function, op->region, op->offset);
+        if (pci_fuzzer_function_has_value(op->function)) {
+            printf(", \"value\": %" PRIu64, op->value);
+        }
+
+        printf(" }\n");
+    }
+
+    if (output != NULL) {
+        replay = replay_create(minimizer.ops, minimizer.num_ops);
+        if (replay == NULL || replay_save(replay, output) == -1) {
+            perror("replay_save");
+            goto out;
+        }
+
+        replay_destroy(replay);
+    }
+
+    status = EXIT_SUCCESS;
+
+out:
+    for (size_t i = 0; i < minimizer.num_oracles; ++i) {
+        unlink(minimizer.oracles[i].path);
+        free(minimizer.oracles[i].path);
+    }
+
+    rmdir(dir);
+    free(minimizer.oracles);
+    free(minimizer.ops);
+    free(minimizer.candidate);
+    exit(status);
+}
@@ -0,0 +1,224 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "status.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FUNCTION_PREFIX "pci_device_region_"
+
+static double
+status_seconds(const struct timespec *start, const struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) + ((double)(end->tv_nsec - start->tv_nsec) / 1e9);
+}
+
+static double
+status_share(uint64_t count, uint64_t total)
+{
+    return (total != 0) ? ((100.0 * count) / total) : 0.0;
+}
+
+static void
+status_report(status_t *status)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    pci_fuzzer_stats_t total;
+    memset(&total, 0, sizeof(total));
+    for (size_t i = 0; i < status->num_workers; ++i) {
+        pci_fuzzer_stats_t *stats = &status->stats[i];
+        pci_fuzzer_get_stats(status->workers[i]->pci_fuzzer, stats);
+        total.num_iterations += stats->num_iterations;
+        total.num_skipped += stats->num_skipped;
+        total.num_rewarded += stats->num_rewarded;
+        for (size_t j = 0; j < PCI_FUZZER_MAX_REGIONS; ++j) {
+            total.num_region_ops[j] += stats->num_region_ops[j];
+        }
+
+        for (size_t j = 0; j < PCI_FUZZER_NUM_FUNCTIONS; ++j) {
+            total.num_function_ops[j] += stats->num_function_ops[j];
+        }
+    }
+
+    /* The rates and shares are over the last interval, so a campaign that
+       degrades (e.g., into skipping most operations) shows immediately. */
+    double seconds = status_seconds(&status->time, &now);
+    uint64_t num_iterations = total.num_iterations - status->last.num_iterations;
+    uint64_t num_skipped = total.num_skipped - status->last.num_skipped;
+    uint64_t num_ops = 0;
+    for (size_t i = 0; i < PCI_FUZZER_NUM_FUNCTIONS; ++i) {
+        num_ops += total.num_function_ops[i] - status->last.num_function_ops[i];
+    }
+
+    double iterations_per_sec = (seconds > 0) ? (num_iterations / seconds) : 0.0;
+    double ops_per_sec = (seconds > 0) ? (num_ops / seconds) : 0.0;
+    flockfile(status->stream);
+    if (status->json) {
+        fprintf(status->stream,
+                "{ \"time\": %lld, \"elapsed\": %.3f, \"iterations_per_sec\": %.0f, \"ops_per_sec\": %.0f, "
+                "\"workers\": [",
+                (long long)time(NULL), status_seconds(&status->start, &now), iterations_per_sec, ops_per_sec);
+        for (size_t i = 0; i < status->num_workers; ++i) {
+            const pci_fuzzer_stats_t *stats = &status->stats[i];
+            fprintf(status->stream,
+                    "%s{ \"worker\": %zu, \"iterations\": %" PRIu64 ", \"skipped\": %" PRIu64
+                    ", \"rewarded\": %" PRIu64,
+                    (i > 0) ? ", " : " ", i, stats->num_iterations, stats->num_skipped, stats->num_rewarded);
+            fprintf(status->stream, ", \"regions\": [");
+            for (size_t j = 0; j < PCI_FUZZER_MAX_REGIONS; ++j) {
+                fprintf(status->stream, "%s%" PRIu64, (j > 0) ? ", " : " ", stats->num_region_ops[j]);
+            }
+
+            fprintf(status->stream, " ], \"functions\": {");
+            for (int j = 0; j < PCI_FUZZER_NUM_FUNCTIONS; ++j) {
+                fprintf(status->stream, "%s\"%s\": %" PRIu64, (j > 0) ? ", " : " ", pci_fuzzer_get_function_name(j),
+                        stats->num_function_ops[j]);
+            }
+
+            fprintf(status->stream, " } }");
+        }
+
+        fprintf(status->stream, " ] }\n");
+    } else {
+        fprintf(status->stream, "[%.0f s] %.0f iterations/s, %.0f operations/s, %.1f%% skipped",
+                status_seconds(&status->start, &now), iterations_per_sec, ops_per_sec,
+                status_share(num_skipped, num_skipped + num_ops));
+        for (size_t i = 0; i < PCI_FUZZER_MAX_REGIONS; ++i) {
+            uint64_t count = total.num_region_ops[i] - status->last.num_region_ops[i];
+            if (count != 0) {
+                fprintf(status->stream, ", region %zu: %.1f%%", i, status_share(count, num_ops));
+            }
+        }
+
+        for (int i = 0; i < PCI_FUZZER_NUM_FUNCTIONS; ++i) {
+            uint64_t count = total.num_function_ops[i] - status->last.num_function_ops[i];
+            fprintf(status->stream, ", %s: %.1f%%", pci_fuzzer_get_function_name(i) + strlen(FUNCTION_PREFIX),
+                    status_share(count, num_ops));
+        }
+
+        fprintf(status->stream, "\n");
+    }
+
+    fflush(status->stream);
+    funlockfile(status->stream);
+    status->last = total;
+    status->time = now;
+}
+
+static void *
+status_run(void *arg)
+{
+    status_t *status = (status_t *)arg;
+    struct timespec deadline = status->start;
+    pthread_mutex_lock(&status->mutex);
+    while (!status->stop) {
+        deadline.tv_sec += status->interval;
+        while (!status->stop && pthread_cond_timedwait(&status->cond, &status->mutex, &deadline) != ETIMEDOUT) {
+        }
+
+        if (!status->stop) {
+            status_report(status);
+        }
+    }
+
+    pthread_mutex_unlock(&status->mutex);
+    return NULL;
+}
+
+status_t *
+status_create(worker_t **workers, size_t num_workers, unsigned int interval, int json, FILE *stream)
+{
+    if (num_workers == 0 || interval == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    status_t *status = (status_t *)calloc(1, sizeof(*status));
+    if (status == NULL) {
+        return NULL;
+    }
+
+    status->workers = workers;
+    status->num_workers = num_workers;
+    status->interval = interval;
+    status->json = json;
+    status->stream = stream;
+    status->stats = (pci_fuzzer_stats_t *)calloc(num_workers, sizeof(*status->stats));
+    if (status->stats == NULL) {
+        goto err;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &status->start);
+    status->time = status->start;
+    /* Wait on the monotonic clock, as the watchdog does */
+    pthread_condattr_t attr;
+    int error = pthread_condattr_init(&attr);
+    if (error == 0) {
+        error = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        if (error == 0) {
+            error = pthread_cond_init(&status->cond, &attr);
+        }
+
+        pthread_condattr_destroy(&attr);
+    }
+
+    if (error != 0) {
+        errno = error;
+        goto err;
+    }
+
+    error = pthread_mutex_init(&status->mutex, NULL);
+    if (error != 0) {
+        pthread_cond_destroy(&status->cond);
+        errno = error;
+        goto err;
+    }
+
+    error = pthread_create(&status->thread, NULL, status_run, status);
+    if (error != 0) {
+        pthread_mutex_destroy(&status->mutex);
+        pthread_cond_destroy(&status->cond);
+        errno = error;
+        goto err;
+    }
+
+    return status;
+
+err:
+    free(status->stats);
+    free(status);
+    return NULL;
+}
+
+void
+status_destroy(status_t *status, int report)
+{
+    if (status == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&status->mutex);
+    status->stop = 1;
+    pthread_cond_signal(&status->cond);
+    pthread_mutex_unlock(&status->mutex);
+    pthread_join(status->thread, NULL);
+    if (report) {
+        status_report(status);
+    }
+
+    pthread_mutex_destroy(&status->mutex);
+    pthread_cond_destroy(&status->cond);
+    free(status->stats);
+    free(status);
+}
@@ -0,0 +1,68 @@
+/** @file */
+
+#ifndef STATUS_H
+#define STATUS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lib/pci_fuzzer.h"
+#include "worker.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * Status reporter (i.e., the thread that periodically aggregates the
+ * statistics of the workers, see pci_fuzzer_get_stats(), into a status line
+ * or a JSON snapshot).
+ */
+typedef struct status {
+    worker_t **workers;        /**< Workers. */
+    size_t num_workers;        /**< Number of workers. */
+    unsigned int interval;     /**< Interval, in seconds, between reports. */
+    int json;                  /**< Whether to write JSON snapshots instead of status lines. */
+    FILE *stream;              /**< Stream the reports are written to. */
+    pci_fuzzer_stats_t *stats; /**< Statistics of each worker. */
+    pci_fuzzer_stats_t last;   /**< Aggregate statistics at the last report. */
+    struct timespec start;     /**< Start time. */
+    struct timespec time;      /**< Time of the last report. */
+    int stop;                  /**< Whether the thread is to stop. */
+    pthread_mutex_t mutex;     /**< Mutex (for stop). */
+    pthread_cond_t cond;       /**< Condition variable (for stop). */
+    pthread_t thread;          /**< Thread. */
+} status_t;
+
+/**
+ * Creates a status reporter, and starts its thread.
+ *
+ * The status line has the rates (i.e., the iterations and operations per
+ * second), the share of operations skipped, and the shares of operations on
+ * each region and of each function since the last report. The JSON snapshot
+ * has the counters of each worker since the start.
+ *
+ * @param [in] workers Workers.
+ * @param [in] num_workers Number of workers.
+ * @param [in] interval Interval, in seconds, between reports.
+ * @param [in] json Whether to write JSON snapshots instead of status lines.
+ * @param [in] stream Stream the reports are written to.
+ * @return A status reporter, or NULL (and errno is set) if an error occurs.
+ */
+status_t *status_create(worker_t **workers, size_t num_workers, unsigned int interval, int json, FILE *stream);
+
+/**
+ * Stops the status reporter thread, and destroys the status reporter.
+ *
+ * @param [in] status Status reporter.
+ * @param [in] report Whether to write a last report.
+ */
+void status_destroy(status_t *status, int report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STATUS_H */
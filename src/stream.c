@@ -0,0 +1,44 @@
+/** @file */
+
+#include "stream.h"
+
+#include "lib/pci_fuzzer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+uint8_t *
+read_stream(FILE *restrict stream, size_t *size)
+{
+    size_t capacity = PCI_FUZZER_MAX_PROGRAM;
+    uint8_t *buf = (uint8_t *)malloc(capacity);
+    if (buf == NULL) {
+        return NULL;
+    }
+
+    *size = 0;
+    for (;;) {
+        *size += fread(buf + *size, 1, capacity - *size, stream);
+        if (*size < capacity) {
+            break;
+        }
+
+        capacity *= 2;
+        uint8_t *new_buf = (uint8_t *)realloc(buf, capacity);
+        if (new_buf == NULL) {
+            free(buf);
+            return NULL;
+        }
+
+        buf = new_buf;
+    }
+
+    if (ferror(stream)) {
+        free(buf);
+        return NULL;
+    }
+
+    return buf;
+}
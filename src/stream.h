@@ -0,0 +1,28 @@
+/** @file */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Reads a stream to its end into a buffer (e.g., a program or a seed input).
+ *
+ * @param [in] stream Stream.
+ * @param [out] size Number of bytes read.
+ * @return Buffer, to be freed by the caller, or NULL (and sets errno) on
+ *         failure.
+ */
+uint8_t *read_stream(FILE *restrict stream, size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STREAM_H */
@@ -0,0 +1,164 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "watchdog.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define WATCHDOG_PERIODS 4 /**< Number of heartbeat samples per timeout. */
+
+static void
+watchdog_report(watchdog_t *watchdog, size_t index)
+{
+    pci_fuzzer_op_t op = {.function = -1};
+    pci_fuzzer_get_heartbeat(watchdog->workers[index]->pci_fuzzer, &op);
+    const char *function = pci_fuzzer_get_function_name(op.function);
+    flockfile(stderr);
+    fprintf(stderr, "%s: Operation timed out after %u seconds.\n", __func__, watchdog->timeout);
+    fprintf(stderr, "{ \"worker\": %zu, \"function\": \"%s\", \"region\": %zu, \"offset\": %zu", index,
+            (function != NULL) ? function : "", op.region, op.offset);
+    if (pci_fuzzer_function_has_value(op.function)) {
+        fprintf(stderr, ", \"value\": %" PRIu64, op.value);
+    }
+
+    fprintf(stderr, " }\n");
+    fflush(stderr);
+    funlockfile(stderr);
+}
+
+static void *
+watchdog_run(void *arg)
+{
+    watchdog_t *watchdog = (watchdog_t *)arg;
+    uint64_t period = ((uint64_t)watchdog->timeout * 1000000000) / WATCHDOG_PERIODS;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    pthread_mutex_lock(&watchdog->mutex);
+    while (!watchdog->stop) {
+        deadline.tv_sec += period / 1000000000;
+        deadline.tv_nsec += period % 1000000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            ++deadline.tv_sec;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        if (pthread_cond_timedwait(&watchdog->cond, &watchdog->mutex, &deadline) != ETIMEDOUT) {
+            continue;
+        }
+
+        /* An operation is stalled if the heartbeat is odd (i.e., the
+           operation is in progress) and has not changed for the whole
+           timeout. */
+        for (size_t i = 0; i < watchdog->num_workers; ++i) {
+            uint64_t heartbeat = pci_fuzzer_get_heartbeat(watchdog->workers[i]->pci_fuzzer, NULL);
+            if ((heartbeat & 1) == 0 || heartbeat != watchdog->heartbeats[i]) {
+                watchdog->heartbeats[i] = heartbeat;
+                watchdog->stalls[i] = 0;
+                continue;
+            }
+
+            if (++watchdog->stalls[i] >= WATCHDOG_PERIODS) {
+                /* The operation and everything before it are already in the
+                   log and the flight recorder, so abort for a core dump of
+                   the stalled worker. */
+                watchdog_report(watchdog, i);
+                abort();
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&watchdog->mutex);
+    return NULL;
+}
+
+watchdog_t *
+watchdog_create(worker_t **workers, size_t num_workers, unsigned int timeout)
+{
+    if (num_workers == 0 || timeout == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    watchdog_t *watchdog = (watchdog_t *)calloc(1, sizeof(*watchdog));
+    if (watchdog == NULL) {
+        return NULL;
+    }
+
+    watchdog->workers = workers;
+    watchdog->num_workers = num_workers;
+    watchdog->timeout = timeout;
+    watchdog->heartbeats = (uint64_t *)calloc(num_workers, sizeof(*watchdog->heartbeats));
+    watchdog->stalls = (unsigned int *)calloc(num_workers, sizeof(*watchdog->stalls));
+    if (watchdog->heartbeats == NULL || watchdog->stalls == NULL) {
+        goto err;
+    }
+
+    /* Wait on the monotonic clock, so the timeout does not depend on changes
+       of the system time. */
+    pthread_condattr_t attr;
+    int error = pthread_condattr_init(&attr);
+    if (error == 0) {
+        error = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        if (error == 0) {
+            error = pthread_cond_init(&watchdog->cond, &attr);
+        }
+
+        pthread_condattr_destroy(&attr);
+    }
+
+    if (error != 0) {
+        errno = error;
+        goto err;
+    }
+
+    error = pthread_mutex_init(&watchdog->mutex, NULL);
+    if (error != 0) {
+        pthread_cond_destroy(&watchdog->cond);
+        errno = error;
+        goto err;
+    }
+
+    error = pthread_create(&watchdog->thread, NULL, watchdog_run, watchdog);
+    if (error != 0) {
+        pthread_mutex_destroy(&watchdog->mutex);
+        pthread_cond_destroy(&watchdog->cond);
+        errno = error;
+        goto err;
+    }
+
+    return watchdog;
+
+err:
+    free(watchdog->heartbeats);
+    free(watchdog->stalls);
+    free(watchdog);
+    return NULL;
+}
+
+void
+watchdog_destroy(watchdog_t *watchdog)
+{
+    if (watchdog == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&watchdog->mutex);
+    watchdog->stop = 1;
+    pthread_cond_signal(&watchdog->cond);
+    pthread_mutex_unlock(&watchdog->mutex);
+    pthread_join(watchdog->thread, NULL);
+    pthread_mutex_destroy(&watchdog->mutex);
+    pthread_cond_destroy(&watchdog->cond);
+    free(watchdog->heartbeats);
+    free(watchdog->stalls);
+    free(watchdog);
+}
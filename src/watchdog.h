@@ -0,0 +1,59 @@
+/** @file */
+
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "worker.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Watchdog (i.e., the thread that detects stalled operations of the workers
+ * from their heartbeats, see pci_fuzzer_get_heartbeat()).
+ */
+typedef struct watchdog {
+    worker_t **workers;    /**< Workers. */
+    size_t num_workers;    /**< Number of workers. */
+    unsigned int timeout;  /**< Timeout, in seconds, for each operation. */
+    uint64_t *heartbeats;  /**< Last heartbeat of each worker. */
+    unsigned int *stalls;  /**< Number of periods each worker has been stalled for. */
+    int stop;              /**< Whether the thread is to stop. */
+    pthread_mutex_t mutex; /**< Mutex (for stop). */
+    pthread_cond_t cond;   /**< Condition variable (for stop). */
+    pthread_t thread;      /**< Thread. */
+} watchdog_t;
+
+/**
+ * Creates a watchdog, and starts its thread.
+ *
+ * The heartbeats are sampled a few times per timeout, so the workers make no
+ * system calls (nor rearm any timers) for the watchdog. If an operation is in
+ * progress for longer than the timeout, the operation is written to the
+ * standard error, and the process is aborted (the worker cannot be stopped
+ * while it is accessing the PCI device).
+ *
+ * @param [in] workers Workers.
+ * @param [in] num_workers Number of workers.
+ * @param [in] timeout Timeout, in seconds, for each operation.
+ * @return A watchdog, or NULL (and errno is set) if an error occurs.
+ */
+watchdog_t *watchdog_create(worker_t **workers, size_t num_workers, unsigned int timeout);
+
+/**
+ * Stops the watchdog thread, and destroys the watchdog.
+ *
+ * @param [in] watchdog Watchdog.
+ */
+void watchdog_destroy(watchdog_t *watchdog);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WATCHDOG_H */
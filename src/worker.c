@@ -0,0 +1,282 @@
+/** @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "worker.h"
+
+#include "handler.h"
+#include "lib/mutator.h"
+#include "lib/pci_device_mock.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char *
+worker_get_shard_name(const worker_t *worker, const char *name)
+{
+    char *shard_name = NULL;
+    if (worker->config->num_workers == 1) {
+        return strdup(name);
+    }
+
+    if (asprintf(&shard_name, "%s.%zu", name, worker->index) == -1) {
+        return NULL;
+    }
+
+    return shard_name;
+}
+
+static void *
+worker_run_corpus(worker_t *worker)
+{
+    size_t max_size = worker->config->program ? worker->config->program_size : PCI_FUZZER_MAX_INPUT;
+    for (;;) {
+        /* Mutate an input of the corpus (spliced with another input of the
+           corpus) seven times out of eight, and generate a new input
+           otherwise. */
+        size_t size = max_size;
+        size_t num_inputs = corpus_get_num_inputs(worker->corpus);
+        uint64_t random = prng_next(worker->prng);
+        if (num_inputs > 0 && (random & 7) != 0) {
+            const void *input = corpus_get_input(worker->corpus, (random >> 3) % num_inputs, &size);
+            size_t other_size = 0;
+            const uint8_t *other
+                    = (const uint8_t *)corpus_get_input(worker->corpus, (random >> 32) % num_inputs, &other_size);
+            memcpy(worker->buf, input, size);
+            size = mutator_mutate(worker->prng, worker->buf, size, max_size, other, other_size);
+        } else {
+            prng_fill(worker->prng, worker->buf, size);
+        }
+
+        if (worker->config->program) {
+            pci_fuzzer_iterate_program(worker->pci_fuzzer, worker->buf, size);
+        } else {
+            /* Iterations are decoded from inputs of a fixed size */
+            memset(&worker->buf[size], 0, max_size - size);
+            /* Only the bytes that were decoded are kept (e.g., a few bytes in
+               the v2 format), as the rest did not affect the iteration */
+            size = pci_fuzzer_iterate_buf(worker->pci_fuzzer, worker->buf, max_size);
+        }
+
+        if (!worker->config->feedback) {
+            continue;
+        }
+
+        corpus_add(worker->corpus, pci_fuzzer_get_fingerprint(worker->pci_fuzzer), worker->buf, size);
+    }
+
+    return NULL;
+}
+
+static void *
+worker_run(void *arg)
+{
+    worker_t *worker = (worker_t *)arg;
+    if (worker->corpus != NULL) {
+        return worker_run_corpus(worker);
+    }
+
+    if (worker->config->program) {
+        for (;;) {
+            prng_fill(worker->prng, worker->buf, worker->config->program_size);
+            pci_fuzzer_iterate_program(worker->pci_fuzzer, worker->buf, worker->config->program_size);
+        }
+    }
+
+    for (;;) {
+        prng_fill(worker->prng, worker->buf, PCI_FUZZER_MAX_INPUT);
+        pci_fuzzer_iterate_buf(worker->pci_fuzzer, worker->buf, PCI_FUZZER_MAX_INPUT);
+    }
+
+    return NULL;
+}
+
+worker_t *
+worker_create(const worker_config_t *config, size_t index, unsigned long bus, unsigned long device,
+        unsigned long function, const void *snapshot, prng_t *prng)
+{
+    worker_t *worker = (worker_t *)calloc(1, sizeof(*worker));
+    if (worker == NULL) {
+        prng_destroy(prng);
+        return NULL;
+    }
+
+    worker->config = config;
+    worker->index = index;
+    worker->cpu = (config->num_cpus > 0) ? config->cpus[index % config->num_cpus] : -1;
+    worker->prng = prng;
+    worker->buf = (uint8_t *)malloc(
+            (config->program_size > PCI_FUZZER_MAX_INPUT) ? config->program_size : PCI_FUZZER_MAX_INPUT);
+    if (worker->buf == NULL) {
+        goto err;
+    }
+
+    worker->pci_device
+            = config->mock ? pci_device_mock_create(NULL) : pci_device_create_config(bus, device, function, snapshot);
+    if (worker->pci_device == NULL) {
+        goto err;
+    }
+
+    worker->pci_fuzzer = pci_fuzzer_create(worker->pci_device, config->regions, config->num_regions);
+    if (worker->pci_fuzzer == NULL) {
+        goto err;
+    }
+
+    pci_fuzzer_set_format(worker->pci_fuzzer, config->format);
+    pci_fuzzer_set_profile(worker->pci_fuzzer, config->profile);
+    if (pci_fuzzer_set_schedule(worker->pci_fuzzer, config->schedule) == -1) {
+        goto err;
+    }
+
+    if (config->feedback || config->seeds != NULL) {
+        worker->corpus = corpus_create(
+                config->program ? config->program_size : PCI_FUZZER_MAX_INPUT, config->corpus_size);
+        if (worker->corpus == NULL) {
+            goto err;
+        }
+
+        /* Each worker mutates its own copy of the seed corpus */
+        for (size_t i = 0; config->seeds != NULL && i < corpus_get_num_inputs(config->seeds); ++i) {
+            size_t size = 0;
+            const void *input = corpus_get_input(config->seeds, i, &size);
+            corpus_append(worker->corpus, input, size);
+        }
+    }
+
+    if (config->record != NULL) {
+        char *record = worker_get_shard_name(worker, config->record);
+        if (record == NULL) {
+            goto err;
+        }
+
+        worker->recorder = recorder_create(record, config->record_size);
+        free(record);
+        if (worker->recorder == NULL) {
+            goto err;
+        }
+
+        pci_fuzzer_set_recorder(worker->pci_fuzzer, worker->recorder);
+    }
+
+    if (config->latency != NULL) {
+        worker->latency = latency_create(worker->pci_device);
+        if (worker->latency == NULL) {
+            goto err;
+        }
+
+        pci_fuzzer_set_latency(worker->pci_fuzzer, worker->latency);
+    }
+
+    if (config->record == NULL || config->output != NULL) {
+        worker->stream = stdout;
+        if (config->output != NULL) {
+            char *output = worker_get_shard_name(worker, config->output);
+            if (output == NULL) {
+                goto err;
+            }
+
+            worker->stream = fopen(output, "a+");
+            free(output);
+            if (worker->stream == NULL) {
+                goto err;
+            }
+        }
+
+        pci_fuzzer_set_log_handler(worker->pci_fuzzer, default_log_handler);
+        pci_fuzzer_set_log_stream(worker->pci_fuzzer, worker->stream);
+    }
+
+    return worker;
+
+err:
+    worker_destroy(worker);
+    return NULL;
+}
+
+void
+worker_destroy(worker_t *worker)
+{
+    if (worker == NULL) {
+        return;
+    }
+
+    int error = errno;
+    pci_fuzzer_destroy(worker->pci_fuzzer);
+    recorder_destroy(worker->recorder);
+    latency_destroy(worker->latency);
+    corpus_destroy(worker->corpus);
+    pci_device_destroy(worker->pci_device);
+    prng_destroy(worker->prng);
+    if (worker->stream != NULL && worker->stream != stdout) {
+        fclose(worker->stream);
+    }
+
+    free(worker->buf);
+    free(worker);
+    errno = error;
+}
+
+int
+worker_join(worker_t *worker)
+{
+    return pthread_join(worker->thread, NULL);
+}
+
+int
+worker_start(worker_t *worker)
+{
+    pthread_attr_t attr;
+    int error = pthread_attr_init(&attr);
+    if (error != 0) {
+        return error;
+    }
+
+    if (worker->cpu != -1) {
+        /* Pin the thread before it starts, so it never runs anywhere else */
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(worker->cpu, &cpu_set);
+        error = pthread_attr_setaffinity_np(&attr, sizeof(cpu_set), &cpu_set);
+        if (error != 0) {
+            pthread_attr_destroy(&attr);
+            return error;
+        }
+    }
+
+    error = pthread_create(&worker->thread, &attr, worker_run, worker);
+    pthread_attr_destroy(&attr);
+    return error;
+}
+
+int
+worker_write_latency(worker_t *worker)
+{
+    if (worker->latency == NULL) {
+        return 0;
+    }
+
+    char *latency = worker_get_shard_name(worker, worker->config->latency);
+    if (latency == NULL) {
+        return -1;
+    }
+
+    FILE *stream = fopen(latency, "w");
+    free(latency);
+    if (stream == NULL) {
+        return -1;
+    }
+
+    int result = latency_write(worker->latency, stream);
+    if (fclose(stream) == EOF) {
+        result = -1;
+    }
+
+    return result;
+}
@@ -0,0 +1,133 @@
+/** @file */
+
+#ifndef WORKER_H
+#define WORKER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lib/corpus.h"
+#include "lib/latency.h"
+#include "lib/pci_device.h"
+#include "lib/pci_fuzzer.h"
+#include "lib/prng.h"
+#include "lib/profile.h"
+#include "lib/recorder.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Worker configuration (i.e., the configuration shared by all workers).
+ */
+typedef struct worker_config {
+    int mock;               /**< Whether to fuzz a mock device instead of a PCI device. */
+    const int *regions;     /**< List of PCI device regions. */
+    size_t num_regions;     /**< Number of PCI device regions. */
+    const char *output;     /**< Log file name, or NULL for the standard output. */
+    const char *record;     /**< Flight recorder file name, or NULL. */
+    size_t record_size;     /**< Number of records in the flight recorder file. */
+    const char *latency;    /**< Latency histograms file name, or NULL. */
+    int format;             /**< Input format (see pci_fuzzer_format). */
+    profile_t *profile;     /**< Register map profile, or NULL. */
+    int schedule;           /**< Schedule (see pci_fuzzer_schedule). */
+    int program;            /**< Whether to generate programs instead of iterations. */
+    size_t program_size;    /**< Size of each generated program. */
+    int feedback;           /**< Whether to keep the inputs with new responses and mutate them. */
+    size_t corpus_size;     /**< Maximum number of inputs in the corpus of each worker. */
+    corpus_t *seeds;        /**< Seed corpus, or NULL. */
+    const int *cpus;        /**< List of CPUs to pin the workers to, or NULL. */
+    size_t num_cpus;        /**< Number of CPUs. */
+    size_t num_workers;     /**< Number of workers. */
+} worker_config_t;
+
+/**
+ * Worker (i.e., a PCI fuzzer, its PCI device, pseudorandom number generator,
+ * log shard, flight recorder shard, latency histograms, and corpus, and the
+ * thread that runs it).
+ */
+typedef struct worker {
+    const worker_config_t *config; /**< Worker configuration. */
+    size_t index;                  /**< Worker index. */
+    int cpu;                       /**< CPU the worker is pinned to, or -1. */
+    pci_device_t *pci_device;      /**< PCI device. */
+    pci_fuzzer_t *pci_fuzzer;      /**< PCI fuzzer. */
+    prng_t *prng;                  /**< Pseudorandom number generator, or NULL. */
+    recorder_t *recorder;          /**< Flight recorder shard, or NULL. */
+    latency_t *latency;            /**< Latency histograms, or NULL. */
+    corpus_t *corpus;              /**< Corpus, or NULL. */
+    FILE *stream;                  /**< Log shard, or NULL. */
+    uint8_t *buf;                  /**< Input buffer. */
+    pthread_t thread;              /**< Thread. */
+} worker_t;
+
+/**
+ * Creates a worker.
+ *
+ * The PCI device is created (and its regions are mapped) by the calling
+ * thread, so workers must be created one at a time. If there is more than one
+ * worker, the log, flight recorder, and latency histograms file names of each
+ * worker are suffixed with its index (e.g., "pcifuzzer.log.1").
+ *
+ * @param [in] config Worker configuration.
+ * @param [in] index Worker index.
+ * @param [in] bus PCI bus number.
+ * @param [in] device PCI device number.
+ * @param [in] function PCI function number.
+ * @param [in] snapshot Configuration space snapshot of the PCI device (see
+ *   pci_device_create_config()), or NULL.
+ * @param [in] prng Pseudorandom number generator (the worker takes ownership
+ *   of it), or NULL.
+ * @return A worker, or NULL (and errno is set) if an error occurs.
+ */
+worker_t *worker_create(const worker_config_t *config, size_t index, unsigned long bus, unsigned long device,
+        unsigned long function, const void *snapshot, prng_t *prng);
+
+/**
+ * Destroys the worker.
+ *
+ * @param [in] worker Worker.
+ */
+void worker_destroy(worker_t *worker);
+
+/**
+ * Waits for the worker thread to terminate.
+ *
+ * @param [in] worker Worker.
+ * @return 0 on success, or an error number.
+ */
+int worker_join(worker_t *worker);
+
+/**
+ * Starts the worker thread, which generates inputs and fuzzes the PCI device
+ * indefinitely, pinned to its CPU (if any).
+ *
+ * With a seed corpus or feedback, most inputs are mutations (see
+ * mutator_mutate()) of the inputs in the corpus of the worker instead of new
+ * inputs. With feedback, the inputs whose fingerprint (see
+ * pci_fuzzer_get_fingerprint()) was never seen are added to the corpus.
+ *
+ * @param [in] worker Worker.
+ * @return 0 on success, or an error number.
+ */
+int worker_start(worker_t *worker);
+
+/**
+ * Writes the latency histograms of the worker (see latency_write()) to its
+ * latency histograms file, if any.
+ *
+ * This can be called while the worker thread is running.
+ *
+ * @param [in] worker Worker.
+ * @return 0 on success, or -1 (and errno is set) if an error occurs.
+ */
+int worker_write_latency(worker_t *worker);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WORKER_H */